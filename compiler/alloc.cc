@@ -0,0 +1,30 @@
+// Replaces the global operator new and delete so that allocations are
+// reported to Stats, which counts them once count_allocations is called.
+// The other forms of new and delete, but for the aligned ones, call these.
+//
+// Not part of any library: a program that reports allocations compiles
+// this file in, so it is built with the program's flags, exceptions
+// included.
+#include "compiler/stats.h"
+#include <cstdlib>
+#include <new>
+
+#include <malloc.h>
+
+void *operator new(size_t size) {
+  auto p = std::malloc(size > 0 ? size : 1);
+  if (p == nullptr) {
+    throw std::bad_alloc();
+  }
+  if (lang::compiler::Stats::counting()) {
+    lang::compiler::Stats::allocated(malloc_usable_size(p));
+  }
+  return p;
+}
+
+void operator delete(void *p) noexcept {
+  if (p != nullptr && lang::compiler::Stats::counting()) {
+    lang::compiler::Stats::freed(malloc_usable_size(p));
+  }
+  std::free(p);
+}
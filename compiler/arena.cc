@@ -0,0 +1,34 @@
+#include "arena.h"
+#include <algorithm>
+
+namespace lang {
+namespace compiler {
+
+void *Arena::grow(size_t size, size_t align) {
+  // oversized requests get a block of their own so the current block keeps
+  // serving small nodes.
+  size_t block_size = std::max(BLOCK_SIZE, size + align);
+  blocks_.emplace_back(new char[block_size]);
+  capacity_ += block_size;
+
+  char *block = blocks_.back().get();
+  if (block_size > BLOCK_SIZE) {
+    auto p = reinterpret_cast<uintptr_t>(block);
+    auto aligned = (p + align - 1) & ~(uintptr_t)(align - 1);
+    bytes_ += size;
+    return reinterpret_cast<void *>(aligned);
+  }
+
+  cur_ = block;
+  end_ = block + block_size;
+  return allocate(size, align);
+}
+
+void Arena::reset() {
+  blocks_.clear();
+  cur_ = end_ = nullptr;
+  bytes_ = capacity_ = 0;
+}
+
+} // namespace compiler
+} // namespace lang
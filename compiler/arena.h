@@ -0,0 +1,99 @@
+#ifndef LANG_COMPILER_ARENA_H
+#define LANG_COMPILER_ARENA_H
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+namespace lang {
+namespace compiler {
+
+// Span is an immutable view of an array allocated in an Arena.
+template <typename T> class Span {
+  const T *data_;
+  uint32_t size_;
+
+public:
+  Span() : data_(nullptr), size_(0) {}
+  Span(const T *data, uint32_t size) : data_(data), size_(size) {}
+
+  const T *begin() const { return data_; }
+  const T *end() const { return data_ + size_; }
+  const T &operator[](size_t i) const {
+    assert(i < size_);
+    return data_[i];
+  }
+  const T &back() const { return (*this)[size_ - 1]; }
+  size_t size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+};
+
+// Arena is a bump allocator. Objects are never destroyed individually; all of
+// them are released at once by `reset` or when the arena is destroyed, so
+// only trivially destructible types may be placed in it.
+class Arena {
+  static const size_t BLOCK_SIZE = 64 * 1024;
+
+  std::vector<std::unique_ptr<char[]>> blocks_;
+  char *cur_;
+  char *end_;
+  size_t bytes_;
+  size_t capacity_;
+
+  void *grow(size_t size, size_t align);
+
+public:
+  Arena() : cur_(nullptr), end_(nullptr), bytes_(0), capacity_(0) {}
+  Arena(const Arena &) = delete;
+  Arena(Arena &&other)
+      : blocks_(std::move(other.blocks_)), cur_(other.cur_), end_(other.end_),
+        bytes_(other.bytes_), capacity_(other.capacity_) {
+    other.reset();
+  }
+
+  void *allocate(size_t size, size_t align) {
+    auto p = reinterpret_cast<uintptr_t>(cur_);
+    auto aligned = (p + align - 1) & ~(uintptr_t)(align - 1);
+    if (cur_ == nullptr || aligned + size > (uintptr_t)end_) {
+      return grow(size, align);
+    }
+    cur_ = reinterpret_cast<char *>(aligned + size);
+    bytes_ += size;
+    return reinterpret_cast<void *>(aligned);
+  }
+
+  template <typename T, typename... Args> T *make(Args &&... args) {
+    static_assert(std::is_trivially_destructible<T>::value,
+                  "arena objects are never destroyed");
+    return new (allocate(sizeof(T), alignof(T)))
+        T(std::forward<Args>(args)...);
+  }
+
+  template <typename T> Span<T> copy(const std::vector<T> &values) {
+    static_assert(std::is_trivially_copyable<T>::value,
+                  "arena arrays are copied bytewise");
+    if (values.empty()) {
+      return Span<T>();
+    }
+    auto data = static_cast<T *>(
+        allocate(sizeof(T) * values.size(), alignof(T)));
+    std::uninitialized_copy(values.begin(), values.end(), data);
+    return Span<T>(data, values.size());
+  }
+
+  // Releases every object allocated from the arena.
+  void reset();
+
+  // bytes handed out, and bytes held in blocks.
+  size_t bytes() const { return bytes_; }
+  size_t capacity() const { return capacity_; }
+};
+
+} // namespace compiler
+} // namespace lang
+
+#endif // LANG_COMPILER_ARENA_H
@@ -0,0 +1,397 @@
+#include "bytecode.h"
+#include "check.h"
+#include "definitions.h"
+#include <algorithm>
+#include <cassert>
+
+namespace lang {
+namespace compiler {
+namespace bytecode {
+
+namespace {
+
+// Compiler emits the bytecode of one fn that check() finds no problem in.
+// Each visit returns the register holding the value of the node, or -1 once
+// an error has been reported.
+//
+// Registers are handed out like a stack: a node's temporaries are released
+// once its value is computed. The registers of params and of `val` bindings
+// sit below `pinned_` and are never reused, so a visit returns either one of
+// them or the last register allocated.
+class Compiler : public ast::Visitor<Compiler, int> {
+  Context &ctx_;
+  const std::unordered_map<Symbol, uint32_t> &index_;
+  Function &fn_;
+
+  std::unordered_map<Symbol, int> scope_;
+  uint32_t next_;
+  uint32_t pinned_;
+
+  int fail(const std::string &msg) {
+    ctx_.report_error(
+        err::bytecode(msg, "in fn " + ctx_.interner().name(fn_.name)));
+    return -1;
+  }
+
+  // for nodes check() turns fns away for.
+  int unchecked() { return fail("unchecked fn"); }
+
+  int allocate() {
+    if (next_ >= UINT16_MAX) {
+      return fail("too many registers");
+    }
+    fn_.registers = std::max<uint32_t>(fn_.registers, next_ + 1);
+    return next_++;
+  }
+
+  void release(uint32_t top) { next_ = std::max(top, pinned_); }
+
+  void emit(Op op, uint32_t a, uint32_t b = 0, uint32_t c = 0) {
+    fn_.code.push_back(Instruction{op, uint16_t(a), uint16_t(b), uint16_t(c)});
+  }
+
+  // Emits a jump whose target is set by land().
+  size_t jump(Op op, uint32_t a = 0) {
+    emit(op, a);
+    return fn_.code.size() - 1;
+  }
+
+  void land(size_t jump) {
+    assert(fn_.code.size() <= UINT32_MAX);
+    uint32_t target = fn_.code.size();
+    fn_.code[jump].b = target & 0xffff;
+    fn_.code[jump].c = target >> 16;
+  }
+
+  // Compiles body into dest, which must not be pinned.
+  bool body(const ast::Expressions &body, uint32_t dest) {
+    if (body.empty()) {
+      unchecked();
+      return false;
+    }
+
+    int last = -1;
+    for (auto &expr : body) {
+      release(dest + 1);
+      if ((last = dispatch(*expr)) < 0) {
+        return false;
+      }
+    }
+    if (uint32_t(last) != dest) {
+      emit(Op::Move, dest, last);
+    }
+    return true;
+  }
+
+public:
+  Compiler(Context &ctx, const std::unordered_map<Symbol, uint32_t> &index,
+           Function &fn)
+      : ctx_(ctx), index_(index), fn_(fn), next_(0), pinned_(0) {}
+
+  int visit(const ast::Assignment &) { return unchecked(); }
+
+  int visit(const ast::BinaryExpression &expr) {
+    Op op;
+    switch (expr.op()) {
+    case '+':
+      op = Op::Add;
+      break;
+    case '-':
+      op = Op::Sub;
+      break;
+    case '*':
+      op = Op::Mul;
+      break;
+    case '/':
+      op = Op::Div;
+      break;
+    default:
+      return unchecked();
+    }
+
+    auto top = next_;
+    auto left = dispatch(expr.left());
+    if (left < 0) {
+      return -1;
+    }
+    auto right = dispatch(expr.right());
+    if (right < 0) {
+      return -1;
+    }
+    release(top);
+    auto dest = allocate();
+    if (dest >= 0) {
+      emit(op, dest, left, right);
+    }
+    return dest;
+  }
+
+  int visit(const ast::Call &call) {
+    auto callee = index_.at(call.name());
+
+    // arguments end up in consecutive registers, which usually means where
+    // they were computed.
+    auto top = next_;
+    auto pinned = pinned_;
+    std::vector<int> args;
+    for (auto &expr : call.args()) {
+      args.push_back(dispatch(*expr));
+      if (args.back() < 0) {
+        return -1;
+      }
+    }
+    bool in_place = pinned_ == pinned;
+    for (size_t i = 0; i < args.size(); ++i) {
+      in_place = in_place && uint32_t(args[i]) == top + i;
+    }
+    uint32_t base = in_place ? top : next_;
+    for (size_t i = 0; !in_place && i < args.size(); ++i) {
+      if (allocate() < 0) {
+        return -1;
+      }
+      emit(Op::Move, base + i, args[i]);
+    }
+
+    auto it = std::find(fn_.callees.begin(), fn_.callees.end(), callee);
+    if (it == fn_.callees.end()) {
+      if (fn_.callees.size() > UINT16_MAX) {
+        return fail("too many callees");
+      }
+      it = fn_.callees.insert(it, callee);
+    }
+
+    release(top);
+    auto dest = allocate();
+    if (dest >= 0) {
+      emit(Op::Call, dest, it - fn_.callees.begin(), base);
+    }
+    return dest;
+  }
+
+  int visit(const ast::Function &) { return unchecked(); }
+
+  int visit(const ast::If &expr) {
+    auto top = next_;
+    auto cond = dispatch(expr.cond());
+    if (cond < 0) {
+      return -1;
+    }
+    release(top);
+    auto dest = allocate();
+    if (dest < 0) {
+      return -1;
+    }
+
+    // names bound in a branch go out of scope with it.
+    auto scope = scope_;
+    auto pinned = pinned_;
+    auto els = jump(Op::JumpUnless, cond);
+    if (!body(expr.thn(), dest)) {
+      return -1;
+    }
+    scope_ = scope;
+    pinned_ = pinned;
+    auto end = jump(Op::Jump);
+    land(els);
+    if (!body(expr.els(), dest)) {
+      return -1;
+    }
+    scope_ = std::move(scope);
+    pinned_ = pinned;
+    land(end);
+
+    release(dest + 1);
+    return dest;
+  }
+
+  int visit(const ast::Identifier &id) {
+    auto it = scope_.find(id.name());
+    if (it == scope_.end()) {
+      return unchecked();
+    }
+    return it->second;
+  }
+
+  int visit(const ast::Integer &integer) {
+    if (fn_.constants.size() > UINT16_MAX) {
+      return fail("too many constants");
+    }
+    auto dest = allocate();
+    if (dest >= 0) {
+      fn_.constants.push_back(integer.value());
+      emit(Op::Int, dest, fn_.constants.size() - 1);
+    }
+    return dest;
+  }
+
+  int visit(const ast::Parameter &) { return unchecked(); }
+
+  int visit(const ast::Prototype &) { return unchecked(); }
+
+  int visit(const ast::TupleAssignment &) { return unchecked(); }
+
+  int visit(const ast::Value &v) {
+    if (!v.has_value()) {
+      return unchecked();
+    }
+    auto val = dispatch(v.value());
+    // like the generated code, only `val` names its value.
+    if (val >= 0 && v.constant()) {
+      pinned_ = std::max<uint32_t>(pinned_, val + 1);
+      scope_[v.name()] = val;
+    }
+    return val;
+  }
+
+  // Compiles fn into fn_, leaving its code empty if that fails.
+  void compile(const ast::Function &fn) {
+    for (auto param : fn.proto().params()) {
+      scope_[param->name()] = allocate();
+    }
+    pinned_ = next_;
+
+    int result = -1;
+    for (auto &expr : fn.body()) {
+      release(0);
+      if ((result = dispatch(*expr)) < 0) {
+        break;
+      }
+    }
+    if (fn.body().empty()) {
+      unchecked();
+    }
+
+    if (result < 0) {
+      fn_.code.clear();
+      fn_.constants.clear();
+      fn_.callees.clear();
+      return;
+    }
+    emit(Op::Return, result);
+  }
+};
+
+const char *name(Op op) {
+  switch (op) {
+  case Op::Move:
+    return "move";
+  case Op::Int:
+    return "int";
+  case Op::Add:
+    return "add";
+  case Op::Sub:
+    return "sub";
+  case Op::Mul:
+    return "mul";
+  case Op::Div:
+    return "div";
+  case Op::Jump:
+    return "jump";
+  case Op::JumpUnless:
+    return "jump-unless";
+  case Op::Call:
+    return "call";
+  case Op::Return:
+    return "ret";
+  case Op::CallNative:
+    return "call-native";
+  }
+  return "?";
+}
+
+} // namespace
+
+// -----------------------------------------------------------------------------
+// Program
+// -----------------------------------------------------------------------------
+Program::Program(Context &ctx) {
+  Definitions defs(ctx);
+
+  // every fn gets its index up front, so calls can refer to later fns.
+  std::vector<std::pair<const ast::Function *, size_t>> fns;
+  size_t position = 0;
+  ctx.each_expr([&](const ast::Expression &expr) {
+    if (expr.kind() == ast::Kind::Function) {
+      auto &fn = static_cast<const ast::Function &>(expr);
+      auto name = fn.proto().name();
+      if (defs.is_first(name, position)) {
+        index_.emplace(name, functions_.size());
+        auto params = uint16_t(fn.proto().params().size());
+        functions_.push_back(Function{name, params, 0, {}, {}, {}});
+        fns.emplace_back(&fn, position);
+      }
+    }
+    ++position;
+  });
+
+  for (size_t i = 0; i < fns.size(); ++i) {
+    if (fns[i].first->proto().params().size() > UINT16_MAX) {
+      auto &name = ctx.interner().name(functions_[i].name);
+      ctx.report_error(err::bytecode("too many params", "in fn " + name));
+      continue;
+    }
+    auto checked = check(ctx.interner(), defs, *fns[i].first, fns[i].second);
+    if (!checked.problem.empty()) {
+      auto &name = ctx.interner().name(functions_[i].name);
+      ctx.report_error(err::bytecode(checked.problem, "in fn " + name));
+      continue;
+    }
+    Compiler compiler(ctx, index_, functions_[i]);
+    compiler.compile(*fns[i].first);
+  }
+}
+
+const Function *Program::lookup(Symbol name) const {
+  auto it = index_.find(name);
+  return it == index_.end() ? nullptr : &functions_[it->second];
+}
+
+void Program::print(std::ostream &out, const Interner &names) const {
+  for (auto &fn : functions_) {
+    fn.print(out, names);
+  }
+}
+
+// -----------------------------------------------------------------------------
+// Function
+// -----------------------------------------------------------------------------
+void Function::print(std::ostream &out, const Interner &names) const {
+  out << "fn " << names.name(name) << " (params " << params << ", registers "
+      << registers << ")\n";
+  for (size_t i = 0; i < code.size(); ++i) {
+    auto &ins = code[i];
+    out << "  " << i << ": " << bytecode::name(ins.op);
+    switch (ins.op) {
+    case Op::Move:
+      out << " r" << ins.a << ", r" << ins.b;
+      break;
+    case Op::Int:
+      out << " r" << ins.a << ", " << constants[ins.b];
+      break;
+    case Op::Add:
+    case Op::Sub:
+    case Op::Mul:
+    case Op::Div:
+      out << " r" << ins.a << ", r" << ins.b << ", r" << ins.c;
+      break;
+    case Op::Jump:
+      out << " " << ins.target();
+      break;
+    case Op::JumpUnless:
+      out << " r" << ins.a << ", " << ins.target();
+      break;
+    case Op::Call:
+    case Op::CallNative:
+      out << " r" << ins.a << ", " << callees[ins.b] << ", r" << ins.c;
+      break;
+    case Op::Return:
+      out << " r" << ins.a;
+      break;
+    }
+    out << "\n";
+  }
+}
+
+} // namespace bytecode
+} // namespace compiler
+} // namespace lang
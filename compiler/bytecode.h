@@ -0,0 +1,97 @@
+#ifndef LANG_COMPILER_BYTECODE_H
+#define LANG_COMPILER_BYTECODE_H
+
+#include "context.h"
+#include "interner.h"
+#include <cstdint>
+#include <ostream>
+#include <unordered_map>
+#include <vector>
+
+namespace lang {
+namespace compiler {
+namespace bytecode {
+
+// Op is the operation of an Instruction. Registers are numbered from the
+// start of the running fn's frame; a, b and c are the operands:
+//
+//   op          effect
+//   Move        r[a] = r[b]
+//   Int         r[a] = constants[b]
+//   Add         r[a] = r[b] + r[c]
+//   Sub         r[a] = r[b] - r[c]
+//   Mul         r[a] = r[b] * r[c]
+//   Div         r[a] = r[b] / r[c]
+//   Jump        pc = target
+//   JumpUnless  if r[a] != 1: pc = target
+//   Call        r[a] = callees[b](r[c], ..., r[c + params - 1])
+//   Return      return r[a]
+//   CallNative  like Call, through the native code of callees[b]
+//
+// Arithmetic wraps and division truncates, like the generated code; x / 0
+// is 0 and x / -1 is -x, so no division traps on either tier. Jump targets
+// are 32 bits wide and span b and c. A Call runs the callee in a frame that
+// starts at r[c], so its arguments are its first registers and nothing is
+// copied.
+// CallNative is never compiled; the Interpreter patches a Call into one once
+// its callee has been promoted to native code.
+enum class Op : uint8_t {
+  Move,
+  Int,
+  Add,
+  Sub,
+  Mul,
+  Div,
+  Jump,
+  JumpUnless,
+  Call,
+  Return,
+  CallNative,
+};
+
+struct Instruction {
+  Op op;
+  uint16_t a, b, c;
+
+  uint32_t target() const { return b | uint32_t(c) << 16; }
+};
+
+// Function is the bytecode of one fn.
+struct Function {
+  Symbol name;
+  uint16_t params;
+  // frame size, params included.
+  uint16_t registers;
+  // empty if the fn failed to compile; calling it is an error.
+  std::vector<Instruction> code;
+  std::vector<int64_t> constants;
+  // indices into Program::functions of the fns called.
+  std::vector<uint32_t> callees;
+
+  void print(std::ostream &out, const Interner &names) const;
+};
+
+// Program is the bytecode of a unit: a Function for the first definition of
+// every fn, in source order.
+class Program {
+  std::vector<Function> functions_;
+  std::unordered_map<Symbol, uint32_t> index_;
+
+public:
+  // Compiles every fn of ctx; errors go to ctx.
+  explicit Program(Context &ctx);
+  Program(const Program &) = delete;
+  Program(Program &&) = default;
+
+  const std::vector<Function> &functions() const { return functions_; }
+  // The fn called name, or nullptr.
+  const Function *lookup(Symbol name) const;
+
+  void print(std::ostream &out, const Interner &names) const;
+};
+
+} // namespace bytecode
+} // namespace compiler
+} // namespace lang
+
+#endif // LANG_COMPILER_BYTECODE_H
@@ -0,0 +1,290 @@
+#include "cache.h"
+#include <algorithm>
+#include <chrono>
+#include <vector>
+
+#include <llvm/ADT/SmallString.h>
+#include <llvm/ADT/StringExtras.h>
+#include <llvm/Config/llvm-config.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/Path.h>
+#include <llvm/Support/SHA1.h>
+#include <llvm/Support/raw_ostream.h>
+
+using namespace llvm;
+
+namespace lang {
+namespace compiler {
+namespace cache {
+
+namespace {
+
+// Part of every key. Bump it whenever the code generated for a fn changes,
+// or stale entries will be used.
+const char *const VERSION = "lang-cache-2 llvm-" LLVM_VERSION_STRING;
+
+// Writers leave their data in a temporary file, renamed into place once
+// complete.
+const char *const TEMPORARY = ".tmp";
+
+// Hasher feeds a tree to a SHA1. Names go in by spelling, since Symbols
+// differ from one run to the next, and every node starts with its kind, so
+// different trees cannot feed the same bytes.
+class Hasher : public ast::Visitor<Hasher> {
+  const Interner &names_;
+  const Definitions &defs_;
+  const size_t position_;
+  SHA1 &sha_;
+
+  void add(uint64_t value) {
+    uint8_t bytes[8];
+    for (size_t i = 0; i < 8; ++i) {
+      bytes[i] = value >> (8 * i);
+    }
+    sha_.update(bytes);
+  }
+  void add(StringRef value) {
+    add(value.size());
+    sha_.update(value);
+  }
+  void add(Symbol name) { add(names_.name(name)); }
+  void add(ast::Kind kind) { add(static_cast<uint64_t>(kind)); }
+  void add(const ast::Expressions &exprs) {
+    add(exprs.size());
+    for (auto &expr : exprs) {
+      dispatch(*expr);
+    }
+  }
+  void add(const ast::BaseValue &value) {
+    add(value.kind());
+    add(uint64_t(value.constant()));
+    add(value.name());
+    add(uint64_t(value.has_value()));
+    if (value.has_value()) {
+      dispatch(value.value());
+    }
+  }
+
+public:
+  Hasher(const Interner &names, const Definitions &defs, size_t position,
+         SHA1 &sha)
+      : names_(names), defs_(defs), position_(position), sha_(sha) {}
+
+  void visit(const ast::Assignment &expr) {
+    add(expr.kind());
+    dispatch(expr.left());
+    dispatch(expr.right());
+  }
+
+  void visit(const ast::BinaryExpression &expr) {
+    add(expr.kind());
+    add(uint64_t(expr.op()));
+    dispatch(expr.left());
+    dispatch(expr.right());
+  }
+
+  void visit(const ast::Call &call) {
+    add(call.kind());
+    add(call.name());
+    // the code of a call depends on the callee's prototype, not its body.
+    auto proto = defs_.lookup(call.name(), position_);
+    add(proto == nullptr ? 0 : proto->params().size() + 1);
+    add(call.args());
+  }
+
+  void visit(const ast::Function &fn) {
+    add(fn.kind());
+    dispatch(fn.proto());
+    add(fn.body());
+  }
+
+  void visit(const ast::If &expr) {
+    add(expr.kind());
+    dispatch(expr.cond());
+    add(expr.thn());
+    add(expr.els());
+  }
+
+  void visit(const ast::Identifier &id) {
+    add(id.kind());
+    add(id.name());
+  }
+
+  void visit(const ast::Integer &integer) {
+    add(integer.kind());
+    add(uint64_t(integer.value()));
+  }
+
+  void visit(const ast::Parameter &param) { add(param); }
+
+  void visit(const ast::Prototype &proto) {
+    add(proto.kind());
+    add(proto.name());
+    add(proto.params().size());
+    for (auto param : proto.params()) {
+      dispatch(*param);
+    }
+  }
+
+  void visit(const ast::TupleAssignment &expr) {
+    add(expr.kind());
+    add(expr.left());
+    add(expr.right());
+  }
+
+  void visit(const ast::Value &value) { add(value); }
+};
+
+} // namespace
+
+std::string key(const Interner &names, const Definitions &defs,
+                const ast::Function &fn, size_t position,
+                const std::string &flags) {
+  SHA1 sha;
+  sha.update(VERSION);
+  sha.update(StringRef("\0", 1));
+  sha.update(flags);
+  sha.update(StringRef("\0", 1));
+  Hasher(names, defs, position, sha).dispatch(fn);
+  return toHex(sha.final(), true);
+}
+
+// -----------------------------------------------------------------------------
+// Cache
+// -----------------------------------------------------------------------------
+Cache::Cache(const std::string &dir, uint64_t capacity, uint64_t size)
+    : dir_(dir), capacity_(capacity), size_(size) {}
+
+std::string Cache::default_dir() {
+  SmallString<128> dir;
+  if (!sys::path::cache_directory(dir)) {
+    return "";
+  }
+  sys::path::append(dir, "lang");
+  return dir.str().str();
+}
+
+std::unique_ptr<Cache> Cache::open(std::unique_ptr<const err::Error> &error,
+                                   const std::string &dir,
+                                   uint64_t capacity) {
+  if (auto ec = sys::fs::create_directories(dir)) {
+    error = err::object("cannot open cache " + dir, ec.message());
+    return nullptr;
+  }
+
+  uint64_t size = 0;
+  std::error_code ec;
+  for (sys::fs::directory_iterator it(dir, ec), end; it != end && !ec;
+       it.increment(ec)) {
+    auto status = it->status();
+    if (status && status->type() == sys::fs::file_type::regular_file) {
+      size += status->getSize();
+    }
+  }
+  if (ec) {
+    error = err::object("cannot open cache " + dir, ec.message());
+    return nullptr;
+  }
+  return std::unique_ptr<Cache>(new Cache(dir, capacity, size));
+}
+
+std::unique_ptr<MemoryBuffer> Cache::get(const std::string &key) {
+  SmallString<128> path(dir_);
+  sys::path::append(path, key);
+  int fd = -1;
+  if (sys::fs::openFileForRead(path, fd)) {
+    return nullptr;
+  }
+  auto file = sys::fs::convertFDToNativeFile(fd);
+  auto buffer = MemoryBuffer::getOpenFile(file, path, -1, false);
+  if (buffer) {
+    // eviction goes by modification time.
+    sys::fs::setLastAccessAndModificationTime(
+        fd, std::chrono::system_clock::now());
+  }
+  sys::fs::closeFile(file);
+  if (!buffer) {
+    return nullptr;
+  }
+  return std::move(*buffer);
+}
+
+void Cache::put(const std::string &key, StringRef data) {
+  SmallString<128> path(dir_), temporary;
+  sys::path::append(path, key);
+  if (sys::fs::exists(path)) {
+    return;
+  }
+
+  int fd = -1;
+  if (sys::fs::createUniqueFile(dir_ + "/%%%%%%%%%%%%" + TEMPORARY, fd,
+                                temporary)) {
+    return;
+  }
+  {
+    raw_fd_ostream out(fd, true);
+    out << data;
+    out.close();
+    if (out.has_error()) {
+      out.clear_error();
+      sys::fs::remove(temporary);
+      return;
+    }
+  }
+  if (sys::fs::rename(temporary, path)) {
+    sys::fs::remove(temporary);
+    return;
+  }
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  size_ += data.size();
+  if (size_ > capacity_) {
+    // evicting a little more than needed leaves room for a while.
+    evict(capacity_ - capacity_ / 8);
+  }
+}
+
+void Cache::evict(uint64_t target) {
+  struct Entry {
+    sys::TimePoint<> used;
+    uint64_t size;
+    std::string path;
+  };
+  std::vector<Entry> entries;
+  uint64_t size = 0;
+  auto stale = std::chrono::system_clock::now() - std::chrono::hours(1);
+
+  std::error_code ec;
+  for (sys::fs::directory_iterator it(dir_, ec), end; it != end && !ec;
+       it.increment(ec)) {
+    auto status = it->status();
+    if (!status || status->type() != sys::fs::file_type::regular_file) {
+      continue;
+    }
+    // another writer may still be busy with a recent temporary file.
+    bool temporary = StringRef(it->path()).endswith(TEMPORARY);
+    if (temporary && status->getLastModificationTime() > stale) {
+      size += status->getSize();
+      continue;
+    }
+    entries.push_back(Entry{status->getLastModificationTime(),
+                            status->getSize(), it->path()});
+    size += status->getSize();
+  }
+
+  std::sort(entries.begin(), entries.end(),
+            [](const Entry &a, const Entry &b) { return a.used < b.used; });
+  for (auto &entry : entries) {
+    if (size <= target) {
+      break;
+    }
+    if (!sys::fs::remove(entry.path)) {
+      size -= entry.size;
+    }
+  }
+  size_ = size;
+}
+
+} // namespace cache
+} // namespace compiler
+} // namespace lang
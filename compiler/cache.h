@@ -0,0 +1,66 @@
+#ifndef LANG_COMPILER_CACHE_H
+#define LANG_COMPILER_CACHE_H
+
+#include "context.h"
+#include "definitions.h"
+#include "expressions.h"
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include <llvm/ADT/StringRef.h>
+#include <llvm/Support/MemoryBuffer.h>
+
+namespace lang {
+namespace compiler {
+namespace cache {
+
+// Hashes everything the code of the top-level fn at position depends on: its
+// tree, the prototypes of the fns it calls as resolved by defs, and flags,
+// which name the compiler, target and options. Returns 40 hex digits.
+std::string key(const Interner &names, const Definitions &defs,
+                const ast::Function &fn, size_t position,
+                const std::string &flags);
+
+// Cache is a directory of compiled fns, one file per key. Entries are
+// written atomically, so several compilers may share a directory. Once the
+// entries outgrow the capacity, the least recently used ones are removed;
+// a hit counts as a use.
+class Cache {
+  const std::string dir_;
+  const uint64_t capacity_;
+
+  std::mutex mutex_;
+  // bytes in dir_, as far as this process knows.
+  uint64_t size_;
+
+  Cache(const std::string &dir, uint64_t capacity, uint64_t size);
+  // Removes the least recently used entries until dir_ is down to target.
+  void evict(uint64_t target);
+
+public:
+  // Capacity in bytes, unless told otherwise.
+  static const uint64_t CAPACITY = uint64_t(512) << 20;
+
+  // The per-user cache directory of the platform, with "lang" appended, or
+  // "" if there is none.
+  static std::string default_dir();
+
+  // Opens or creates the cache in dir, or returns nullptr and sets error.
+  static std::unique_ptr<Cache> open(std::unique_ptr<const err::Error> &error,
+                                     const std::string &dir,
+                                     uint64_t capacity = CAPACITY);
+
+  // The entry of key, or nullptr. Safe to call from any thread.
+  std::unique_ptr<llvm::MemoryBuffer> get(const std::string &key);
+  // Stores data under key; failing to is not an error, only a miss next
+  // time. Safe to call from any thread.
+  void put(const std::string &key, llvm::StringRef data);
+};
+
+} // namespace cache
+} // namespace compiler
+} // namespace lang
+
+#endif // LANG_COMPILER_CACHE_H
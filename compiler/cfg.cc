@@ -4,7 +4,7 @@ namespace lang {
 namespace compiler {
 namespace cfg {
 
-void BasicBlock::emplace_back(std::shared_ptr<const ast::Expression> expr) {
+void BasicBlock::emplace_back(const ast::Expression *expr) {
   expressions_.push_back(expr);
 }
 
@@ -31,71 +31,67 @@ void CFGParser::parse() {
   _ctx.visit_ast(*this);
 }
 
-void CFGParser::visit(std::shared_ptr<const ast::Expression> expr) {
-  // _block->emplace_back(expr);
+void CFGParser::visit(const ast::Assignment &expr) {
+  _block->emplace_back(&expr);
 }
 
-void CFGParser::visit(std::shared_ptr<const ast::Assignment> expr) {
-  _block->emplace_back(expr);
+void CFGParser::visit(const ast::BinaryExpression &expr) {
+  _block->emplace_back(&expr);
 }
 
-void CFGParser::visit(std::shared_ptr<const ast::BinaryExpression> expr) {
-  _block->emplace_back(expr);
-}
-
-void CFGParser::visit(std::shared_ptr<const ast::Call> expr) {
+void CFGParser::visit(const ast::Call &expr) {
   // new_block();
-  _block->emplace_back(expr);
+  _block->emplace_back(&expr);
   // new_block();
 }
 
-void CFGParser::visit(std::shared_ptr<const ast::Function> expr) {
+void CFGParser::visit(const ast::Function &expr) {
   new_block();
-  for (auto &expr : expr->body()) {
-    expr->accept(*this);
+  for (auto &expr : expr.body()) {
+    dispatch(*expr);
   }
 
   new_block();
 }
 
-void CFGParser::visit(std::shared_ptr<const ast::If> expr) {
-  expr->cond().accept(*this);
+void CFGParser::visit(const ast::If &expr) {
+  dispatch(expr.cond());
 
   new_block();
-  for (auto &expr : expr->thn()) {
-    expr->accept(*this);
+  for (auto &expr : expr.thn()) {
+    dispatch(*expr);
   }
 
   new_block();
-  for (auto &expr : expr->els()) {
-    expr->accept(*this);
+  for (auto &expr : expr.els()) {
+    dispatch(*expr);
   }
 
   new_block();
 }
 
-void CFGParser::visit(std::shared_ptr<const ast::Identifier> expr) {
-  _block->emplace_back(expr);
+void CFGParser::visit(const ast::Identifier &expr) {
+  _block->emplace_back(&expr);
 }
 
-void CFGParser::visit(std::shared_ptr<const ast::Integer> expr) {
-  _block->emplace_back(expr);
+void CFGParser::visit(const ast::Integer &expr) {
+  _block->emplace_back(&expr);
 }
 
-void CFGParser::visit(std::shared_ptr<const ast::Parameter> expr) {
-  _block->emplace_back(expr);
+void CFGParser::visit(const ast::Parameter &expr) {
+  _block->emplace_back(&expr);
 }
 
-void CFGParser::visit(std::shared_ptr<const ast::Prototype> expr) {
-  _block->emplace_back(expr);
+void CFGParser::visit(const ast::Prototype &expr) {
+  _block->emplace_back(&expr);
 }
 
-void CFGParser::visit(std::shared_ptr<const ast::TupleAssignment> expr) {
-  _block->emplace_back(expr);
+void CFGParser::visit(const ast::TupleAssignment &expr) {
+  _block->emplace_back(&expr);
 }
 
-void CFGParser::visit(std::shared_ptr<const ast::Value> expr) {
-  _block->emplace_back(expr);
+void CFGParser::visit(const ast::Value &expr) {
+  _block->emplace_back(&expr);
 }
 
 } // namespace cfg
@@ -10,7 +10,7 @@ namespace lang {
 namespace compiler {
 namespace cfg {
 
-class CFGParser : public ast::Visitor {
+class CFGParser : public ast::Visitor<CFGParser> {
   Context &_ctx;
   std::unique_ptr<BasicBlock> _block;
 
@@ -26,18 +26,17 @@ public:
     parser.parse();
   }
 
-  void visit(std::shared_ptr<const ast::Expression>);
-  void visit(std::shared_ptr<const ast::Assignment>);
-  void visit(std::shared_ptr<const ast::BinaryExpression>);
-  void visit(std::shared_ptr<const ast::Call>);
-  void visit(std::shared_ptr<const ast::Function>);
-  void visit(std::shared_ptr<const ast::If>);
-  void visit(std::shared_ptr<const ast::Identifier>);
-  void visit(std::shared_ptr<const ast::Integer>);
-  void visit(std::shared_ptr<const ast::Parameter>);
-  void visit(std::shared_ptr<const ast::Prototype>);
-  void visit(std::shared_ptr<const ast::TupleAssignment>);
-  void visit(std::shared_ptr<const ast::Value>);
+  void visit(const ast::Assignment &);
+  void visit(const ast::BinaryExpression &);
+  void visit(const ast::Call &);
+  void visit(const ast::Function &);
+  void visit(const ast::If &);
+  void visit(const ast::Identifier &);
+  void visit(const ast::Integer &);
+  void visit(const ast::Parameter &);
+  void visit(const ast::Prototype &);
+  void visit(const ast::TupleAssignment &);
+  void visit(const ast::Value &);
 };
 
 } // namespace cfg
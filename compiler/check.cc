@@ -0,0 +1,149 @@
+#include "check.h"
+#include <unordered_set>
+
+namespace lang {
+namespace compiler {
+
+namespace {
+
+class Checker : public ast::Visitor<Checker, bool> {
+  const Interner &names_;
+  const Definitions &defs_;
+  const size_t position_;
+  std::unordered_set<Symbol> scope_;
+  Check &check_;
+
+  bool fail(const std::string &msg) {
+    if (check_.problem.empty()) {
+      check_.problem = msg;
+    }
+    return false;
+  }
+
+  bool body(const ast::Expressions &body) {
+    if (body.empty()) {
+      return fail("if branch has no value");
+    }
+    for (auto &expr : body) {
+      if (!dispatch(*expr)) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+public:
+  Checker(const Interner &names, const Definitions &defs, size_t position,
+          Check &check)
+      : names_(names), defs_(defs), position_(position), check_(check) {}
+
+  bool check(const ast::Function &fn) {
+    for (auto param : fn.proto().params()) {
+      scope_.insert(param->name());
+    }
+    if (fn.body().empty()) {
+      return fail("fn has no value");
+    }
+    for (auto &expr : fn.body()) {
+      if (!dispatch(*expr)) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  bool visit(const ast::Assignment &) {
+    return fail("assignment unsupported");
+  }
+
+  bool visit(const ast::BinaryExpression &expr) {
+    switch (expr.op()) {
+    case '+':
+    case '-':
+    case '*':
+    case '/':
+      return dispatch(expr.left()) && dispatch(expr.right());
+    default:
+      return fail(std::string("unknown operator ") + expr.op());
+    }
+  }
+
+  bool visit(const ast::Call &call) {
+    auto &name = names_.name(call.name());
+    auto proto = defs_.lookup(call.name(), position_);
+    if (proto == nullptr) {
+      return fail("undefined fn " + name);
+    }
+    if (proto->params().size() != call.args().size()) {
+      return fail("fn " + name + " takes " +
+                  std::to_string(proto->params().size()) + " arguments");
+    }
+    check_.callees.push_back(call.name());
+    for (auto &arg : call.args()) {
+      if (!dispatch(*arg)) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  bool visit(const ast::Function &) { return fail("nested fn unsupported"); }
+
+  bool visit(const ast::If &expr) {
+    if (!dispatch(expr.cond())) {
+      return false;
+    }
+    // names bound in a branch go out of scope with it.
+    auto scope = scope_;
+    if (!body(expr.thn())) {
+      return false;
+    }
+    scope_ = scope;
+    if (!body(expr.els())) {
+      return false;
+    }
+    scope_ = std::move(scope);
+    return true;
+  }
+
+  bool visit(const ast::Identifier &id) {
+    return scope_.count(id.name()) ||
+           fail("undefined name " + names_.name(id.name()));
+  }
+
+  bool visit(const ast::Integer &) { return true; }
+
+  bool visit(const ast::Parameter &) { return fail("unexpected parameter"); }
+
+  bool visit(const ast::Prototype &) { return fail("unexpected prototype"); }
+
+  bool visit(const ast::TupleAssignment &) {
+    return fail("tuple assignment unsupported");
+  }
+
+  bool visit(const ast::Value &v) {
+    if (!v.has_value()) {
+      return fail("no value for " + names_.name(v.name()));
+    }
+    if (!dispatch(v.value())) {
+      return false;
+    }
+    // like the generated code, only `val` names its value.
+    if (v.constant()) {
+      scope_.insert(v.name());
+    }
+    return true;
+  }
+};
+
+} // namespace
+
+Check check(const Interner &names, const Definitions &defs,
+            const ast::Function &fn, size_t position) {
+  Check check;
+  Checker(names, defs, position, check).check(fn);
+  return check;
+}
+
+} // namespace compiler
+} // namespace lang
@@ -0,0 +1,32 @@
+#ifndef LANG_COMPILER_CHECK_H
+#define LANG_COMPILER_CHECK_H
+
+#include "definitions.h"
+#include "expressions.h"
+#include "interner.h"
+#include <string>
+#include <vector>
+
+namespace lang {
+namespace compiler {
+
+// What check() finds in a fn.
+struct Check {
+  // why the fn does not generate, empty if it does.
+  std::string problem;
+  // the fns called, as often as they are.
+  std::vector<Symbol> callees;
+};
+
+// Checks fn, the top-level node at position, by the rules every tier
+// generates by: names are bound by a param or an earlier `val` of the same
+// branch, callees are defined by then and get their params, and every body
+// has a value. Codegen, the bytecode compiler and the lazy JIT turn away
+// the fns it finds a problem in.
+Check check(const Interner &names, const Definitions &defs,
+            const ast::Function &fn, size_t position);
+
+} // namespace compiler
+} // namespace lang
+
+#endif // LANG_COMPILER_CHECK_H
@@ -1,10 +1,25 @@
 #include "codegen.h"
+#include "check.h"
+#include "parallel.h"
+#include "stats.h"
+#include "trace.h"
+#include <algorithm>
+#include <string>
 #include <vector>
 
 #include <llvm/ADT/APInt.h>
+#include <llvm/ADT/SmallVector.h>
+#include <llvm/Bitcode/BitcodeReader.h>
+#include <llvm/Bitcode/BitcodeWriter.h>
 #include <llvm/IR/Constants.h>
 #include <llvm/IR/Type.h>
 #include <llvm/IR/Verifier.h>
+#include <llvm/Linker/Linker.h>
+#include <llvm/Support/raw_ostream.h>
+#include <llvm/Transforms/InstCombine/InstCombine.h>
+#include <llvm/Transforms/Scalar/GVN.h>
+#include <llvm/Transforms/Scalar/Reassociate.h>
+#include <llvm/Transforms/Scalar/SimplifyCFG.h>
 
 using namespace llvm;
 
@@ -12,172 +27,358 @@ namespace lang {
 namespace compiler {
 namespace codegen {
 
-Codegen::Codegen(Context &ctx)
-    : ctx_(ctx), module_(*(new llvm::Module(ctx.name(), ctx.llvm()))),
-      builder_(ctx.llvm()), fpm_(&module_) {
-  // Do simple "peephole" optimizations and bit-twiddling optzns.
-  // _fpm.add(llvm::createInstructionCombiningPass());
-  // Reassociate expressions.
-  // _fpm.add(llvm::createReassociatePass());
-  // Eliminate Common SubExpressions.
-  // _fpm.add(llvm::createGVNPass());
-  // Simplify the control flow graph (deleting unreachable blocks, etc).
-  // _fpm.add(llvm::createCFGSimplificationPass());
+// -----------------------------------------------------------------------------
+// Optimization
+// -----------------------------------------------------------------------------
+namespace {
+
+// Records a span into trace for every pass run with callbacks.
+void instrument(PassInstrumentationCallbacks &callbacks, Trace &trace) {
+  // passes nest: a pass manager runs passes, an adaptor runs a pass per fn.
+  auto begins = std::make_shared<std::vector<uint64_t>>();
+  callbacks.registerBeforeNonSkippedPassCallback(
+      [begins](StringRef, Any) { begins->push_back(Trace::now()); });
+  auto after = [begins, &trace](StringRef pass) {
+    trace.add("llvm", pass.str(), begins->back(), Trace::now());
+    begins->pop_back();
+  };
+  callbacks.registerAfterPassCallback(
+      [after](StringRef pass, Any, const PreservedAnalyses &) {
+        after(pass);
+      });
+  callbacks.registerAfterPassInvalidatedCallback(
+      [after](StringRef pass, const PreservedAnalyses &) { after(pass); });
+}
+
+} // namespace
+
+void optimize(llvm::Module &module, OptLevel level, Trace *trace) {
+  if (level == OptLevel::O0) {
+    return;
+  }
+
+  PassInstrumentationCallbacks callbacks;
+  if (trace != nullptr) {
+    instrument(callbacks, *trace);
+  }
+  PassBuilder passes(nullptr, PipelineTuningOptions(), None,
+                     trace ? &callbacks : nullptr);
+  LoopAnalysisManager lam;
+  FunctionAnalysisManager fam;
+  CGSCCAnalysisManager cgam;
+  ModuleAnalysisManager mam;
+  passes.registerModuleAnalyses(mam);
+  passes.registerCGSCCAnalyses(cgam);
+  passes.registerFunctionAnalyses(fam);
+  passes.registerLoopAnalyses(lam);
+  passes.crossRegisterProxies(lam, fam, cgam, mam);
+
+  OptimizationLevel levels[] = {OptimizationLevel::O0, OptimizationLevel::O1,
+                                OptimizationLevel::O2, OptimizationLevel::O3};
+  auto mpm = passes.buildPerModuleDefaultPipeline(
+      levels[static_cast<int>(level)]);
+  mpm.run(module, mam);
+}
+
+// -----------------------------------------------------------------------------
+// Scope
+// -----------------------------------------------------------------------------
+void Scope::symbol_add(Symbol name, llvm::Value *value) {
+  values_[name] = value;
+}
+
+llvm::Value *Scope::symbol_lookup(Symbol name) { return values_[name]; }
+
+// -----------------------------------------------------------------------------
+// Codegen
+// -----------------------------------------------------------------------------
+Codegen::Codegen(Context &ctx, OptLevel level)
+    : Codegen(ctx, nullptr, level) {}
+
+Codegen::Codegen(Context &ctx, llvm::LLVMContext &llvm, OptLevel level)
+    : Codegen(ctx, &llvm, level) {}
+
+Codegen::Codegen(Context &ctx, llvm::LLVMContext *llvm, OptLevel level)
+    : ctx_(ctx),
+      owned_(llvm ? nullptr : std::make_unique<llvm::LLVMContext>()),
+      llvm_(llvm ? *llvm : *owned_),
+      module_(std::make_unique<llvm::Module>(ctx.name(), llvm_)),
+      builder_(llvm_), level_(level),
+      passes_(nullptr, PipelineTuningOptions(), None,
+              ctx.trace() ? &instrumentation_ : nullptr),
+      definitions_(nullptr), position_(0) {
+  if (ctx.trace() != nullptr) {
+    instrument(instrumentation_, *ctx.trace());
+  }
+  passes_.registerModuleAnalyses(mam_);
+  passes_.registerCGSCCAnalyses(cgam_);
+  passes_.registerFunctionAnalyses(fam_);
+  passes_.registerLoopAnalyses(lam_);
+  passes_.crossRegisterProxies(lam_, fam_, cgam_, mam_);
+
+  if (level_ != OptLevel::O0) {
+    // Do simple "peephole" optimizations and bit-twiddling optzns.
+    fpm_.addPass(InstCombinePass());
+    // Reassociate expressions.
+    fpm_.addPass(ReassociatePass());
+    // Eliminate Common SubExpressions.
+    fpm_.addPass(GVNPass());
+    // Simplify the control flow graph (deleting unreachable blocks, etc).
+    fpm_.addPass(SimplifyCFGPass());
+  }
 }
 
 Codegen::~Codegen() {}
 
-const llvm::Module &Codegen::module() const { return module_; }
+const llvm::Module &Codegen::module() const { return *module_; }
+
+std::unique_ptr<llvm::Module> Codegen::release() { return std::move(module_); }
+
+void sort_declarations(llvm::Module &module) {
+  std::vector<Function *> decls;
+  for (auto &fn : module) {
+    if (fn.isDeclaration()) {
+      decls.push_back(&fn);
+    }
+  }
+  std::sort(decls.begin(), decls.end(), [](Function *a, Function *b) {
+    return a->getName() < b->getName();
+  });
+  for (auto fn : decls) {
+    fn->removeFromParent();
+    module.getFunctionList().push_back(fn);
+  }
+}
+
+void Codegen::finish() {
+  for (auto it = module_->begin(); it != module_->end();) {
+    auto &fn = *it++;
+    if (fn.isDeclaration() && fn.use_empty()) {
+      fn.eraseFromParent();
+    }
+  }
+  sort_declarations(*module_);
+
+  // the cleanup analyses may refer to fns erased above.
+  fam_.clear();
+  Stats::Timer timer(ctx_.stats(), Stats::OPTIMIZE);
+  Trace::Span span(ctx_.trace(), "codegen", "optimize");
+  optimize(*module_, level_, ctx_.trace());
+}
+
+void Codegen::flush_errors() {
+  for (auto &error : errors_) {
+    ctx_.report_error(std::move(error));
+  }
+  errors_.clear();
+}
+
+void Codegen::generate() {
+  Definitions defs(ctx_);
+  size_t position = 0;
+  ctx_.each_expr([this, &defs, &position](const ast::Expression &expr) {
+    if (expr.kind() == ast::Kind::Function) {
+      generate(static_cast<const ast::Function &>(expr), defs, position);
+    }
+    ++position;
+  });
+  finish();
+  flush_errors();
+}
 
-void Codegen::generate() { ctx_.visit_ast(*this); }
+Value *Codegen::generate(const ast::Function &fn, const Definitions &defs,
+                         size_t position) {
+  if (!defs.is_first(fn.proto().name(), position)) {
+    // fn cannot be redefined.
+    return nullptr;
+  }
 
-// void Codegen::visit(std::shared_ptr<const ast::Expression>) {}
+  auto &name = ctx_.interner().name(fn.proto().name());
+  auto checked = check(ctx_.interner(), defs, fn, position);
+  if (!checked.problem.empty()) {
+    errors_.push_back(err::codegen(checked.problem, "in fn " + name));
+    return nullptr;
+  }
 
-void Codegen::visit(std::shared_ptr<const ast::Assignment> asgn) {
-  ctx_.report_error(err::unknown("assignment codegen unimplemented", ""));
+  definitions_ = &defs;
+  position_ = position;
+  auto stats = ctx_.stats();
+  if (stats == nullptr && ctx_.trace() == nullptr) {
+    return visit(fn);
+  }
+
+  Stats::Timer timer(stats, Stats::CODEGEN);
+  Trace::Span span(ctx_.trace(), "codegen", name);
+  auto value = visit(fn);
+  span.end();
+  auto time = timer.stop();
+  if (stats == nullptr) {
+    return value;
+  }
+  auto generated = llvm::dyn_cast_or_null<Function>(value);
+  stats->add_function(name, time,
+                      generated ? generated->getInstructionCount() : 0);
+  return value;
 }
 
-void Codegen::visit(std::shared_ptr<const ast::BinaryExpression> expr) {
-  expr->left().accept(*this);
-  expr->right().accept(*this);
+Function *Codegen::callee(Symbol name) {
+  if (auto fn = module_->getFunction(ctx_.interner().name(name))) {
+    return fn;
+  }
+
+  auto proto = definitions_->lookup(name, position_);
+  return proto ? static_cast<Function *>(visit(*proto)) : nullptr;
+}
 
-  auto right = stack_.top();
-  stack_.pop();
-  auto left = stack_.top();
-  stack_.pop();
+Value *Codegen::generate(const ast::Expressions &body) {
+  Value *last = nullptr;
+  for (auto &expr : body) {
+    last = dispatch(*expr);
+  }
+  return last;
+}
 
-  Value *val = nullptr;
-  switch (expr->op()) {
+Value *Codegen::visit(const ast::Assignment &asgn) {
+  errors_.push_back(err::unknown("assignment codegen unimplemented", ""));
+  return nullptr;
+}
+
+Value *Codegen::visit(const ast::BinaryExpression &expr) {
+  auto left = dispatch(expr.left());
+  auto right = dispatch(expr.right());
+  if (!left || !right) {
+    return nullptr;
+  }
+
+  switch (expr.op()) {
   case '+':
-    val = builder_.CreateAdd(left, right, "addtmp");
-    break;
+    return builder_.CreateAdd(left, right, "addtmp");
   case '-':
-    val = builder_.CreateSub(left, right, "subtmp");
-    break;
+    return builder_.CreateSub(left, right, "subtmp");
   case '*':
-    val = builder_.CreateMul(left, right, "multmp");
-    break;
+    return builder_.CreateMul(left, right, "multmp");
   case '/':
-    val = builder_.CreateExactSDiv(left, right, "divtmp");
-    break;
+    return divide(left, right);
   default:
     // log error
-    break;
+    return nullptr;
   }
+}
 
-  stack_.push(val);
+Value *Codegen::divide(Value *left, Value *right) {
+  // x / 0 is 0 and x / -1 wraps, as in the interpreter; neither may reach the
+  // sdiv, where both are undefined.
+  auto zero = ConstantInt::get(llvm_, APInt(64, 0, true));
+  auto one = ConstantInt::get(llvm_, APInt(64, 1, true));
+  auto minus = ConstantInt::get(llvm_, APInt(64, -1, true));
+  auto byzero = builder_.CreateICmpEQ(right, zero, "divzero");
+  auto negate = builder_.CreateICmpEQ(right, minus, "divneg");
+  auto divisor = builder_.CreateSelect(builder_.CreateOr(byzero, negate), one,
+                                       right, "divisor");
+  auto quotient = builder_.CreateSDiv(left, divisor, "divtmp");
+  auto negated = builder_.CreateSub(zero, left, "negtmp");
+  return builder_.CreateSelect(
+      byzero, zero, builder_.CreateSelect(negate, negated, quotient), "divtmp");
 }
 
-void Codegen::visit(std::shared_ptr<const ast::Call> call) {
-  Function *callee = module_.getFunction(call->name());
+Value *Codegen::visit(const ast::Call &call) {
+  Function *callee = this->callee(call.name());
   if (!callee) {
     // log error;
-    stack_.push(nullptr);
-    return;
+    return nullptr;
   }
 
-  if (callee->arg_size() != call->args().size()) {
+  if (callee->arg_size() != call.args().size()) {
     // log error;
-    stack_.push(nullptr);
-    return;
+    return nullptr;
   }
 
   std::vector<Value *> args;
-  for (auto &expr : call->args()) {
-    expr->accept(*this);
-    auto arg = stack_.top();
-    stack_.pop();
+  for (auto &expr : call.args()) {
+    auto arg = dispatch(*expr);
     if (!arg) {
       // log error;
-      stack_.push(nullptr);
-      return;
+      return nullptr;
     }
     args.emplace_back(arg);
   }
 
-  auto val = builder_.CreateCall(callee, args, "calltmp");
-  stack_.push(val);
+  return builder_.CreateCall(callee, args, "calltmp");
 }
 
-void Codegen::visit(std::shared_ptr<const ast::Function> fn) {
-  Function *val = module_.getFunction(fn->proto().name());
+Value *Codegen::visit(const ast::Function &fn) {
+  auto &name = ctx_.interner().name(fn.proto().name());
+  Function *val = module_->getFunction(name);
   if (!val) {
-    fn->proto().accept(*this);
-    auto created = stack_.top(); // function created by proto.
-    stack_.pop();
-    val = module_.getFunction(fn->proto().name());
-    assert(created == val);
+    val = static_cast<Function *>(visit(fn.proto()));
   }
   if (!val) {
     // report error.
-    stack_.push(nullptr);
-    return;
+    return nullptr;
   }
 
   if (!val->empty()) {
     // return error (fn cannot be redefined).
-    stack_.push(nullptr);
-    return;
+    return nullptr;
   }
 
-  BasicBlock *block = BasicBlock::Create(ctx_.llvm(), "entry", val);
+  BasicBlock *block = BasicBlock::Create(llvm_, "entry", val);
   builder_.SetInsertPoint(block);
 
-  // values_.clear();
-  auto &scope = ctx_.push_scope();
-  for (auto &arg : val->args()) {
-    scope.symbol_add(arg.getName(), &arg);
-  }
-
-  for (auto &expr : fn->body()) {
-    expr->accept(*this);
+  scope_.clear();
+  auto arg_it = val->args().begin();
+  auto param_it = fn.proto().params().begin();
+  for (; arg_it != val->args().end() && param_it != fn.proto().params().end();
+       ++arg_it, ++param_it) {
+    scope_.symbol_add((*param_it)->name(), &*arg_it);
   }
 
-  Value *retval = stack_.top();
-  for (uint32_t i = 0; i < fn->body().size(); ++i) {
-    stack_.pop();
+  Value *retval = generate(fn.body());
+  if (retval) {
+    builder_.CreateRet(retval);
+    std::string problem;
+    raw_string_ostream out(problem);
+    if (verifyFunction(*val, &out)) {
+      errors_.push_back(err::codegen("invalid fn " + name, out.str()));
+      retval = nullptr;
+    }
   }
   if (!retval) {
-    val->eraseFromParent();
-    stack_.push(nullptr);
-    return;
+    // callers generated earlier keep calling the declaration.
+    val->deleteBody();
+    if (val->use_empty()) {
+      val->eraseFromParent();
+    }
+    return nullptr;
   }
 
-  builder_.CreateRet(retval);
-  verifyFunction(*val);
-  fpm_.run(*val);
+  fpm_.run(*val, fam_);
 
-  stack_.push(val);
+  return val;
 }
 
-void Codegen::visit(std::shared_ptr<const ast::If> expr) {
-  expr->cond().accept(*this);
-  auto cond = stack_.top();
-  stack_.pop();
-
+Value *Codegen::visit(const ast::If &expr) {
+  auto cond = dispatch(expr.cond());
   if (!cond) {
-    stack_.push(nullptr);
-    return;
+    return nullptr;
   }
 
   cond = builder_.CreateICmpEQ(
-      cond, ConstantInt::get(ctx_.llvm(), APInt(64, 1, true)), "ifcond");
+      cond, ConstantInt::get(llvm_, APInt(64, 1, true)), "ifcond");
 
   Function *fn = builder_.GetInsertBlock()->getParent();
-  BasicBlock *thn = BasicBlock::Create(ctx_.llvm(), "then", fn);
-  BasicBlock *els = BasicBlock::Create(ctx_.llvm(), "else");
-  BasicBlock *mrg = BasicBlock::Create(ctx_.llvm(), "ifcont");
+  BasicBlock *thn = BasicBlock::Create(llvm_, "then", fn);
+  BasicBlock *els = BasicBlock::Create(llvm_, "else");
+  BasicBlock *mrg = BasicBlock::Create(llvm_, "ifcont");
   builder_.CreateCondBr(cond, thn, els);
 
+  // names bound in a branch go out of scope with it.
+  Scope scope = scope_;
+
   // THEN
   builder_.SetInsertPoint(thn);
-  for (auto &expr : expr->thn()) {
-    expr->accept(*this);
-  }
-  Value *thnV = stack_.top();
-  for (uint32_t i = 0; i < expr->thn().size(); ++i) {
-    stack_.pop();
-  }
+  Value *thnV = generate(expr.thn());
+  scope_ = scope;
 
   builder_.CreateBr(mrg);
   thn = builder_.GetInsertBlock(); // codegen can change the block, so restore
@@ -185,73 +386,151 @@ void Codegen::visit(std::shared_ptr<const ast::If> expr) {
   // ELSE
   fn->getBasicBlockList().push_back(els);
   builder_.SetInsertPoint(els);
-  for (auto &expr : expr->els()) {
-    expr->accept(*this);
-  }
-  Value *elsV = stack_.top();
-  for (uint32_t i = 0; i < expr->els().size(); ++i) {
-    stack_.pop();
-  }
+  Value *elsV = generate(expr.els());
+  scope_ = std::move(scope);
   builder_.CreateBr(mrg);
   els = builder_.GetInsertBlock(); // codegen can change the block, so restore
 
   // MERGE
   fn->getBasicBlockList().push_back(mrg);
   builder_.SetInsertPoint(mrg);
-  PHINode *phi = builder_.CreatePHI(Type::getInt64Ty(ctx_.llvm()), 2, "iftmp");
+  if (!thnV || !elsV) {
+    // report error (both branches must produce a value).
+    return nullptr;
+  }
+
+  PHINode *phi = builder_.CreatePHI(Type::getInt64Ty(llvm_), 2, "iftmp");
 
   phi->addIncoming(thnV, thn);
   phi->addIncoming(elsV, els);
-  stack_.push(phi);
+  return phi;
 }
 
-void Codegen::visit(std::shared_ptr<const ast::Identifier> id) {
-  auto &scope = ctx_.top_scope();
-  auto val = scope.symbol_lookup(id->name());
+Value *Codegen::visit(const ast::Identifier &id) {
+  auto val = scope_.symbol_lookup(id.name());
   if (!val) {
-    // report error
-    stack_.push(nullptr);
-    return;
+    // generate() turns away fns that use undefined names.
+    return nullptr;
   }
 
-  stack_.push(val);
+  return val;
 }
 
-void Codegen::visit(std::shared_ptr<const ast::Integer> integer) {
-  auto val = ConstantInt::get(ctx_.llvm(), APInt(64, integer->value(), true));
-  stack_.push(val);
+Value *Codegen::visit(const ast::Integer &integer) {
+  return ConstantInt::get(llvm_, APInt(64, integer.value(), true));
 }
 
-void Codegen::visit(std::shared_ptr<const ast::Parameter> param) {}
+Value *Codegen::visit(const ast::Parameter &param) { return nullptr; }
 
-void Codegen::visit(std::shared_ptr<const ast::Prototype> proto) {
-  std::vector<Type *> params(proto->params().size(),
-                             Type::getInt64Ty(ctx_.llvm()));
-  FunctionType *fntype = FunctionType::get(Type::getInt64Ty(ctx_.llvm()),
+Value *Codegen::visit(const ast::Prototype &proto) {
+  std::vector<Type *> params(proto.params().size(),
+                             Type::getInt64Ty(llvm_));
+  FunctionType *fntype = FunctionType::get(Type::getInt64Ty(llvm_),
                                            params, false /* IsVarArgs */);
   Function *fn = Function::Create(fntype, Function::ExternalLinkage,
-                                  proto->name(), &module_);
+                                  ctx_.interner().name(proto.name()),
+                                  module_.get());
 
   auto arg_it = fn->args().begin();
-  auto param_it = proto->params().begin();
-  for (; arg_it != fn->args().end() && param_it != proto->params().end();
+  auto param_it = proto.params().begin();
+  for (; arg_it != fn->args().end() && param_it != proto.params().end();
        ++arg_it, ++param_it) {
-    (*arg_it).setName((*param_it)->name());
+    (*arg_it).setName(ctx_.interner().name((*param_it)->name()));
   }
 
-  stack_.push(fn);
+  return fn;
 }
 
-void Codegen::visit(std::shared_ptr<const ast::TupleAssignment> param) {
-  ctx_.report_error(err::unknown("tuple assignment codegen unimplemented", ""));
+Value *Codegen::visit(const ast::TupleAssignment &param) {
+  errors_.push_back(err::unknown("tuple assignment codegen unimplemented", ""));
+  return nullptr;
+}
+
+Value *Codegen::visit(const ast::Value &v) {
+  if (!v.has_value()) {
+    return nullptr;
+  }
+
+  auto val = dispatch(v.value());
+  if (v.constant()) {
+    scope_.symbol_add(v.name(), val);
+  }
+  return val;
 }
 
-void Codegen::visit(std::shared_ptr<const ast::Value> v) {
-  v->value().accept(*this);
-  auto val = stack_.top();
-  if (v->constant()) {
-    ctx_.top_scope().symbol_add(v->name(), val);
+// -----------------------------------------------------------------------------
+// Parallel generation
+// -----------------------------------------------------------------------------
+Shard generate_shard(Context &ctx, OptLevel level) {
+  Shard shard{std::make_unique<llvm::LLVMContext>(), nullptr};
+  Codegen codegen(ctx, *shard.llvm, level);
+  codegen.generate();
+  shard.module = codegen.release();
+  return shard;
+}
+
+std::vector<Shard> generate_parallel(Context &ctx, size_t jobs,
+                                     OptLevel level) {
+  std::vector<const ast::Function *> fns;
+  ctx.each_expr([&fns](const ast::Expression &expr) {
+    fns.push_back(expr.kind() == ast::Kind::Function
+                      ? static_cast<const ast::Function *>(&expr)
+                      : nullptr);
+  });
+  Definitions defs(ctx);
+
+  // a few shards per job evens out fns of different sizes.
+  size_t count = std::max<size_t>(1, std::min(fns.size(), jobs * 4));
+  std::vector<Shard> shards(count);
+  std::vector<std::unique_ptr<Codegen>> codegens(count);
+  parallel_for(jobs, count, [&](size_t i) {
+    shards[i].llvm = std::make_unique<llvm::LLVMContext>();
+    codegens[i] = std::make_unique<Codegen>(ctx, *shards[i].llvm, level);
+    for (size_t position = fns.size() * i / count;
+         position < fns.size() * (i + 1) / count; ++position) {
+      if (fns[position] != nullptr) {
+        codegens[i]->generate(*fns[position], defs, position);
+      }
+    }
+    codegens[i]->finish();
+  });
+
+  for (size_t i = 0; i < count; ++i) {
+    codegens[i]->flush_errors();
+    shards[i].module = codegens[i]->release();
+    codegens[i].reset();
+  }
+  return shards;
+}
+
+std::unique_ptr<llvm::Module> link(Context &ctx, std::vector<Shard> shards,
+                                   llvm::LLVMContext &llvm) {
+  auto linked = std::make_unique<llvm::Module>(ctx.name(), llvm);
+  llvm::Linker linker(*linked);
+
+  // Modules can only be linked within one LLVMContext, so each shard is
+  // moved over as bitcode.
+  for (auto &shard : shards) {
+    SmallVector<char, 0> buffer;
+    raw_svector_ostream out(buffer);
+    WriteBitcodeToFile(*shard.module, out);
+    shard.module.reset();
+    shard.llvm.reset();
+
+    auto module = parseBitcodeFile(
+        MemoryBufferRef(StringRef(buffer.data(), buffer.size()), ctx.name()),
+        llvm);
+    if (!module) {
+      ctx.report_error(
+          err::unknown("cannot read shard", toString(module.takeError())));
+      continue;
+    }
+    if (linker.linkInModule(std::move(*module))) {
+      ctx.report_error(err::unknown("cannot link shard", ""));
+    }
   }
+  sort_declarations(*linked);
+  return linked;
 }
 
 } // namespace codegen
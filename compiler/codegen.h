@@ -2,10 +2,12 @@
 #define LANG_COMPILER_CODEGEN_H
 
 #include "context.h"
+#include "definitions.h"
 #include "expressions.h"
 #include <map>
 #include <memory>
-#include <stack>
+#include <unordered_map>
+#include <vector>
 
 // #include <llvm/ADT/STLExtras.h>
 // #include <llvm/IR/BasicBlock.h>
@@ -16,40 +18,130 @@
 // #include <llvm/IR/Verifier.h>
 #include <llvm/IR/IRBuilder.h>
 #include <llvm/IR/LLVMContext.h>
-#include <llvm/IR/LegacyPassManager.h>
 #include <llvm/IR/Module.h>
+#include <llvm/IR/PassManager.h>
 #include <llvm/IR/Value.h>
+#include <llvm/Passes/PassBuilder.h>
 
 namespace lang {
 namespace compiler {
 namespace codegen {
-class Codegen : public ast::Visitor {
+
+enum class OptLevel { O0, O1, O2, O3 };
+
+// Runs the standard module pipeline for level (inlining, SROA, GVN,
+// instcombine, loop and SLP vectorization, ...) over module, tracing each
+// pass into trace unless it is null. O0 leaves the module untouched.
+void optimize(llvm::Module &module, OptLevel level, Trace *trace = nullptr);
+
+// Moves declarations to the end of module, by name, so that the module does
+// not depend on the order its fns were generated in.
+void sort_declarations(llvm::Module &module);
+
+class Scope {
+  std::unordered_map<Symbol, llvm::Value *> values_;
+
+public:
+  void symbol_add(Symbol name, llvm::Value *value);
+  llvm::Value *symbol_lookup(Symbol name);
+  void clear() { values_.clear(); }
+};
+
+class Codegen : public ast::Visitor<Codegen, llvm::Value *> {
   Context &ctx_;
-  llvm::Module &module_;
+  std::unique_ptr<llvm::LLVMContext> owned_; // see Codegen(Context &)
+  llvm::LLVMContext &llvm_;
+  std::unique_ptr<llvm::Module> module_;
   llvm::IRBuilder<> builder_;
-  llvm::legacy::FunctionPassManager fpm_;
-  std::stack<llvm::Value *> stack_;
+  const OptLevel level_;
+
+  // function-local cleanup, run as soon as a fn is complete.
+  llvm::PassInstrumentationCallbacks instrumentation_;
+  llvm::PassBuilder passes_;
+  llvm::LoopAnalysisManager lam_;
+  llvm::FunctionAnalysisManager fam_;
+  llvm::CGSCCAnalysisManager cgam_;
+  llvm::ModuleAnalysisManager mam_;
+  llvm::FunctionPassManager fpm_;
+  Scope scope_;
+  std::vector<std::unique_ptr<const err::Error>> errors_;
+
+  // resolves callees that are not in module_ yet; see generate().
+  const Definitions *definitions_;
+  size_t position_;
+
+  llvm::Function *callee(Symbol name);
+  // left / right, defined for every divisor; see bytecode::Op.
+  llvm::Value *divide(llvm::Value *left, llvm::Value *right);
+
+  Codegen(Context &ctx, llvm::LLVMContext *llvm, OptLevel level);
 
 public:
-  Codegen(Context &ctx);
+  // Generates into a new module on an LLVMContext owned by the Codegen, so
+  // the module must not outlive it.
+  Codegen(Context &ctx, OptLevel level = OptLevel::O0);
+  // Generates into a new module on llvm, which must only be used by the
+  // calling thread.
+  Codegen(Context &ctx, llvm::LLVMContext &llvm,
+          OptLevel level = OptLevel::O0);
   ~Codegen();
 
+  // Generates every top-level fn of the unit in order. A call resolves to the
+  // first definition of the callee at or before the caller, and is declared
+  // in the module on first use; a fn whose body fails to generate is left
+  // declared if anything calls it, and removed otherwise. Later definitions
+  // of the same name are rejected.
   void generate();
+  // Generates the top-level fn at position (see Definitions) of a unit,
+  // unless check() finds a problem in it, which is reported.
+  llvm::Value *generate(const ast::Function &fn, const Definitions &defs,
+                        size_t position);
+  // Generates the expressions of body in order and returns the last value.
+  llvm::Value *generate(const ast::Expressions &body);
+  // Drops declarations left unused by fns that failed to generate and runs
+  // the module pipeline.
+  void finish();
+  // Hands the errors reported so far to the unit.
+  void flush_errors();
+
   const llvm::Module &module() const;
+  std::unique_ptr<llvm::Module> release();
 
-  void visit(std::shared_ptr<const ast::Assignment>);
-  void visit(std::shared_ptr<const ast::BinaryExpression>);
-  void visit(std::shared_ptr<const ast::Call>);
-  void visit(std::shared_ptr<const ast::Function>);
-  void visit(std::shared_ptr<const ast::If>);
-  void visit(std::shared_ptr<const ast::Identifier>);
-  void visit(std::shared_ptr<const ast::Integer>);
-  void visit(std::shared_ptr<const ast::Parameter>);
-  void visit(std::shared_ptr<const ast::Prototype>);
-  void visit(std::shared_ptr<const ast::TupleAssignment>);
-  void visit(std::shared_ptr<const ast::Value>);
+  llvm::Value *visit(const ast::Assignment &);
+  llvm::Value *visit(const ast::BinaryExpression &);
+  llvm::Value *visit(const ast::Call &);
+  llvm::Value *visit(const ast::Function &);
+  llvm::Value *visit(const ast::If &);
+  llvm::Value *visit(const ast::Identifier &);
+  llvm::Value *visit(const ast::Integer &);
+  llvm::Value *visit(const ast::Parameter &);
+  llvm::Value *visit(const ast::Prototype &);
+  llvm::Value *visit(const ast::TupleAssignment &);
+  llvm::Value *visit(const ast::Value &);
 };
 
+// Shard is a module generated on its own LLVMContext.
+struct Shard {
+  std::unique_ptr<llvm::LLVMContext> llvm;
+  std::unique_ptr<llvm::Module> module;
+};
+
+// Generates the unit into a Shard of its own (see Codegen::generate).
+Shard generate_shard(Context &ctx, OptLevel level = OptLevel::O0);
+
+// Generates the unit on up to `jobs` threads. Top-level fns are split into
+// contiguous runs, each generated into a Shard by one worker; shards come
+// back in source order. Calls resolve as in Codegen::generate, so linking
+// the shards gives the module of a sequential run.
+// Each shard is optimized on its own, so calls between shards are not
+// inlined.
+std::vector<Shard> generate_parallel(Context &ctx, size_t jobs,
+                                     OptLevel level = OptLevel::O0);
+
+// Links shards into a single module on llvm.
+std::unique_ptr<llvm::Module> link(Context &ctx, std::vector<Shard> shards,
+                                   llvm::LLVMContext &llvm);
+
 } // namespace codegen
 } // namespace compiler
 } // namespace lang
@@ -1,4 +1,5 @@
 #include "context.h"
+#include "stats.h"
 
 namespace lang {
 namespace compiler {
@@ -11,6 +12,16 @@ const std::string Error::to_string(const Kind k) {
   switch (k) {
   case SYNTAX:
     return "SYN";
+  case JIT:
+    return "JIT";
+  case BYTECODE:
+    return "BC";
+  case OBJECT:
+    return "OBJ";
+  case SERVER:
+    return "SRV";
+  case CODEGEN:
+    return "CG";
   default:
     assert(false);
     return "INVALID";
@@ -20,14 +31,16 @@ const std::string Error::to_string(const Kind k) {
 Error::Error(Kind kind, const std::string &msg, const std::string &explanation)
     : _kind(kind), _msg(msg), _explanation(explanation) {}
 
-std::unique_ptr<Error> unexpected_token(const lex::Token &token) {
-  return unexpected_token(token, "");
+std::unique_ptr<Error> unexpected_token(const lex::Token &token,
+                                        const Source &source) {
+  return unexpected_token(token, source, "");
 }
 
 std::unique_ptr<Error> unexpected_token(const lex::Token &token,
+                                        const Source &source,
                                         const std::string &explanation) {
-  auto error =
-      new Error(Kind::SYNTAX, "Unexpected " + token.string(), explanation);
+  auto error = new Error(Kind::SYNTAX, "Unexpected " + token.string(source),
+                         explanation);
   return std::unique_ptr<Error>(error);
 }
 
@@ -37,6 +50,36 @@ std::unique_ptr<Error> unknown(const std::string &msg,
   return std::unique_ptr<Error>(error);
 }
 
+std::unique_ptr<Error> jit(const std::string &msg,
+                           const std::string &explanation) {
+  auto error = new Error(Kind::JIT, msg, explanation);
+  return std::unique_ptr<Error>(error);
+}
+
+std::unique_ptr<Error> bytecode(const std::string &msg,
+                                const std::string &explanation) {
+  auto error = new Error(Kind::BYTECODE, msg, explanation);
+  return std::unique_ptr<Error>(error);
+}
+
+std::unique_ptr<Error> object(const std::string &msg,
+                              const std::string &explanation) {
+  auto error = new Error(Kind::OBJECT, msg, explanation);
+  return std::unique_ptr<Error>(error);
+}
+
+std::unique_ptr<Error> server(const std::string &msg,
+                              const std::string &explanation) {
+  auto error = new Error(Kind::SERVER, msg, explanation);
+  return std::unique_ptr<Error>(error);
+}
+
+std::unique_ptr<Error> codegen(const std::string &msg,
+                               const std::string &explanation) {
+  auto error = new Error(Kind::CODEGEN, msg, explanation);
+  return std::unique_ptr<Error>(error);
+}
+
 std::ostream &operator<<(std::ostream &out, const Error &err) {
   out << Error::to_string(err._kind) << ": " << err._msg << "\n"
       << err._explanation;
@@ -46,53 +89,68 @@ std::ostream &operator<<(std::ostream &out, const Error &err) {
 void Error::accept(Visitor &visitor) const { visitor.visit(*this); }
 } // namespace err
 
-// -----------------------------------------------------------------------------
-// Scope
-// -----------------------------------------------------------------------------
-void Scope::symbol_add(const std::string &name, llvm::Value *value) {
-  values_[name] = value;
-}
-
-llvm::Value *Scope::symbol_lookup(const std::string &name) {
-  return values_[name];
-}
-
 // -----------------------------------------------------------------------------
 // GlobalContext
 // -----------------------------------------------------------------------------
-llvm::LLVMContext &GlobalContext::llvm() { return _llvm; }
+Interner &GlobalContext::interner() { return _interner; }
 
 // -----------------------------------------------------------------------------
 // Context
 // -----------------------------------------------------------------------------
 Context::Context(GlobalContext &global, const std::string &name,
                  std::istream &in)
-    : _name(name), _in(in), _global(global) {}
+    : Context(global, name, Source::read(in)) {}
+
+Context::Context(GlobalContext &global, const std::string &name,
+                 std::unique_ptr<const Source> source)
+    : _name(name), _source(std::move(source)), _global(global) {}
 
 void Context::report_error(std::unique_ptr<const err::Error> error) {
   _errors.push_back(std::move(error));
 };
 
-void Context::push_node(std::shared_ptr<const ast::Expression> node) {
+void Context::push_node(const ast::Expression *node) {
   _nodes.push_back(node);
 };
 
 void Context::push_block(std::unique_ptr<const cfg::BasicBlock> block) {
+  if (_stats != nullptr) {
+    _stats->add_blocks(1);
+  }
   _blocks.push_back(std::move(block));
 };
 
-Scope &Context::push_scope() {
-  Scope s;
-  _stack.push(s);
-  return _stack.top();
+void Context::merge(Context &shard) {
+  for (auto &error : shard._errors) {
+    _errors.push_back(std::move(error));
+  }
+  _nodes.insert(_nodes.end(), shard._nodes.begin(), shard._nodes.end());
+  for (auto &block : shard._blocks) {
+    _blocks.push_back(std::move(block));
+  }
+  _merged.push_back(std::move(shard._arena));
+  for (auto &arena : shard._merged) {
+    _merged.push_back(std::move(arena));
+  }
+
+  shard._errors.clear();
+  shard._nodes.clear();
+  shard._blocks.clear();
+  shard._merged.clear();
 }
 
+void Context::set_stats(Stats *stats) { _stats = stats; }
+
+void Context::set_trace(Trace *trace) { _trace = trace; }
+
 // getters
-Scope &Context::top_scope() { return _stack.top(); }
 const std::string &Context::name() const { return _name; }
 GlobalContext &Context::global() { return _global; }
-llvm::LLVMContext &Context::llvm() { return _global.llvm(); }
-std::istream &Context::in() { return _in; }
+Arena &Context::arena() { return _arena; }
+Interner &Context::interner() { return _global.interner(); }
+Stats *Context::stats() const { return _stats; }
+Trace *Context::trace() const { return _trace; }
+const Source &Context::source() const { return *_source; }
 bool Context::good() const { return !_errors.empty(); }
 
 void Context::each_expr(std::function<void(const ast::Expression &)> fn) {
@@ -113,13 +171,6 @@ void Context::each_error(std::function<void(const err::Error &)> fn) {
   }
 }
 
-// visitors
-void Context::visit_ast(ast::Visitor &visitor) {
-  each_expr([&visitor](const ast::Expression &expr) -> void {
-    expr.accept(visitor);
-  });
-}
-
 // void Context::visit_block(cfg::Visitor &visitor) {
 //   each_block([&visitor](const cfg::BasicBlock &block) -> void {
 //     block.accept(visitor);
@@ -1,32 +1,35 @@
 #ifndef LANG_COMPILER_CONTEXT_H
 #define LANG_COMPILER_CONTEXT_H
 
+#include "arena.h"
 #include "expressions.h"
+#include "interner.h"
+#include "source.h"
 #include "stack.h"
 #include "token.h"
-#include "llvm/IR/IRBuilder.h"
-#include "llvm/IR/LLVMContext.h"
-#include "llvm/IR/LegacyPassManager.h"
-#include "llvm/IR/Module.h"
-#include "llvm/Passes/PassBuilder.h"
-#include "llvm/Transforms/InstCombine/InstCombine.h"
-#include "llvm/Transforms/Scalar.h"
-#include "llvm/Transforms/Scalar/GVN.h"
-// #include "llvm/Transforms/Scalar/Reassociate.h"
 #include <functional>
 #include <memory>
 #include <stack>
+#include <unordered_map>
 #include <vector>
 
 namespace lang {
 namespace compiler {
 
+class Stats;
+class Trace;
+
 namespace err {
 class Visitor;
 
 enum Kind {
   INVALID = -1,
   SYNTAX = 1,
+  JIT = 2,
+  BYTECODE = 3,
+  OBJECT = 4,
+  SERVER = 5,
+  CODEGEN = 6,
 };
 
 class Error {
@@ -46,12 +49,22 @@ public:
 };
 
 // UnexpectedToken error
-std::unique_ptr<Error> unexpected_token(const lex::Token &);
+std::unique_ptr<Error> unexpected_token(const lex::Token &, const Source &);
 // UnexpectedToken error
-std::unique_ptr<Error> unexpected_token(const lex::Token &,
+std::unique_ptr<Error> unexpected_token(const lex::Token &, const Source &,
                                         const std::string &);
 // Unknown error
 std::unique_ptr<Error> unknown(const std::string &, const std::string &);
+// JIT error
+std::unique_ptr<Error> jit(const std::string &, const std::string &);
+// Bytecode compilation or interpretation error
+std::unique_ptr<Error> bytecode(const std::string &, const std::string &);
+// Object code emission or linking error
+std::unique_ptr<Error> object(const std::string &, const std::string &);
+// Compile server or client error
+std::unique_ptr<Error> server(const std::string &, const std::string &);
+// LLVM IR generation error
+std::unique_ptr<Error> codegen(const std::string &, const std::string &);
 
 class Visitor {
 public:
@@ -60,63 +73,65 @@ public:
 
 } // namespace err
 
-class Scope {
-  std::map<std::string, llvm::Value *> values_;
-
-public:
-  void symbol_add(const std::string &name, llvm::Value *value);
-  llvm::Value *symbol_lookup(const std::string &name);
-};
-
 class GlobalContext {
-  llvm::LLVMContext _llvm;
+  Interner _interner;
 
 public:
-  llvm::LLVMContext &llvm();
+  Interner &interner();
 }; // namespace compiler
 
 class Context {
   const std::string _name;
-  std::istream &_in;
+  std::unique_ptr<const Source> _source;
 
   std::vector<std::unique_ptr<const err::Error>> _errors;
-  std::vector<std::shared_ptr<const ast::Expression>> _nodes;
+  Arena _arena; // owns every ast node of this unit
+  std::vector<Arena> _merged; // arenas of merged shards
+  std::vector<const ast::Expression *> _nodes;
   std::vector<std::unique_ptr<const cfg::BasicBlock>> _blocks;
 
   GlobalContext &_global;
-  std::stack<Scope> _stack;
+  Stats *_stats = nullptr;
+  Trace *_trace = nullptr;
 
 public:
   Context(GlobalContext &global, const std::string &name, std::istream &in);
+  Context(GlobalContext &global, const std::string &name,
+          std::unique_ptr<const Source> source);
   Context(const Context &) = delete;
 
   void report_error(std::unique_ptr<const err::Error> error);
-  void push_node(std::shared_ptr<const ast::Expression> node);
+  void push_node(const ast::Expression *node);
   void push_block(std::unique_ptr<const cfg::BasicBlock> block);
-
-  // symbol table
-  Scope &push_scope();
-  Scope &top_scope();
+  // Appends the nodes, blocks and errors of shard, which was parsed from a
+  // later part of the same source, and takes over the memory backing them.
+  void merge(Context &shard);
+  // Records the phases run on this unit into stats, which must outlive it;
+  // nullptr, the default, records nothing.
+  void set_stats(Stats *stats);
+  // Likewise records spans of the phases run on this unit into trace.
+  void set_trace(Trace *trace);
 
   // getters;
   const std::string &name() const;
-  std::istream &in();
+  const Source &source() const;
   GlobalContext &global();
-  llvm::LLVMContext &llvm();
+  Arena &arena();
+  Interner &interner();
+  Stats *stats() const;
+  Trace *trace() const;
   bool good() const;
 
-  void visit_ast(ast::Visitor &vistor);
+  template <typename Visitor> void visit_ast(Visitor &visitor) {
+    for (auto node : _nodes) {
+      visitor.dispatch(*node);
+    }
+  }
   // void visit_block(cfg::Visitor &vistor);
 
   void each_expr(std::function<void(const ast::Expression &)>);
   void each_block(std::function<void(const cfg::BasicBlock &)>);
   void each_error(std::function<void(const err::Error &)>);
-
-  // llvm::LLVMContext &llvm() { return _llvm; }
-  // llvm::IRBuilder<> &builder() { return _builder; }
-  // llvm::Module &module() { return _module; }
-  // llvm::legacy::FunctionPassManager &fpm() { return _fpm; }
-  // llvm::FunctionAnalysisManager &fam() { return _fam; }
 }; // namespace compiler
 
 } // namespace compiler
@@ -0,0 +1,32 @@
+#include "definitions.h"
+
+namespace lang {
+namespace compiler {
+
+Definitions::Definitions(Context &ctx) {
+  size_t position = 0;
+  ctx.each_expr([this, &position](const ast::Expression &expr) {
+    if (expr.kind() == ast::Kind::Function) {
+      auto &proto = static_cast<const ast::Function &>(expr).proto();
+      first_.emplace(proto.name(), std::make_pair(position, &proto));
+    }
+    ++position;
+  });
+}
+
+const ast::Prototype *Definitions::lookup(Symbol name,
+                                          size_t position) const {
+  auto it = first_.find(name);
+  if (it == first_.end() || it->second.first > position) {
+    return nullptr;
+  }
+  return it->second.second;
+}
+
+bool Definitions::is_first(Symbol name, size_t position) const {
+  auto it = first_.find(name);
+  return it != first_.end() && it->second.first == position;
+}
+
+} // namespace compiler
+} // namespace lang
@@ -0,0 +1,30 @@
+#ifndef LANG_COMPILER_DEFINITIONS_H
+#define LANG_COMPILER_DEFINITIONS_H
+
+#include "context.h"
+#include "expressions.h"
+#include <unordered_map>
+#include <utility>
+
+namespace lang {
+namespace compiler {
+
+// Definitions indexes the top-level fns of a unit by name: the position of
+// the first definition of each name and its prototype.
+class Definitions {
+  std::unordered_map<Symbol, std::pair<size_t, const ast::Prototype *>> first_;
+
+public:
+  Definitions(Context &ctx);
+
+  // The prototype of the first fn called name if it is defined at or before
+  // the top-level node at position; nullptr otherwise.
+  const ast::Prototype *lookup(Symbol name, size_t position) const;
+  // Whether the top-level node at position is the first definition of name.
+  bool is_first(Symbol name, size_t position) const;
+};
+
+} // namespace compiler
+} // namespace lang
+
+#endif // LANG_COMPILER_DEFINITIONS_H
@@ -4,8 +4,31 @@ namespace lang {
 namespace compiler {
 namespace ast {
 
-void print_body(std::ostream &out, int indent,
-                const std::vector<std::shared_ptr<const Expression>> &body) {
+namespace {
+
+class Printer : public Visitor<Printer> {
+  std::ostream &out_;
+  const Interner &names_;
+  int indent_;
+
+public:
+  Printer(std::ostream &out, const Interner &names, int indent)
+      : out_(out), names_(names), indent_(indent) {}
+
+  template <typename T> void visit(const T &expr) {
+    expr.print(out_, names_, indent_);
+  }
+};
+
+} // namespace
+
+void Expression::print(std::ostream &out, const Interner &names,
+                       int indent) const {
+  Printer(out, names, indent).dispatch(*this);
+}
+
+void print_body(std::ostream &out, const Interner &names, int indent,
+                const Expressions &body) {
   if (body.empty()) {
     out << "\n" << std::string(indent + 4, ' ') << "())";
     return;
@@ -13,50 +36,53 @@ void print_body(std::ostream &out, int indent,
 
   auto it = body.begin();
   out << "\n" << std::string(indent + 4, ' ') << '(';
-  (*it)->print(out, indent + 4);
+  (*it)->print(out, names, indent + 4);
 
   for (++it; it != body.end(); ++it) {
     out << "\n" << std::string(indent + 5, ' ');
-    (*it)->print(out, indent + 5);
+    (*it)->print(out, names, indent + 5);
   }
 }
 
-void Assignment::print(std::ostream &out, int indent) const {
+void Assignment::print(std::ostream &out, const Interner &names,
+                       int indent) const {
   out << "(asgn ";
   if (left_ != nullptr) {
     out << "\n";
-    left_->print(out, indent + 6);
+    left_->print(out, names, indent + 6);
   } else {
     out << "nil";
   }
   if (right_ != nullptr) {
     out << "\n";
-    right_->print(out, indent + 6);
+    right_->print(out, names, indent + 6);
   } else {
     out << "nil";
   }
   out << ")";
 }
 
-void BinaryExpression::print(std::ostream &out, int indent) const {
+void BinaryExpression::print(std::ostream &out, const Interner &names,
+                             int indent) const {
   out << "(" << op_;
   out << "\n" << std::string(indent + 1, ' ');
   if (left_ != NULL) {
-    left_->print(out, indent + 1);
+    left_->print(out, names, indent + 1);
   } else {
     out << "nil";
   }
   out << "\n" << std::string(indent + 1, ' ');
   if (right_ != NULL) {
-    right_->print(out, indent + 1);
+    right_->print(out, names, indent + 1);
   } else {
     out << "nil";
   }
   out << ")";
 }
 
-void Call::print(std::ostream &out, int indent) const {
-  out << "(call " << name_;
+void Call::print(std::ostream &out, const Interner &names,
+                 int indent) const {
+  out << "(call " << names.name(name_);
 
   if (args_.empty()) {
     out << ")";
@@ -65,59 +91,67 @@ void Call::print(std::ostream &out, int indent) const {
 
   auto it = args_.begin();
   out << "\n" << std::string(indent + 7, ' ');
-  (*it)->print(out, indent + 7);
+  (*it)->print(out, names, indent + 7);
 
   for (++it; it != args_.end(); ++it) {
     out << "\n" << std::string(indent + 7, ' ');
-    (*it)->print(out, indent + 7);
+    (*it)->print(out, names, indent + 7);
   }
   out << ")";
 }
 
-void Function::print(std::ostream &out, int indent) const {
+void Function::print(std::ostream &out, const Interner &names,
+                     int indent) const {
   out << "(fn ";
-  prototype_->print(out, indent + 4);
-  print_body(out, indent, body_);
+  prototype_->print(out, names, indent + 4);
+  print_body(out, names, indent, body_);
   out << "))";
 }
 
-void If::print(std::ostream &out, int indent) const {
+void If::print(std::ostream &out, const Interner &names,
+               int indent) const {
   out << "(if ";
-  cond_->print(out, indent + 4);
+  cond_->print(out, names, indent + 4);
 
-  print_body(out, indent, then_);
-  print_body(out, indent, else_);
+  print_body(out, names, indent, then_);
+  print_body(out, names, indent, else_);
 
   out << ")";
 }
 
-void Identifier::print(std::ostream &out, int indent) const {
-  out << "(id " << name_ << ")";
+void Identifier::print(std::ostream &out, const Interner &names,
+                       int indent) const {
+  out << "(id " << names.name(name_) << ")";
 }
 
-void Integer::print(std::ostream &out, int indent) const {
+void Integer::print(std::ostream &out, const Interner &names,
+                    int indent) const {
   out << "(int " << value_ << ")";
 }
 
-void TupleAssignment::print(std::ostream &out, int indent) const {
+void TupleAssignment::print(std::ostream &out, const Interner &names,
+                            int indent) const {
   out << "(asgn ";
   auto lit = left_.begin();
-  (*lit)->print(out);
+  (*lit)->print(out, names);
   auto rit = right_.begin();
-  (*rit)->print(out);
+  (*rit)->print(out, names);
 
   for (++lit, ++rit; lit != left_.end() && rit != right_.end(); ++lit, ++rit) {
-    (*lit)->print(out);
-    (*rit)->print(out);
+    (*lit)->print(out, names);
+    (*rit)->print(out, names);
   }
 }
 
-void Parameter::print(std::ostream &out, int indent) const {
-  out << "(param " << (constant_ ? "val" : "var") << " " << name_ << ")";
+void Parameter::print(std::ostream &out, const Interner &names,
+                      int indent) const {
+  out << "(param " << (constant_ ? "val" : "var") << " " << names.name(name_)
+      << ")";
 }
 
-void Prototype::print(std::ostream &out, int indent) const {
-  out << "(proto " << name_;
+void Prototype::print(std::ostream &out, const Interner &names,
+                      int indent) const {
+  out << "(proto " << names.name(name_);
 
   if (params_.empty()) {
     out << " ())";
@@ -126,23 +160,24 @@ void Prototype::print(std::ostream &out, int indent) const {
 
   auto it = params_.begin();
   out << "\n" << std::string(indent + 7, ' ') << '(';
-  (*it)->print(out);
+  (*it)->print(out, names);
 
   for (++it; it != params_.end(); ++it) {
     out << "\n";
     out << std::string(indent + 8, ' ');
-    (*it)->print(out, indent + 8);
+    (*it)->print(out, names, indent + 8);
   }
   out << "))";
 }
 
-void Value::print(std::ostream &out, int indent) const {
-  out << "(" << (constant_ ? "val" : "var") << " " << name_;
+void Value::print(std::ostream &out, const Interner &names,
+                  int indent) const {
+  out << "(" << (constant_ ? "val" : "var") << " " << names.name(name_);
   if (value_ == nullptr) {
     out << " nil";
   } else {
     out << "\n" << std::string(indent + 6, ' ');
-    value_->print(out, indent + 6);
+    value_->print(out, names, indent + 6);
   }
   out << ")";
 }
@@ -151,11 +186,12 @@ void Value::print(std::ostream &out, int indent) const {
 
 namespace cfg {
 
-void BasicBlock::print(std::ostream &out, int indent) const {
+void BasicBlock::print(std::ostream &out, const Interner &names,
+                       int indent) const {
   out << "(bb ";
   for (auto &expr : expressions_) {
     out << "\n" << std::string(indent + 3, ' ');
-    (expr)->print(out, indent + 4);
+    (expr)->print(out, names, indent + 4);
   }
   out << ")";
 }
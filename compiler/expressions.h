@@ -1,38 +1,53 @@
 #ifndef LANG_COMPILER_EXPRESSIONS_H
 #define LANG_COMPILER_EXPRESSIONS_H
 
+#include "arena.h"
+#include "interner.h"
+#include <cassert>
+#include <cstdint>
 #include <memory>
 #include <ostream>
 #include <vector>
 
-#define MAKE_VISITABLE                                                         \
-  virtual void accept(Visitor &v) const override { v.visit(getptr()); }
-
 namespace lang {
 namespace compiler {
 namespace ast {
 
-class Visitor;
+enum class Kind : uint8_t {
+  Assignment,
+  BinaryExpression,
+  Call,
+  Function,
+  If,
+  Identifier,
+  Integer,
+  Parameter,
+  Prototype,
+  TupleAssignment,
+  Value,
+};
 
+// Nodes are allocated in the Context's Arena and link to their children with
+// plain pointers; they are never destroyed individually, so they must stay
+// trivially destructible. They carry no vtable: passes dispatch on `kind`
+// through Visitor below.
 class Expression {
+  const Kind kind_;
+
+protected:
+  Expression(Kind kind) : kind_(kind) {}
+
 public:
-  Expression() = default;
   Expression(const Expression &) = delete;
   Expression(Expression &&) = delete;
 
-  virtual ~Expression() = default;
+  Kind kind() const { return kind_; }
 
-  virtual void print(std::ostream &out, int indent = 0) const = 0;
-
-  virtual void accept(Visitor &) const = 0;
-
-  friend std::ostream &operator<<(std::ostream &out, const Expression &node) {
-    node.print(out);
-    return out;
-  }
+  // names resolves the Symbols held by the tree.
+  void print(std::ostream &out, const Interner &names, int indent = 0) const;
 };
 
-typedef std::vector<std::shared_ptr<const Expression>> Expressions;
+typedef Span<const Expression *> Expressions;
 
 class Assignment;
 class BinaryExpression;
@@ -46,281 +61,254 @@ class Prototype;
 class TupleAssignment;
 class Value;
 
-class Visitor {
+// Visitor dispatches an Expression to `Derived::visit(const T &)` for its
+// concrete type T. The dispatch is a switch on the node kind, resolved at
+// compile time per pass, so visit calls can be inlined. Each visit returns
+// Result.
+template <typename Derived, typename Result = void> class Visitor {
 public:
-  virtual void visit(std::shared_ptr<const Assignment>) = 0;
-  virtual void visit(std::shared_ptr<const BinaryExpression>) = 0;
-  virtual void visit(std::shared_ptr<const Call>) = 0;
-  virtual void visit(std::shared_ptr<const Function>) = 0;
-  virtual void visit(std::shared_ptr<const If>) = 0;
-  virtual void visit(std::shared_ptr<const Identifier>) = 0;
-  virtual void visit(std::shared_ptr<const Integer>) = 0;
-  virtual void visit(std::shared_ptr<const Parameter>) = 0;
-  virtual void visit(std::shared_ptr<const Prototype>) = 0;
-  virtual void visit(std::shared_ptr<const TupleAssignment>) = 0;
-  virtual void visit(std::shared_ptr<const Value>) = 0;
+  Result dispatch(const Expression &expr);
 };
 
-class NoopVisitor : public Visitor {
-  void visit(std::shared_ptr<const Assignment>) {}
-  void visit(std::shared_ptr<const BinaryExpression>) {}
-  void visit(std::shared_ptr<const Call>) {}
-  void visit(std::shared_ptr<const Function>) {}
-  void visit(std::shared_ptr<const If>) {}
-  void visit(std::shared_ptr<const Identifier>) {}
-  void visit(std::shared_ptr<const Integer>) {}
-  void visit(std::shared_ptr<const Parameter>) {}
-  void visit(std::shared_ptr<const Prototype>) {}
-  void visit(std::shared_ptr<const TupleAssignment>) {}
-  void visit(std::shared_ptr<const Value>) {}
+// NoopVisitor ignores every node; passes that only care about a few node
+// kinds derive from it and pull its visits in with a using declaration.
+template <typename Derived> class NoopVisitor : public Visitor<Derived> {
+public:
+  void visit(const Assignment &) {}
+  void visit(const BinaryExpression &) {}
+  void visit(const Call &) {}
+  void visit(const Function &) {}
+  void visit(const If &) {}
+  void visit(const Identifier &) {}
+  void visit(const Integer &) {}
+  void visit(const Parameter &) {}
+  void visit(const Prototype &) {}
+  void visit(const TupleAssignment &) {}
+  void visit(const Value &) {}
 };
 
-class Assignment : public Expression,
-                   public std::enable_shared_from_this<Assignment> {
-  std::shared_ptr<const Expression> left_;
-  std::shared_ptr<const Expression> right_;
+class Assignment : public Expression {
+  const Expression *left_;
+  const Expression *right_;
 
 public:
-  Assignment(std::shared_ptr<const Expression> left,
-             std::shared_ptr<const Expression> right)
-      : left_(std::move(left)), right_(std::move(right)) {}
+  Assignment(const Expression *left, const Expression *right)
+      : Expression(Kind::Assignment), left_(left), right_(right) {}
 
   Assignment(const Assignment &) = delete;
   Assignment(Assignment &&) = delete;
 
-  std::shared_ptr<const Assignment> getptr() const {
-    return shared_from_this();
-  }
+  const Expression &left() const { return *left_; }
+  const Expression &right() const { return *right_; }
 
-  virtual void print(std::ostream &out, int indent = 0) const override;
-  MAKE_VISITABLE;
+  void print(std::ostream &out, const Interner &names, int indent = 0) const;
 };
 
-class BinaryExpression : public Expression,
-                         public std::enable_shared_from_this<BinaryExpression> {
+class BinaryExpression : public Expression {
   const char op_;
-  std::shared_ptr<const Expression> left_, right_;
+  const Expression *left_, *right_;
 
 public:
-  BinaryExpression(char op, std::shared_ptr<const Expression> left,
-                   std::shared_ptr<const Expression> right)
-      : op_(op), left_(std::move(left)), right_(std::move(right)) {}
+  BinaryExpression(char op, const Expression *left, const Expression *right)
+      : Expression(Kind::BinaryExpression), op_(op), left_(left),
+        right_(right) {}
   BinaryExpression(const BinaryExpression &) = delete;
   BinaryExpression(BinaryExpression &&) = delete;
 
-  std::shared_ptr<BinaryExpression const> getptr() const {
-    return shared_from_this();
-  }
-
   char op() const { return op_; }
   const Expression &right() const { return *right_; }
   const Expression &left() const { return *left_; }
-  virtual void print(std::ostream &out, int indent = 0) const override;
-  MAKE_VISITABLE;
+  void print(std::ostream &out, const Interner &names, int indent = 0) const;
 };
 
-class Call : public Expression, public std::enable_shared_from_this<Call> {
-  const std::string name_;
+class Call : public Expression {
+  const Symbol name_;
   const Expressions args_;
 
 public:
-  Call(const std::string &name, Expressions args)
-      : name_(name), args_(std::move(args)) {}
+  Call(Symbol name, Expressions args)
+      : Expression(Kind::Call), name_(name), args_(args) {}
   Call(const Call &) = delete;
   Call(Call &&) = delete;
 
-  std::shared_ptr<Call const> getptr() const { return shared_from_this(); }
-
-  const std::string &name() const { return name_; }
+  Symbol name() const { return name_; }
   const Expressions &args() const { return args_; }
 
-  virtual void print(std::ostream &out, int indent = 0) const override;
-  MAKE_VISITABLE;
+  void print(std::ostream &out, const Interner &names, int indent = 0) const;
 };
 
-class Function : public std::enable_shared_from_this<Function>,
-                 public Expression {
-  std::shared_ptr<const Prototype> prototype_;
+class Function : public Expression {
+  const Prototype *prototype_;
   const Expressions body_;
 
 public:
-  Function(std::shared_ptr<const Prototype> prototype, Expressions body)
-      : prototype_(std::move(prototype)), body_(std::move(body)) {}
+  Function(const Prototype *prototype, Expressions body)
+      : Expression(Kind::Function), prototype_(prototype), body_(body) {}
   Function(const Function &) = delete;
   Function(Function &&) = delete;
 
-  std::shared_ptr<Function const> getptr() const { return shared_from_this(); }
-
   const Prototype &proto() const { return *prototype_; }
   const Expressions &body() const { return body_; }
 
-  virtual void print(std::ostream &out, int indent = 0) const override;
-
-  MAKE_VISITABLE;
+  void print(std::ostream &out, const Interner &names, int indent = 0) const;
 };
 
-class If : public Expression, public std::enable_shared_from_this<If> {
-  std::shared_ptr<const Expression> cond_;
+class If : public Expression {
+  const Expression *cond_;
   const Expressions then_;
   const Expressions else_;
 
 public:
-  If(std::shared_ptr<const Expression> cond, Expressions thn, Expressions els)
-      : cond_(std::move(cond)), then_(std::move(thn)), else_(std::move(els)) {}
+  If(const Expression *cond, Expressions thn, Expressions els)
+      : Expression(Kind::If), cond_(cond), then_(thn), else_(els) {}
   If(const If &) = delete;
   If(If &&) = delete;
 
-  std::shared_ptr<If const> getptr() const { return shared_from_this(); }
-
   const Expression &cond() const { return *cond_; }
   const Expressions &thn() const { return then_; }
   const Expressions &els() const { return else_; }
 
-  virtual void print(std::ostream &out, int indent = 0) const override;
-  MAKE_VISITABLE;
+  void print(std::ostream &out, const Interner &names, int indent = 0) const;
 };
 
-class Identifier : public Expression,
-                   public std::enable_shared_from_this<Identifier> {
-  const std::string name_;
+class Identifier : public Expression {
+  const Symbol name_;
 
 public:
-  Identifier(const std::string &name) : name_(name) {}
+  Identifier(Symbol name) : Expression(Kind::Identifier), name_(name) {}
   Identifier(const Identifier &) = delete;
   Identifier(Identifier &&) = delete;
 
-  std::shared_ptr<Identifier const> getptr() const {
-    return shared_from_this();
-  }
-
-  const std::string &name() const { return name_; }
+  Symbol name() const { return name_; }
 
-  void print(std::ostream &out, int indent = 0) const override;
-  MAKE_VISITABLE;
+  void print(std::ostream &out, const Interner &names, int indent = 0) const;
 };
 
-class Integer : public Expression,
-                public std::enable_shared_from_this<Integer> {
+class Integer : public Expression {
   const long value_;
 
 public:
-  Integer(long value) : value_(value) {}
+  Integer(long value) : Expression(Kind::Integer), value_(value) {}
   Integer(const Integer &) = delete;
   Integer(Integer &&) = delete;
 
-  std::shared_ptr<Integer const> getptr() const { return shared_from_this(); }
-
   long value() const { return value_; }
 
-  void print(std::ostream &out, int indent = 0) const override;
-  MAKE_VISITABLE;
+  void print(std::ostream &out, const Interner &names, int indent = 0) const;
 };
 
-class Prototype : public Expression,
-                  public std::enable_shared_from_this<Prototype> {
-  const std::string name_;
-  const std::vector<std::shared_ptr<const Parameter>> params_;
+class Prototype : public Expression {
+  const Symbol name_;
+  const Span<const Parameter *> params_;
 
 public:
-  Prototype(const std::string &name,
-            std::vector<std::shared_ptr<const Parameter>> params)
-      : name_(name), params_(std::move(params)){};
+  Prototype(Symbol name, Span<const Parameter *> params)
+      : Expression(Kind::Prototype), name_(name), params_(params){};
   Prototype(const Prototype &) = delete;
   Prototype(Prototype &&) = delete;
 
-  std::shared_ptr<Prototype const> getptr() const { return shared_from_this(); }
-
-  const std::string &name() const { return name_; }
-  const std::vector<std::shared_ptr<const Parameter>> &params() const {
-    return params_;
-  }
+  Symbol name() const { return name_; }
+  const Span<const Parameter *> &params() const { return params_; }
 
-  virtual void print(std::ostream &out, int indent = 0) const override;
-  MAKE_VISITABLE;
+  void print(std::ostream &out, const Interner &names, int indent = 0) const;
 };
 
-class TupleAssignment : public Expression,
-                        public std::enable_shared_from_this<TupleAssignment> {
+class TupleAssignment : public Expression {
   const Expressions left_;
   const Expressions right_;
 
 public:
   TupleAssignment(Expressions left, Expressions right)
-      : left_(std::move(left)), right_(std::move(right)) {}
+      : Expression(Kind::TupleAssignment), left_(left), right_(right) {}
 
   TupleAssignment(const TupleAssignment &) = delete;
   TupleAssignment(TupleAssignment &&) = delete;
 
-  std::shared_ptr<TupleAssignment const> getptr() const {
-    return shared_from_this();
-  }
+  const Expressions &left() const { return left_; }
+  const Expressions &right() const { return right_; }
 
-  virtual void print(std::ostream &out, int indent = 0) const override;
-  MAKE_VISITABLE;
+  void print(std::ostream &out, const Interner &names, int indent = 0) const;
 };
 
 class BaseValue : public Expression {
 protected:
   const bool constant_;
-  const std::string name_;
+  const Symbol name_;
+
+  const Expression *value_;
 
-  std::shared_ptr<const Expression> value_;
+  BaseValue(Kind kind, bool constant, Symbol name, const Expression *value)
+      : Expression(kind), constant_(constant), name_(name), value_(value) {}
 
 public:
-  BaseValue(bool constant, const std::string &name)
-      : constant_(constant), name_(name), value_(nullptr) {}
-  BaseValue(bool constant, const std::string &name,
-            std::shared_ptr<const Expression> value)
-      : constant_(constant), name_(name), value_(std::move(value)) {}
   BaseValue(const Value &) = delete;
   BaseValue(Value &&) = delete;
 
-  virtual ~BaseValue() = default;
-
   bool constant() const { return constant_; }
-  const std::string &name() const { return name_; }
+  Symbol name() const { return name_; }
+  bool has_value() const { return value_ != nullptr; }
   const Expression &value() const { return *value_; }
 };
 
-class Value : public BaseValue, public std::enable_shared_from_this<Value> {
+class Value : public BaseValue {
 public:
-  Value(bool constant, const std::string &name) : BaseValue(constant, name) {}
-  Value(bool constant, const std::string &name,
-        std::shared_ptr<const Expression> value)
-      : BaseValue(constant, name, std::move(value)) {}
+  Value(bool constant, Symbol name)
+      : BaseValue(Kind::Value, constant, name, nullptr) {}
+  Value(bool constant, Symbol name, const Expression *value)
+      : BaseValue(Kind::Value, constant, name, value) {}
   Value(const Value &) = delete;
   Value(Value &&) = delete;
 
-  std::shared_ptr<Value const> getptr() const { return shared_from_this(); }
-
-  bool constant() const { return constant_; }
-  const std::string &name() const { return name_; }
-  const Expression &value() const { return *value_; }
-
-  virtual void print(std::ostream &out, int indent = 0) const override;
-  MAKE_VISITABLE;
+  void print(std::ostream &out, const Interner &names, int indent = 0) const;
 };
 
-class Parameter : public BaseValue,
-                  public std::enable_shared_from_this<Parameter> {
+class Parameter : public BaseValue {
 public:
-  Parameter(bool constant, const std::string &name)
-      : BaseValue(constant, name) {}
+  Parameter(bool constant, Symbol name)
+      : BaseValue(Kind::Parameter, constant, name, nullptr) {}
   Parameter(const Parameter &) = delete;
   Parameter(Parameter &&) = delete;
 
-  std::shared_ptr<Parameter const> getptr() const { return shared_from_this(); }
-
-  virtual void print(std::ostream &out, int indent = 0) const override;
-  MAKE_VISITABLE;
+  void print(std::ostream &out, const Interner &names, int indent = 0) const;
 };
 
+template <typename Derived, typename Result>
+Result Visitor<Derived, Result>::dispatch(const Expression &expr) {
+  auto &self = static_cast<Derived &>(*this);
+  switch (expr.kind()) {
+  case Kind::Assignment:
+    return self.visit(static_cast<const Assignment &>(expr));
+  case Kind::BinaryExpression:
+    return self.visit(static_cast<const BinaryExpression &>(expr));
+  case Kind::Call:
+    return self.visit(static_cast<const Call &>(expr));
+  case Kind::Function:
+    return self.visit(static_cast<const Function &>(expr));
+  case Kind::If:
+    return self.visit(static_cast<const If &>(expr));
+  case Kind::Identifier:
+    return self.visit(static_cast<const Identifier &>(expr));
+  case Kind::Integer:
+    return self.visit(static_cast<const Integer &>(expr));
+  case Kind::Parameter:
+    return self.visit(static_cast<const Parameter &>(expr));
+  case Kind::Prototype:
+    return self.visit(static_cast<const Prototype &>(expr));
+  case Kind::TupleAssignment:
+    return self.visit(static_cast<const TupleAssignment &>(expr));
+  case Kind::Value:
+    return self.visit(static_cast<const Value &>(expr));
+  }
+  assert(false && "unknown expression kind");
+  __builtin_unreachable();
+}
+
 } // namespace ast
 
 namespace cfg {
 
 class BasicBlock {
-  std::vector<std::shared_ptr<const ast::Expression>> expressions_;
+  std::vector<const ast::Expression *> expressions_;
   std::vector<std::unique_ptr<const BasicBlock>> exits_;
 
 public:
@@ -329,14 +317,9 @@ public:
   BasicBlock(BasicBlock &&) = delete;
 
   bool empty() const;
-  void emplace_back(std::shared_ptr<const ast::Expression>);
+  void emplace_back(const ast::Expression *);
 
-  void print(std::ostream &out, int indent = 0) const;
-
-  friend std::ostream &operator<<(std::ostream &out, const BasicBlock &block) {
-    block.print(out);
-    return out;
-  }
+  void print(std::ostream &out, const Interner &names, int indent = 0) const;
 };
 
 } // namespace cfg
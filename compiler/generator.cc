@@ -0,0 +1,207 @@
+#include "generator.h"
+#include <algorithm>
+#include <string>
+#include <vector>
+
+namespace lang {
+namespace compiler {
+namespace gen {
+
+namespace {
+
+const char *const SYLLABLES[] = {"ka", "lo", "mi", "ne", "ru", "ta",
+                                 "vi", "zo", "be", "du", "fa", "go",
+                                 "hi", "ju", "pe", "so"};
+
+const char *const OPERATORS[] = {" + ", " - ", " * "};
+
+// Generator writes one program. Names in scope are the parameters and vals
+// of the fn being written that dominate the point being written, so every
+// program generates. Division is left out as it may divide by zero.
+class Generator {
+  const Shape &shape_;
+  uint64_t state_;
+  std::vector<std::string> words_;
+  // parameters of each fn written so far.
+  std::vector<uint32_t> arities_;
+
+  // the fn being written, and its text.
+  size_t fn_;
+  std::string text_;
+  // names in scope, by their index among the names of fn_.
+  std::vector<size_t> scope_;
+  size_t names_;
+  // where in words_ the names of fn_ start.
+  size_t offset_;
+
+  // splitmix64, as standard distributions differ between libraries.
+  uint64_t next() {
+    uint64_t z = (state_ += 0x9e3779b97f4a7c15);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+    return z ^ (z >> 31);
+  }
+  size_t uniform(size_t n) { return n > 0 ? next() % n : 0; }
+
+  void indent(size_t level) { text_.append(2 * level, ' '); }
+
+  void name(size_t index) {
+    text_ += words_[(offset_ + index) % words_.size()];
+    if (index >= words_.size()) {
+      text_ += std::to_string(index / words_.size());
+    }
+  }
+
+  void fn_name(size_t fn) {
+    text_ += words_[fn % words_.size()];
+    text_ += '_';
+    text_ += std::to_string(fn);
+  }
+
+  void leaf() {
+    if (scope_.empty() || uniform(4) == 0) {
+      text_ += std::to_string(uniform(1000));
+    } else {
+      name(scope_[uniform(scope_.size())]);
+    }
+  }
+
+  // An expression of up to depth operators on the right. It never starts
+  // with a parenthesis, which call arguments may not.
+  void expression(size_t depth) {
+    if (depth == 0) {
+      leaf();
+      return;
+    }
+    expression(uniform(depth));
+    text_ += OPERATORS[uniform(3)];
+    if (depth > 1 && uniform(2) == 0) {
+      text_ += '(';
+      expression(depth - 1);
+      text_ += ')';
+    } else {
+      leaf();
+    }
+  }
+
+  void call() {
+    auto callee = uniform(fn_);
+    fn_name(callee);
+    text_ += '(';
+    for (size_t i = 0; i < arities_[callee]; ++i) {
+      text_ += i > 0 ? ", " : "";
+      expression(std::min<size_t>(shape_.depth, 1));
+    }
+    text_ += ')';
+  }
+
+  // An expression with calls added to it. The parser takes a lone operand
+  // followed by a keyword for an error, so there is always an operator.
+  void value(size_t calls) {
+    expression(std::max<size_t>(shape_.depth, 1));
+    for (size_t i = 0; i < calls; ++i) {
+      text_ += " + ";
+      call();
+    }
+  }
+
+  // vals, then an expression or, with nesting left, an if chain. calls are
+  // spread over the statements.
+  void block(size_t level, size_t vals, size_t nesting, size_t calls) {
+    auto scope = scope_.size();
+    auto share = [vals, calls](size_t statement) {
+      return calls / (vals + 1) + (statement < calls % (vals + 1));
+    };
+    for (size_t i = 0; i < vals; ++i) {
+      indent(level);
+      text_ += "val ";
+      name(names_);
+      text_ += " = ";
+      value(share(i));
+      text_ += '\n';
+      scope_.push_back(names_++);
+    }
+    if (nesting > 0 && (level == 1 || uniform(2) == 0)) {
+      chain(level, nesting, share(vals));
+    } else {
+      indent(level);
+      value(share(vals));
+      text_ += '\n';
+    }
+    scope_.resize(scope);
+  }
+
+  void chain(size_t level, size_t nesting, size_t calls) {
+    indent(level);
+    text_ += "if ";
+    value(calls);
+    text_ += " {\n";
+    block(level + 1, shape_.body / 2, nesting - 1, 0);
+    for (size_t elifs = uniform(3); elifs > 0; --elifs) {
+      indent(level);
+      text_ += "} elif ";
+      value(0);
+      text_ += " {\n";
+      block(level + 1, shape_.body / 2, nesting - 1, 0);
+    }
+    indent(level);
+    text_ += "} else {\n";
+    block(level + 1, shape_.body / 2, nesting - 1, 0);
+    indent(level);
+    text_ += "}\n";
+  }
+
+  void fn() {
+    text_.clear();
+    names_ = 0;
+    offset_ = uniform(words_.size());
+    auto arity = 1 + uniform(std::max<size_t>(shape_.params, 1));
+    arities_.push_back(arity);
+
+    text_ += "fn ";
+    fn_name(fn_);
+    text_ += '(';
+    for (size_t i = 0; i < arity; ++i) {
+      text_ += i > 0 ? ", " : "";
+      name(names_);
+      scope_.push_back(names_++);
+    }
+    text_ += ") = {\n";
+    block(1, shape_.body, shape_.nesting, fn_ > 0 ? shape_.fanout : 0);
+    text_ += "}\n\n";
+    scope_.clear();
+  }
+
+public:
+  explicit Generator(const Shape &shape)
+      : shape_(shape), state_(shape.seed), fn_(0), names_(0), offset_(0) {
+    for (size_t k = 0; k < std::max<size_t>(shape.vocabulary, 1); ++k) {
+      std::string word;
+      // two syllables at least, so no word is a keyword.
+      for (size_t s = k, n = 0; s > 0 || n < 2; s /= 16, ++n) {
+        word += SYLLABLES[s % 16];
+      }
+      words_.push_back(word);
+    }
+  }
+
+  void run(std::ostream &out) {
+    size_t lines = 0;
+    for (; shape_.lines > 0 ? lines < shape_.lines : fn_ < shape_.fns;
+         ++fn_) {
+      fn();
+      lines += std::count(text_.begin(), text_.end(), '\n');
+      out.write(text_.data(), text_.size());
+    }
+  }
+};
+
+} // namespace
+
+void generate(const Shape &shape, std::ostream &out) {
+  Generator(shape).run(out);
+}
+
+} // namespace gen
+} // namespace compiler
+} // namespace lang
@@ -0,0 +1,44 @@
+#ifndef LANG_COMPILER_GENERATOR_H
+#define LANG_COMPILER_GENERATOR_H
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+
+namespace lang {
+namespace compiler {
+namespace gen {
+
+// Shape is what a generated program looks like.
+struct Shape {
+  // the same seed and shape always give the same program.
+  uint64_t seed = 1;
+  // top-level fns; ignored if lines is not zero.
+  size_t fns = 100;
+  // write fns until there are at least this many lines.
+  size_t lines = 0;
+  // vals at the start of each fn body; branches get half as many.
+  size_t body = 4;
+  // most levels of operators in an expression.
+  size_t depth = 3;
+  // most levels of if/elif/else chains in a fn.
+  size_t nesting = 2;
+  // calls in each fn, to fns defined before it.
+  size_t fanout = 2;
+  // distinct words that parameters and vals are named with.
+  size_t vocabulary = 64;
+  // most parameters of a fn.
+  size_t params = 3;
+};
+
+// Writes a program of the given shape to out, a fn at a time, so it can be
+// as large as out can take. Programs parse and generate without errors.
+// Calls only go to earlier fns, so programs terminate when run, but not
+// quickly: they are meant to be compiled.
+void generate(const Shape &shape, std::ostream &out);
+
+} // namespace gen
+} // namespace compiler
+} // namespace lang
+
+#endif // LANG_COMPILER_GENERATOR_H
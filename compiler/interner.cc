@@ -0,0 +1,42 @@
+#include "interner.h"
+#include <cassert>
+#include <mutex>
+
+namespace lang {
+namespace compiler {
+
+Symbol Interner::intern(std::string_view name) {
+  {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    auto it = ids_.find(name);
+    if (it != ids_.end()) {
+      return Symbol(it->second);
+    }
+  }
+
+  std::unique_lock<std::shared_mutex> lock(mutex_);
+  // another thread may have interned name between the two locks.
+  auto it = ids_.find(name);
+  if (it != ids_.end()) {
+    return Symbol(it->second);
+  }
+
+  uint32_t id = names_.size();
+  names_.emplace_back(name);
+  ids_.emplace(names_.back(), id);
+  return Symbol(id);
+}
+
+const std::string &Interner::name(Symbol symbol) const {
+  std::shared_lock<std::shared_mutex> lock(mutex_);
+  assert(symbol.id() < names_.size());
+  return names_[symbol.id()];
+}
+
+size_t Interner::size() const {
+  std::shared_lock<std::shared_mutex> lock(mutex_);
+  return names_.size();
+}
+
+} // namespace compiler
+} // namespace lang
@@ -0,0 +1,64 @@
+#ifndef LANG_COMPILER_INTERNER_H
+#define LANG_COMPILER_INTERNER_H
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace lang {
+namespace compiler {
+
+// Symbol is a dense 32-bit id for an interned name. Two symbols handed out by
+// the same Interner are equal iff their names are equal.
+class Symbol {
+  uint32_t id_;
+
+public:
+  static const uint32_t INVALID = UINT32_MAX;
+
+  Symbol() : id_(INVALID) {}
+  explicit Symbol(uint32_t id) : id_(id) {}
+
+  uint32_t id() const { return id_; }
+  bool valid() const { return id_ != INVALID; }
+
+  bool operator==(const Symbol &other) const { return id_ == other.id_; }
+  bool operator!=(const Symbol &other) const { return id_ != other.id_; }
+  bool operator<(const Symbol &other) const { return id_ < other.id_; }
+};
+
+// Interner maps names to Symbols. It is owned by the GlobalContext and may be
+// shared by Contexts on different threads; lookups of already interned names
+// only take a shared lock.
+class Interner {
+  mutable std::shared_mutex mutex_;
+  // names_ never relocates its strings, so ids_ can key on views into it.
+  std::deque<std::string> names_;
+  std::unordered_map<std::string_view, uint32_t> ids_;
+
+public:
+  Interner() {}
+  Interner(const Interner &) = delete;
+  Interner(Interner &&) = delete;
+
+  Symbol intern(std::string_view name);
+  const std::string &name(Symbol symbol) const;
+  size_t size() const;
+};
+
+} // namespace compiler
+} // namespace lang
+
+namespace std {
+template <> struct hash<lang::compiler::Symbol> {
+  size_t operator()(const lang::compiler::Symbol &symbol) const {
+    return symbol.id();
+  }
+};
+} // namespace std
+
+#endif // LANG_COMPILER_INTERNER_H
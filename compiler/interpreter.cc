@@ -0,0 +1,212 @@
+#include "interpreter.h"
+#include "native.h"
+#include <limits>
+
+// Dispatch jumps straight from one handler to the next through a table of
+// label addresses where the compiler supports it, and falls back to a switch
+// in a loop elsewhere.
+#if defined(__GNUC__) || defined(__clang__)
+#define LANG_COMPUTED_GOTO 1
+#else
+#define LANG_COMPUTED_GOTO 0
+#endif
+
+namespace lang {
+namespace compiler {
+namespace bytecode {
+
+Interpreter::Interpreter(Program &program, const Interner &names,
+                         size_t size)
+    : program_(program), names_(names), stack_(new int64_t[size]),
+      size_(size), profiles_(new Profile[program.functions().size()]),
+      tiering_(nullptr), threshold_(0) {}
+
+void Interpreter::set_tiering(Tiering *tiering, uint64_t threshold) {
+  tiering_ = tiering;
+  threshold_ = threshold;
+}
+
+void Interpreter::promote(uint32_t fn, uintptr_t entry) {
+  profiles_[fn].native.store(entry, std::memory_order_release);
+}
+
+void Interpreter::heat(const Function *fn, bool backedge) {
+  auto index = uint32_t(fn - program_.functions().data());
+  auto &profile = profiles_[index];
+  ++(backedge ? profile.backedges : profile.calls);
+  // counts only go up by one, so their sum hits the threshold exactly once.
+  if (profile.calls + profile.backedges == threshold_ && tiering_ != nullptr &&
+      fn->params <= native::MAX_ARGS) {
+    tiering_->hot(index);
+  }
+}
+
+std::unique_ptr<const err::Error>
+Interpreter::run(Symbol name, const std::vector<int64_t> &args,
+                 int64_t &result) {
+  auto fn = program_.lookup(name);
+  if (fn == nullptr) {
+    return err::bytecode("undefined fn " + names_.name(name), "");
+  }
+  if (fn->params != args.size()) {
+    return err::bytecode("fn " + names_.name(name) + " takes " +
+                             std::to_string(fn->params) + " arguments",
+                         std::to_string(args.size()) + " given");
+  }
+
+  auto &functions = program_.functions();
+  auto &profile = profiles_[fn - functions.data()];
+  if (auto entry = profile.native.load(std::memory_order_acquire)) {
+    result = native::call(entry, args.data(), args.size());
+    return nullptr;
+  }
+
+  int64_t *const end = stack_.get() + size_;
+  int64_t *r = stack_.get();
+  const Instruction *pc = nullptr;
+  frames_.clear();
+
+  // wrapping arithmetic, as in the generated code.
+  auto wrap = [](uint64_t value) { return static_cast<int64_t>(value); };
+
+  // enters fn with its frame at r, or fails.
+  auto enter = [&](const Function *callee)
+      -> std::unique_ptr<const err::Error> {
+    if (callee->code.empty()) {
+      return err::bytecode("fn " + names_.name(callee->name) +
+                               " failed to compile",
+                           "");
+    }
+    if (callee->registers > end - r) {
+      return err::bytecode("stack overflow",
+                           "in fn " + names_.name(callee->name));
+    }
+    fn = callee;
+    pc = callee->code.data();
+    heat(callee, false);
+    return nullptr;
+  };
+
+  std::copy(args.begin(), args.end(), r);
+  if (auto error = enter(fn)) {
+    return error;
+  }
+
+#if LANG_COMPUTED_GOTO
+  static void *const labels[] = {&&Move, &&Int,    &&Add,  &&Sub,
+                                 &&Mul,  &&Div,    &&Jump, &&JumpUnless,
+                                 &&Call, &&Return, &&CallNative};
+#define CASE(op) op:
+#define DISPATCH() goto *labels[static_cast<uint8_t>(pc->op)]
+  DISPATCH();
+#else
+#define CASE(op) case Op::op:
+#define DISPATCH() continue
+  for (;;) {
+    switch (pc->op) {
+#endif
+
+  CASE(Move) {
+    r[pc->a] = r[pc->b];
+    ++pc;
+    DISPATCH();
+  }
+  CASE(Int) {
+    r[pc->a] = fn->constants[pc->b];
+    ++pc;
+    DISPATCH();
+  }
+  CASE(Add) {
+    r[pc->a] = wrap(uint64_t(r[pc->b]) + uint64_t(r[pc->c]));
+    ++pc;
+    DISPATCH();
+  }
+  CASE(Sub) {
+    r[pc->a] = wrap(uint64_t(r[pc->b]) - uint64_t(r[pc->c]));
+    ++pc;
+    DISPATCH();
+  }
+  CASE(Mul) {
+    r[pc->a] = wrap(uint64_t(r[pc->b]) * uint64_t(r[pc->c]));
+    ++pc;
+    DISPATCH();
+  }
+  CASE(Div) {
+    auto divisor = r[pc->c];
+    auto dividend = r[pc->b];
+    r[pc->a] = divisor == 0    ? 0
+               : divisor == -1 ? wrap(0 - uint64_t(dividend))
+                               : dividend / divisor;
+    ++pc;
+    DISPATCH();
+  }
+  CASE(Jump) {
+    auto target = fn->code.data() + pc->target();
+    if (target <= pc) {
+      heat(fn, true);
+    }
+    pc = target;
+    DISPATCH();
+  }
+  CASE(JumpUnless) {
+    if (r[pc->a] == 1) {
+      ++pc;
+      DISPATCH();
+    }
+    auto target = fn->code.data() + pc->target();
+    if (target <= pc) {
+      heat(fn, true);
+    }
+    pc = target;
+    DISPATCH();
+  }
+  CASE(Call) {
+    if (profiles_[fn->callees[pc->b]].native.load(std::memory_order_acquire)) {
+      // only the interpreting thread reads code, so patching it is safe.
+      const_cast<Instruction *>(pc)->op = Op::CallNative;
+      DISPATCH();
+    }
+    if (frames_.size() == size_) {
+      return err::bytecode("stack overflow", "in fn " + names_.name(fn->name));
+    }
+    frames_.push_back(Frame{fn, pc, r});
+    r += pc->c;
+    if (auto error = enter(&functions[fn->callees[pc->b]])) {
+      return error;
+    }
+    DISPATCH();
+  }
+  CASE(Return) {
+    auto value = r[pc->a];
+    if (frames_.empty()) {
+      result = value;
+      return nullptr;
+    }
+    auto &frame = frames_.back();
+    fn = frame.fn;
+    pc = frame.pc;
+    r = frame.registers;
+    frames_.pop_back();
+    r[pc->a] = value;
+    ++pc;
+    DISPATCH();
+  }
+  CASE(CallNative) {
+    auto callee = fn->callees[pc->b];
+    auto entry = profiles_[callee].native.load(std::memory_order_relaxed);
+    r[pc->a] = native::call(entry, r + pc->c, functions[callee].params);
+    ++pc;
+    DISPATCH();
+  }
+
+#if !LANG_COMPUTED_GOTO
+    }
+  }
+#endif
+#undef CASE
+#undef DISPATCH
+}
+
+} // namespace bytecode
+} // namespace compiler
+} // namespace lang
@@ -0,0 +1,87 @@
+#ifndef LANG_COMPILER_INTERPRETER_H
+#define LANG_COMPILER_INTERPRETER_H
+
+#include "bytecode.h"
+#include "context.h"
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace lang {
+namespace compiler {
+namespace bytecode {
+
+// Tiering is told which fns of a Program get hot, so it can compile them to
+// native code and hand that back through Interpreter::promote.
+class Tiering {
+public:
+  virtual ~Tiering() = default;
+
+  // Called on the interpreting thread, once per fn, when the calls and
+  // back-edges of fn, an index into Program::functions, reach the threshold.
+  // It should not block: the interpreter waits for it.
+  virtual void hot(uint32_t fn) = 0;
+};
+
+// Interpreter runs the fns of a Program. Frames are laid out back to back on
+// one register stack; running past its end is an error rather than a crash.
+//
+// It counts the calls and back-edges of every fn. Once a fn is promoted to
+// native code, each Call to it is patched into a CallNative the next time it
+// runs, so the Program is the interpreter's to modify.
+class Interpreter {
+public:
+  struct Profile {
+    uint64_t calls = 0;
+    uint64_t backedges = 0;
+    // entry point of the fn's native code, or 0 while it is interpreted.
+    std::atomic<uintptr_t> native{0};
+  };
+
+private:
+  struct Frame {
+    const Function *fn;
+    const Instruction *pc;
+    int64_t *registers;
+  };
+
+  Program &program_;
+  const Interner &names_;
+  std::unique_ptr<int64_t[]> stack_;
+  const size_t size_;
+  std::vector<Frame> frames_;
+  std::unique_ptr<Profile[]> profiles_;
+  Tiering *tiering_;
+  uint64_t threshold_;
+
+  // Counts a call or, if backedge, a back-edge of fn.
+  void heat(const Function *fn, bool backedge);
+
+public:
+  // Stack size, in registers, unless told otherwise.
+  static const size_t STACK_SIZE = 1 << 20;
+
+  Interpreter(Program &program, const Interner &names,
+              size_t size = STACK_SIZE);
+
+  // Tells tiering about fns whose calls and back-edges reach threshold. Fns
+  // that take more than native::MAX_ARGS arguments are never hot.
+  void set_tiering(Tiering *tiering, uint64_t threshold);
+  // Runs fn, an index into Program::functions, through the native code at
+  // entry from now on. entry must take the fn's arguments as int64s and
+  // return an int64. Safe to call from any thread.
+  void promote(uint32_t fn, uintptr_t entry);
+  const Profile &profile(uint32_t fn) const { return profiles_[fn]; }
+
+  // Calls fn name with args and stores what it returns in result.
+  std::unique_ptr<const err::Error> run(Symbol name,
+                                        const std::vector<int64_t> &args,
+                                        int64_t &result);
+};
+
+} // namespace bytecode
+} // namespace compiler
+} // namespace lang
+
+#endif // LANG_COMPILER_INTERPRETER_H
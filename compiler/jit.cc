@@ -0,0 +1,334 @@
+#include "jit.h"
+#include "check.h"
+#include "definitions.h"
+#include "native.h"
+#include <mutex>
+#include <utility>
+
+#include <llvm/ExecutionEngine/Orc/CompileUtils.h>
+#include <llvm/ExecutionEngine/Orc/ThreadSafeModule.h>
+#include <llvm/Support/Error.h>
+#include <llvm/Support/ErrorHandling.h>
+#include <llvm/Support/TargetSelect.h>
+
+using namespace llvm;
+
+namespace lang {
+namespace compiler {
+namespace jit {
+
+namespace {
+
+std::unique_ptr<const err::Error> to_error(const std::string &msg,
+                                           llvm::Error error) {
+  return err::jit(msg, toString(std::move(error)));
+}
+
+// The name a lazily compiled fn is defined under; its stub takes the fn's
+// own name, so calls from other fns go through the stub.
+std::string implementation(const std::string &name) { return name + ".impl"; }
+
+// fns may be generated on several threads at once; this guards the errors
+// they hand to their unit.
+std::mutex errors;
+
+// Called by a stub whose fn could not be materialized. run() turns away
+// fns that can reach one check() finds a problem in, and Codegen generates
+// every other fn, so this is left for failures of LLVM itself, which it has
+// already reported. Native code has no way to take an error from a stub.
+void lazy_error() { report_fatal_error("cannot generate a called fn", false); }
+
+// What the code a JIT generates depends on, besides the fns themselves.
+std::string flags(const orc::JITTargetMachineBuilder &machine,
+                  codegen::OptLevel level) {
+  return "jit " + machine.getTargetTriple().str() + " " + machine.getCPU() +
+         " " + machine.getFeatures().getString() + " O" +
+         std::to_string(static_cast<int>(level));
+}
+
+// The compiler of a JIT's modules. Tiered looks fns up on its worker while
+// native code calls stubs on the interpreter's thread, so fns are compiled
+// on two threads at once. LLJIT's default compiler shares one TargetMachine,
+// which is not safe; this one makes a TargetMachine for each module.
+Expected<std::unique_ptr<orc::IRCompileLayer::IRCompiler>>
+compiler(orc::JITTargetMachineBuilder machine) {
+  return std::make_unique<orc::ConcurrentIRCompiler>(std::move(machine));
+}
+
+// FunctionUnit generates, optimizes and compiles a single fn of a unit when
+// its stub is first called.
+class FunctionUnit : public orc::MaterializationUnit {
+  orc::LLJIT &lljit_;
+  Context &ctx_;
+  const Definitions &defs_;
+  const ast::Function &fn_;
+  const size_t position_;
+  const codegen::OptLevel level_;
+  // nullptr without a cache.
+  cache::Cache *cache_;
+  const orc::JITTargetMachineBuilder &machine_;
+
+public:
+  FunctionUnit(orc::LLJIT &lljit, Context &ctx, const Definitions &defs,
+               const ast::Function &fn, size_t position,
+               codegen::OptLevel level, cache::Cache *cache,
+               const orc::JITTargetMachineBuilder &machine)
+      : MaterializationUnit(Interface(
+            {{lljit.mangleAndIntern(implementation(
+                  ctx.interner().name(fn.proto().name()))),
+              JITSymbolFlags::Exported | JITSymbolFlags::Callable}},
+            nullptr)),
+        lljit_(lljit), ctx_(ctx), defs_(defs), fn_(fn), position_(position),
+        level_(level), cache_(cache), machine_(machine) {}
+
+  StringRef getName() const override { return "FunctionUnit"; }
+
+  void materialize(std::unique_ptr<orc::MaterializationResponsibility> r)
+      override {
+    std::string key;
+    if (cache_ != nullptr) {
+      key = cache::key(ctx_.interner(), defs_, fn_, position_,
+                       flags(machine_, level_));
+      if (auto object = cache_->get(key)) {
+        lljit_.getObjLinkingLayer().emit(std::move(r), std::move(object));
+        return;
+      }
+    }
+
+    codegen::Shard shard{std::make_unique<LLVMContext>(), nullptr};
+    {
+      codegen::Codegen codegen(ctx_, *shard.llvm, level_);
+      codegen.generate(fn_, defs_, position_);
+      codegen.finish();
+      std::lock_guard<std::mutex> lock(errors);
+      codegen.flush_errors();
+      shard.module = codegen.release();
+    }
+
+    auto name = ctx_.interner().name(fn_.proto().name());
+    auto fn = shard.module->getFunction(name);
+    if (fn == nullptr || fn->isDeclaration()) {
+      lljit_.getExecutionSession().reportError(make_error<StringError>(
+          "cannot generate " + name, inconvertibleErrorCode()));
+      r->failMaterialization();
+      return;
+    }
+
+    fn->setName(implementation(name));
+    shard.module->setDataLayout(lljit_.getDataLayout());
+    if (cache_ == nullptr) {
+      lljit_.getIRTransformLayer().emit(
+          std::move(r), orc::ThreadSafeModule(std::move(shard.module),
+                                              std::move(shard.llvm)));
+      return;
+    }
+
+    // compiled here rather than by lljit_, to keep the object code.
+    orc::ConcurrentIRCompiler compiler(machine_);
+    auto object = compiler(*shard.module);
+    if (!object) {
+      lljit_.getExecutionSession().reportError(object.takeError());
+      r->failMaterialization();
+      return;
+    }
+    cache_->put(key, (*object)->getBuffer());
+    lljit_.getObjLinkingLayer().emit(std::move(r), std::move(*object));
+  }
+
+private:
+  void discard(const orc::JITDylib &, const orc::SymbolStringPtr &) override {}
+};
+
+} // namespace
+
+// -----------------------------------------------------------------------------
+// JIT
+// -----------------------------------------------------------------------------
+JIT::JIT(std::unique_ptr<orc::LLJIT> lljit,
+         orc::JITTargetMachineBuilder machine, codegen::OptLevel level)
+    : lljit_(std::move(lljit)), machine_(std::move(machine)), level_(level),
+      lazy_(nullptr) {}
+
+JIT::~JIT() {}
+
+std::unique_ptr<JIT> JIT::create(std::unique_ptr<const err::Error> &error,
+                                 codegen::OptLevel level) {
+  static std::once_flag once;
+  std::call_once(once, []() {
+    InitializeNativeTarget();
+    InitializeNativeTargetAsmPrinter();
+  });
+
+  // detectHost picks the host CPU and its features, so code is tuned for
+  // the machine it runs on.
+  auto machine = orc::JITTargetMachineBuilder::detectHost();
+  if (!machine) {
+    error = to_error("cannot target host", machine.takeError());
+    return nullptr;
+  }
+  CodeGenOpt::Level levels[] = {CodeGenOpt::None, CodeGenOpt::Less,
+                                CodeGenOpt::Default, CodeGenOpt::Aggressive};
+  machine->setCodeGenOptLevel(levels[static_cast<int>(level)]);
+
+  auto lljit = orc::LLJITBuilder()
+                   .setJITTargetMachineBuilder(*machine)
+                   .setCompileFunctionCreator(&compiler)
+                   .create();
+  if (!lljit) {
+    error = to_error("cannot create jit", lljit.takeError());
+    return nullptr;
+  }
+  return std::unique_ptr<JIT>(
+      new JIT(std::move(*lljit), std::move(*machine), level));
+}
+
+std::unique_ptr<const err::Error> JIT::add(codegen::Shard shard) {
+  for (auto &fn : *shard.module) {
+    if (!fn.isDeclaration()) {
+      arity_[fn.getName().str()] = fn.arg_size();
+    }
+  }
+
+  orc::ThreadSafeModule module(std::move(shard.module), std::move(shard.llvm));
+  if (auto error = lljit_->addIRModule(std::move(module))) {
+    return to_error("cannot add module", std::move(error));
+  }
+  return nullptr;
+}
+
+std::unique_ptr<const err::Error> JIT::add_lazy(Context &ctx,
+                                                cache::Cache *cache) {
+  auto &session = lljit_->getExecutionSession();
+  auto &triple = lljit_->getTargetTriple();
+  if (lazy_ == nullptr) {
+    auto calls = orc::createLocalLazyCallThroughManager(
+        triple, session, pointerToJITTargetAddress(&lazy_error));
+    if (!calls) {
+      return to_error("cannot create stubs", calls.takeError());
+    }
+    auto stubs = orc::createLocalIndirectStubsManagerBuilder(triple);
+    if (!stubs) {
+      return err::jit("cannot create stubs", "no stubs for " + triple.str());
+    }
+    calls_ = std::move(*calls);
+    stubs_ = stubs();
+
+    // implementations call each other through the stubs in the main dylib.
+    lazy_ = &session.createBareJITDylib("<lazy>");
+    lazy_->setLinkOrder({{&lljit_->getMainJITDylib(),
+                          orc::JITDylibLookupFlags::MatchExportedSymbolsOnly}});
+  }
+
+  definitions_.push_back(std::make_unique<Definitions>(ctx));
+  auto &defs = *definitions_.back();
+
+  orc::SymbolAliasMap stubs;
+  llvm::Error error = Error::success();
+  size_t position = 0;
+  ctx.each_expr([&](const ast::Expression &expr) {
+    if (expr.kind() != ast::Kind::Function || error) {
+      ++position;
+      return;
+    }
+    auto &fn = static_cast<const ast::Function &>(expr);
+    if (defs.is_first(fn.proto().name(), position)) {
+      auto name = ctx.interner().name(fn.proto().name());
+      auto checked = check(ctx.interner(), defs, fn, position);
+      if (!checked.problem.empty()) {
+        broken_[name] = checked.problem;
+      }
+      std::vector<std::string> callees;
+      for (auto callee : checked.callees) {
+        callees.push_back(ctx.interner().name(callee));
+      }
+      callees_[name] = std::move(callees);
+      stubs[lljit_->mangleAndIntern(name)] = orc::SymbolAliasMapEntry(
+          lljit_->mangleAndIntern(implementation(name)),
+          JITSymbolFlags::Exported | JITSymbolFlags::Callable);
+      arity_[name] = fn.proto().params().size();
+      stubbed_.insert(name);
+      error = lazy_->define(std::make_unique<FunctionUnit>(
+          *lljit_, ctx, defs, fn, position, level_, cache, machine_));
+    }
+    ++position;
+  });
+  if (error) {
+    return to_error("cannot add fns", std::move(error));
+  }
+
+  if (auto error = lljit_->getMainJITDylib().define(
+          orc::lazyReexports(*calls_, *stubs_, *lazy_, std::move(stubs)))) {
+    return to_error("cannot add stubs", std::move(error));
+  }
+  return nullptr;
+}
+
+std::unique_ptr<const err::Error> JIT::reachable(const std::string &name) {
+  std::unordered_set<std::string> seen{name};
+  std::vector<const std::string *> work{&name};
+  while (!work.empty()) {
+    auto &fn = *work.back();
+    work.pop_back();
+    auto broken = broken_.find(fn);
+    if (broken != broken_.end()) {
+      return err::jit("cannot generate " + fn, broken->second);
+    }
+    auto callees = callees_.find(fn);
+    if (callees == callees_.end()) {
+      continue;
+    }
+    for (auto &callee : callees->second) {
+      if (seen.insert(callee).second) {
+        work.push_back(&callee);
+      }
+    }
+  }
+  return nullptr;
+}
+
+std::unique_ptr<const err::Error> JIT::lookup(const std::string &name,
+                                              uintptr_t &entry) {
+  if (stubbed_.count(name)) {
+    if (auto error = reachable(name)) {
+      return error;
+    }
+  }
+  auto symbol = stubbed_.count(name)
+                    ? lljit_->lookup(*lazy_, implementation(name))
+                    : lljit_->lookup(name);
+  if (!symbol) {
+    return to_error("cannot compile " + name, symbol.takeError());
+  }
+  entry = symbol->getAddress();
+  return nullptr;
+}
+
+std::unique_ptr<const err::Error> JIT::run(const std::string &name,
+                                           const std::vector<int64_t> &args,
+                                           int64_t &result) {
+  auto arity = arity_.find(name);
+  if (arity == arity_.end()) {
+    return err::jit("undefined fn " + name, "");
+  }
+  if (arity->second != args.size()) {
+    return err::jit("fn " + name + " takes " +
+                        std::to_string(arity->second) + " arguments",
+                    std::to_string(args.size()) + " given");
+  }
+  if (args.size() > native::MAX_ARGS) {
+    return err::jit("fn " + name + " takes too many arguments",
+                    "at most " + std::to_string(native::MAX_ARGS) +
+                        " can be passed");
+  }
+
+  uintptr_t entry = 0;
+  if (auto error = lookup(name, entry)) {
+    return error;
+  }
+  result = native::call(entry, args.data(), args.size());
+  return nullptr;
+}
+
+} // namespace jit
+} // namespace compiler
+} // namespace lang
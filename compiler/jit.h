@@ -0,0 +1,88 @@
+#ifndef LANG_COMPILER_JIT_H
+#define LANG_COMPILER_JIT_H
+
+#include "cache.h"
+#include "codegen.h"
+#include "context.h"
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include <llvm/ExecutionEngine/Orc/IndirectionUtils.h>
+#include <llvm/ExecutionEngine/Orc/JITTargetMachineBuilder.h>
+#include <llvm/ExecutionEngine/Orc/LLJIT.h>
+#include <llvm/ExecutionEngine/Orc/LazyReexports.h>
+
+namespace lang {
+namespace compiler {
+namespace jit {
+
+// JIT compiles modules in-process for the host CPU and calls their fns. Fns
+// of every module added are visible to each other.
+class JIT {
+  std::unique_ptr<llvm::orc::LLJIT> lljit_;
+  // what lljit_ compiles for, to compile fns for the cache.
+  const llvm::orc::JITTargetMachineBuilder machine_;
+  const codegen::OptLevel level_;
+  // parameter count of each fn added, checked by run().
+  std::unordered_map<std::string, size_t> arity_;
+
+  // lazily compiled fns live in lazy_, behind stubs in the main dylib.
+  llvm::orc::JITDylib *lazy_;
+  std::unique_ptr<llvm::orc::LazyCallThroughManager> calls_;
+  std::unique_ptr<llvm::orc::IndirectStubsManager> stubs_;
+  std::vector<std::unique_ptr<Definitions>> definitions_;
+  // names of the fns behind stubs.
+  std::unordered_set<std::string> stubbed_;
+  // why each fn behind a stub that cannot be generated cannot, and the fns
+  // each calls, so a fn that may call one is not run.
+  std::unordered_map<std::string, std::string> broken_;
+  std::unordered_map<std::string, std::vector<std::string>> callees_;
+
+  // An error if fn name, added by add_lazy, can call a fn that cannot be
+  // generated.
+  std::unique_ptr<const err::Error> reachable(const std::string &name);
+
+  JIT(std::unique_ptr<llvm::orc::LLJIT> lljit,
+      llvm::orc::JITTargetMachineBuilder machine, codegen::OptLevel level);
+
+public:
+  ~JIT();
+
+  // Creates a JIT for the host, or returns nullptr and sets error.
+  static std::unique_ptr<JIT> create(std::unique_ptr<const err::Error> &error,
+                                     codegen::OptLevel level);
+
+  // Adds the module of shard, which is compiled on first lookup.
+  std::unique_ptr<const err::Error> add(codegen::Shard shard);
+  // Adds a stub for every fn of ctx. A fn is generated, optimized and
+  // compiled the first time it is called, so a run only pays for the fns it
+  // reaches. ctx must outlive the JIT; errors from generating a fn go to ctx.
+  // Fns are checked as they are added, and one that may call a fn that
+  // cannot be generated is not looked up or run.
+  // With a cache, which must outlive the JIT too, a fn's object code is
+  // looked up by its key first, and stored there once compiled.
+  std::unique_ptr<const err::Error> add_lazy(Context &ctx,
+                                             cache::Cache *cache = nullptr);
+
+  // Compiles fn name if it is not yet and stores its entry point in entry.
+  // For a fn added by add_lazy, that is its compiled code rather than its
+  // stub. Safe to call from any thread once fns are added, as are the
+  // stubs, which compile their fn on the thread that first calls them.
+  std::unique_ptr<const err::Error> lookup(const std::string &name,
+                                           uintptr_t &entry);
+  // Calls fn name with at most native::MAX_ARGS args and stores what it
+  // returns in result. Every value of the language is an int64.
+  std::unique_ptr<const err::Error> run(const std::string &name,
+                                        const std::vector<int64_t> &args,
+                                        int64_t &result);
+};
+
+} // namespace jit
+} // namespace compiler
+} // namespace lang
+
+#endif // LANG_COMPILER_JIT_H
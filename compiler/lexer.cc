@@ -1,4 +1,8 @@
 #include "lexer.h"
+#include "lexer_tables.h"
+#include "scan.h"
+#include <algorithm>
+#include <cstring>
 #include <iomanip>
 #include <sstream>
 
@@ -9,113 +13,132 @@ namespace lex {
 // Static Methods
 //------------------------------------------------------------------------------
 const std::string to_string(const Keyword keyword) {
-  switch (keyword) {
-  case Keyword::kwFN:
-    return "fn";
-  case Keyword::kwIF:
-    return "if";
-  case Keyword::kwELSE:
-    return "else";
-  case Keyword::kwELIF:
-    return "elif";
-  case Keyword::kwVAR:
-    return "var";
-  case Keyword::kwVAL:
-    return "val";
-  default:
-    return "kwINVALID";
+  for (auto &kw : tables::KEYWORDS) {
+    if (kw.value == keyword) {
+      return std::string(kw.text);
+    }
   }
+  return "kwINVALID";
 }
 
 const std::string to_string(const Operator op) {
-  switch (op) {
-  case Operator::opLPAREN:
-    return "(";
-  case Operator::opRPAREN:
-    return ")";
-  case Operator::opLSQUARE:
-    return "[";
-  case Operator::opRSQUARE:
-    return "]";
-  case Operator::opLCURLY:
-    return "{";
-  case Operator::opRCURLY:
-    return "}";
-  case Operator::opCOMMA:
-    return ",";
-  case Operator::opEQUAL:
-    return "=";
-  case Operator::opPLUS:
-    return "+";
-  case Operator::opDASH:
-    return "-";
-  case Operator::opSTAR:
-    return "*";
-  case Operator::opSLASH:
-    return "/";
-  case Operator::opCOMPARE:
-    return "==";
-  case Operator::opINVALID:
-  default:
-    return "opINVALID";
+  for (auto &spelling : tables::OPERATORS) {
+    if (spelling.value == op) {
+      return std::string(spelling.text);
+    }
   }
+  return "opINVALID";
 }
 
 // Reader
 //------------------------------------------------------------------------------
-Reader::Reader(const std::string &name, std::istream &in)
-    : name_(name), in_(in), line_(), lineit_(line_.cbegin()), lineoff_(0),
-      lineno_(0) {}
+Reader::Reader(const std::string &name, const Source &source)
+    : Reader(name, source, Chunk{0, uint32_t(source.size()), 1}) {}
+
+Reader::Reader(const std::string &name, const Source &source,
+               const Chunk &chunk)
+    : name_(name), begin_(source.begin()), end_(source.begin() + chunk.end),
+      line_(begin_ + chunk.begin), cur_(line_), eol_(line_), next_(line_),
+      lineno_(chunk.line - 1) {}
 Reader::~Reader() {}
 
-bool Reader::good() { return lineit_ != line_.cend(); }
+bool Reader::good() { return cur_ != eol_; }
 
 Reader &Reader::operator++() {
-  ++lineoff_;
-  ++lineit_;
+  ++cur_;
   return *this;
 }
 
 bool Reader::require_line() {
-  while (in_.good() && lineit_ == line_.cend()) {
-    std::getline(in_, line_);
-    lineit_ = line_.cbegin();
+  while (next_ != nullptr && cur_ == eol_) {
+    line_ = cur_ = next_;
+    auto nl = static_cast<const char *>(std::memchr(cur_, '\n', end_ - cur_));
+    eol_ = nl != nullptr ? nl : end_;
+    next_ = nl != nullptr ? nl + 1 : nullptr;
     ++lineno_;
-    lineoff_ = 0;
   }
 
-  return lineit_ != line_.cend();
+  return cur_ != eol_;
 }
-unsigned char Reader::read() { return *lineit_; }
+unsigned char Reader::read() { return cur_ != eol_ ? *cur_ : '\0'; }
 
-Location Reader::loc() { return Location(lineno_, lineoff_); }
+Location Reader::loc() { return Location(lineno_, cur_ - line_); }
 
 const std::string &Reader::name() const { return name_; }
 
-// Lexer
+// Splitting
 //------------------------------------------------------------------------------
-Lexer::Lexer(Context &ctx) : reader_(Reader(ctx.name(), ctx.in())) {}
-
-Lexer::~Lexer() {}
+static bool is_identifier_byte(unsigned char c) {
+  return tables::CLASSES[c] == tables::ccIDENTIFIER ||
+         tables::CLASSES[c] == tables::ccDIGIT;
+}
 
-Token::~Token() {
-  switch (type_) {
-  case Type::tIDENTIFIER:
-  case Type::tSTRING:
-    delete u_.string;
-    break;
-  case Type::tCHARACTER:
-  case Type::tEOF:
-  case Type::tFLOAT:
-  case Type::tINTEGER:
-  case Type::tINVALID:
-  case Type::tKEYWORD:
-  case Type::tOPERATOR:
-    break;
+std::vector<Chunk> split(const Source &source, size_t count) {
+  std::vector<Chunk> chunks;
+  const char *begin = source.begin();
+  const char *end = source.end();
+  size_t target = source.size() / std::max<size_t>(count, 1) + 1;
+
+  Chunk chunk{0, 0, 1};
+  const char *line = begin;
+  uint32_t lineno = 1;
+  bool indent = true; // only whitespace so far on this line
+  long depth = 0;
+  for (const char *p = begin; p != end; ++p) {
+    switch (*p) {
+    case '\n':
+      line = p + 1;
+      ++lineno;
+      indent = true;
+      continue;
+    case ' ':
+    case '\t':
+    case '\r':
+      continue;
+    case '{':
+      ++depth;
+      break;
+    case '}':
+      --depth;
+      break;
+    case 'f':
+      if (indent && depth == 0 && end - p >= 2 && p[1] == 'n' &&
+          (end - p == 2 || !is_identifier_byte(p[2]))) {
+        uint32_t at = line - begin;
+        if (at - chunk.begin >= target) {
+          chunk.end = at;
+          chunks.push_back(chunk);
+          chunk = Chunk{at, 0, lineno};
+        }
+      }
+      break;
+    default:
+      break;
+    }
+    indent = false;
   }
+
+  chunk.end = source.size();
+  chunks.push_back(chunk);
+  return chunks;
 }
 
-const std::string Token::string() const {
+// Lexer
+//------------------------------------------------------------------------------
+Lexer::Lexer(Context &ctx)
+    : Lexer(ctx, Chunk{0, uint32_t(ctx.source().size()), 1}) {}
+
+Lexer::Lexer(Context &ctx, const Chunk &chunk)
+    : ctx_(ctx), source_(ctx.source()), interner_(ctx.global().interner()),
+      reader_(Reader(ctx.name(), ctx.source(), chunk)) {
+  // typical sources average a token every 4-8 bytes; reserving the low end
+  // leaves at most one reallocation of the stream.
+  tokens_.reserve((chunk.end - chunk.begin) / 8);
+}
+
+Lexer::~Lexer() {}
+
+const std::string Token::string(const Source &source) const {
   std::stringstream buf;
   buf << '(';
   switch (type_) {
@@ -131,11 +154,11 @@ const std::string Token::string() const {
     break;
   case Type::tIDENTIFIER:
     buf << "id ";
-    buf << *u_.string;
+    buf << text(source);
     break;
   case Type::tSTRING:
     buf << "str";
-    buf << *u_.string;
+    buf << text(source);
     break;
   case Type::tOPERATOR:
     buf << "op ";
@@ -158,186 +181,154 @@ const std::string Token::string() const {
   return buf.str();
 }
 
-std::vector<std::unique_ptr<Token>> Lexer::reset() {
-  std::vector<std::unique_ptr<Token>> tokens;
-  while (reader_.good()) {
-    tokens.emplace_back(lex());
+const std::vector<Token> &Lexer::reset() {
+  while (tokens_.empty() || !tokens_.back().eof()) {
+    lex();
   }
-  return tokens;
+  return tokens_;
 }
 
-std::unique_ptr<Token> Lexer::lex() {
-  if (!reader_.require_line()) {
-    return Token::make_eof();
+const std::vector<Token> &Lexer::tokens() const { return tokens_; }
+
+const Source &Lexer::source() const { return source_; }
+
+size_t Lexer::lex() {
+  if (tokens_.empty() || !tokens_.back().eof()) {
+    tokens_.push_back(next());
   }
+  return tokens_.size() - 1;
+}
 
-  while (reader_.good()) {
+Token Lexer::next() {
+  while (reader_.require_line()) {
     Location loc = reader_.loc();
+    uint32_t offset = reader_.offset();
     unsigned char cc = reader_.read();
 
-    switch (cc) {
-    case ' ':
-    case '\t':
-    case '\r':
-      ++reader_;
-      cc = reader_.read();
-      while (cc == ' ' || cc == '\t' || cc == '\r') {
-        ++reader_;
-        cc = reader_.read();
-      }
+    switch (tables::CLASSES[cc]) {
+    case tables::ccSPACE:
+      reader_.seek(scan::skip_whitespace(reader_.cursor(), reader_.eol()));
       break;
-      // clang-format off
-    case 'A': case 'B': case 'C': case 'D': case 'E': case 'F': case 'G':
-    case 'H': case 'I': case 'J': case 'K': case 'L': case 'M': case 'N':
-    case 'O': case 'P': case 'Q': case 'R': case 'S': case 'T': case 'U':
-    case 'V': case 'W': case 'X': case 'Y': case 'Z': case 'a': case 'b':
-    case 'c': case 'd': case 'e': case 'f': case 'g': case 'h': case 'i':
-    case 'j': case 'k': case 'l': case 'm': case 'n': case 'o': case 'p':
-    case 'q': case 'r': case 's': case 't': case 'u': case 'v': case 'w':
-    case 'x': case 'y': case 'z': case '_':
-      // clang-format on
+    case tables::ccIDENTIFIER:
       return gather_identifier();
-      // clang-format off
-      // clang-format off
-    case '0': case '1': case '2': case '3': case '4': case '5': case '6':
-    case '7': case '8': case '9':
+    case tables::ccDIGIT:
       return gather_numeric();
-      // clang-format off
-    case '+': case '-': case '*': case '/':
-    case '(': case ')':
-    case '{': case '}':
-    case '[': case ']':
-    case ':': case ';':
-    case ',':
-    case '=':
-      // clang-format on
-      return Token::make_op(parse_op(), loc);
-    default:
-      return Token::make_invalid();
+    case tables::ccOPERATOR: {
+      auto op = parse_op();
+      return Token::make_op(op, loc, offset, reader_.offset() - offset);
+    }
+    case tables::ccINVALID:
+      // consume the byte, so lexing on past it always ends.
+      ++reader_;
+      return invalid(loc, offset, 1, "Invalid character");
     }
   }
-  return Token::make_invalid();
+  return Token::make_eof(reader_.offset());
 }
 
+// Runs the operator DFA from the cursor and consumes the longest operator
+// spelling that matches.
 Operator Lexer::parse_op() {
-  unsigned char op = reader_.read();
-  ++reader_; // consume the last char.
-
-  switch (op) {
-  case '(':
-    return Operator::opLPAREN;
-  case ')':
-    return Operator::opRPAREN;
-  case '[':
-    return Operator::opLSQUARE;
-  case ']':
-    return Operator::opRSQUARE;
-  case '{':
-    return Operator::opLCURLY;
-  case '}':
-    return Operator::opRCURLY;
-  case ',':
-    return Operator::opCOMMA;
-  case ':':
-    return Operator::opCOLON;
-  case '+':
-    return Operator::opPLUS;
-  case '-':
-    return Operator::opDASH;
-  case ';':
-    return Operator::opSEMICOLON;
-  case '*':
-    return Operator::opSTAR;
-  case '/':
-    return Operator::opSLASH;
-  case '=': {
-    op = reader_.read();
-    switch (op) {
-    case '=':
-      ++reader_; // consume the last =.
-      return Operator::opCOMPARE;
-    default:
-      return Operator::opEQUAL;
+  auto &dfa = tables::OPERATOR_DFA;
+  const char *begin = reader_.cursor();
+  const char *end = begin + 1; // always consume at least one char.
+  Operator op = Operator::opINVALID;
+
+  uint8_t state = 0;
+  for (const char *p = begin; p != reader_.eol(); ++p) {
+    state = dfa.next[state][static_cast<unsigned char>(*p)];
+    if (state == 0) {
+      break;
+    }
+    if (dfa.accept[state] != Operator::opINVALID) {
+      op = dfa.accept[state];
+      end = p + 1;
     }
   }
-  default:
-    return Operator::opINVALID;
-  }
+
+  reader_.seek(end);
+  return op;
 }
 
-Keyword Lexer::parse_keyword(const std::string &id) {
-  if (id == "fn") {
-    return Keyword::kwFN;
-  } else if (id == "var") {
-    return Keyword::kwVAR;
-  } else if (id == "val") {
-    return Keyword::kwVAL;
-  } else if (id == "if") {
-    return Keyword::kwIF;
-  } else if (id == "else") {
-    return Keyword::kwELSE;
-  } else if (id == "elif") {
-    return Keyword::kwELIF;
-  }
+Keyword Lexer::parse_keyword(std::string_view id) {
+  return tables::keyword(id);
+}
 
-  return Keyword::kwINVALID;
+// Whether a byte may follow an identifier or number without making the token
+// invalid.
+static bool is_delimiter(unsigned char cc) {
+  return (cc >= ' ' && cc < 0x7f) || cc == '\t' || cc == '\r' || cc == '\n';
 }
 
-std::unique_ptr<Token> Lexer::gather_identifier() {
+Token Lexer::gather_identifier() {
   auto loc = reader_.loc();
-  auto buf = std::make_unique<std::string>();
-
-  for (; reader_.good(); ++reader_) {
-    unsigned char cc = reader_.read();
-    if (cc <= 0x7f) {
-      if ((cc < 'A' || cc > 'Z') && (cc < 'a' || cc > 'z') && cc != '_' &&
-          (cc < '0' || cc > '9')) {
-        if ((cc >= ' ' && cc < 0x7f) || cc == '\t' || cc == '\r' ||
-            cc == '\n') {
-          break;
-        }
-
-        return Token::make_invalid();
-      } else {
-        buf->push_back(cc);
-      }
-    } else {
-      // TODO: handle non-ascii
-      return Token::make_invalid();
-    }
+  uint32_t offset = reader_.offset();
+  const char *begin = reader_.cursor();
+  const char *end = scan::skip_identifier(begin, reader_.eol());
+  reader_.seek(end);
+
+  if (reader_.good() && !is_delimiter(reader_.read())) {
+    // TODO: handle non-ascii
+    return Token::make_invalid(loc, offset, end - begin);
   }
 
-  auto keyword = parse_keyword(*buf);
+  uint32_t length = end - begin;
+  std::string_view id(begin, length);
+  auto keyword = parse_keyword(id);
   return keyword == Keyword::kwINVALID
-             ? Token::make_identifier(std::move(buf), loc)
-             : Token::make_keyword(keyword, loc);
+             ? Token::make_identifier(interner_.intern(id), loc, offset, length)
+             : Token::make_keyword(keyword, loc, offset, length);
 }
 
-std::unique_ptr<Token> Lexer::gather_numeric() {
-  std::string buf;
+Token Lexer::gather_numeric() {
   auto loc = reader_.loc();
+  uint32_t offset = reader_.offset();
+  const char *begin = reader_.cursor();
+  const char *end = scan::skip_digits(begin, reader_.eol());
+  reader_.seek(end);
 
-  for (; reader_.good(); ++reader_) {
-    unsigned char cc = reader_.read();
-    if (cc <= 0x7f) {
-      if ((cc < '0' || cc > '9')) {
-        if ((cc >= ' ' && cc < 0x7f) || cc == '\t' || cc == '\r' ||
-            cc == '\n') {
-          break;
-        }
+  if (reader_.good() && !is_delimiter(reader_.read())) {
+    return Token::make_invalid(loc, offset, end - begin);
+  }
 
-        return Token::make_invalid();
-      } else {
-        buf.push_back(cc);
-      }
-    } else {
-      return Token::make_invalid();
+  int64_t value = 0;
+  for (const char *p = begin; p != end; ++p) {
+    int digit = *p - '0';
+    if (value > (INT64_MAX - digit) / 10) {
+      return invalid(loc, offset, end - begin, "Integer literal too large");
     }
+    value = value * 10 + digit;
   }
+  return Token::make_integer(value, loc, offset, end - begin);
+}
+
+Token Lexer::invalid(Location loc, uint32_t offset, uint32_t length,
+                     const std::string &why) {
+  auto token = Token::make_invalid(loc, offset, length);
+  ctx_.report_error(err::unexpected_token(token, source_, why));
+  return token;
+}
+
+// -----------------------------------------------------------------------------
+// Replay
+// -----------------------------------------------------------------------------
+Replay::Replay(ILexer &lexer) : lexer_(lexer), next_(0) {}
 
-  return Token::make_integer(std::stoi(buf), loc);
+size_t Replay::lex() {
+  // like Lexer, keeps returning the eof token once it is reached.
+  auto last = lexer_.tokens().size() - 1;
+  return next_ < last ? next_++ : last;
 }
 
+const std::vector<Token> &Replay::reset() {
+  next_ = lexer_.tokens().size() - 1;
+  return lexer_.tokens();
+}
+
+const std::vector<Token> &Replay::tokens() const { return lexer_.tokens(); }
+
+const Source &Replay::source() const { return lexer_.source(); }
+
 } // namespace lex
 } // namespace compiler
 } // namespace lang
@@ -2,9 +2,9 @@
 #define LANG_COMPILER_LEXER_H
 
 #include "context.h"
+#include "source.h"
 #include "token.h"
 #include <cassert>
-#include <istream>
 #include <memory>
 #include <string>
 #include <variant>
@@ -14,17 +14,36 @@ namespace lang {
 namespace compiler {
 namespace lex {
 
+// Chunk is a run of whole top-level definitions in a Source: the bytes
+// [begin, end), where begin is the start of line `line` (1-based).
+struct Chunk {
+  uint32_t begin;
+  uint32_t end;
+  uint32_t line;
+};
+
+// Splits source into at most `count` chunks of similar size. Chunks are cut
+// only before a `fn` keyword that starts a line outside of any braces, so
+// each one can be lexed and parsed on its own.
+std::vector<Chunk> split(const Source &source, size_t count);
+
+// Reader walks a contiguous Source one line at a time; `good()` is false at
+// the end of each line until `require_line()` steps over the newline.
 class Reader {
   const std::string &name_;
-  std::istream &in_;
+  const char *const begin_;
+  const char *const end_;
 
-  std::string line_;
-  std::string::const_iterator lineit_;
-  size_t lineoff_;
+  const char *line_; // start of the current line
+  const char *cur_;
+  const char *eol_; // end of the current line (newline or end_)
+  const char *next_; // start of the next line, nullptr once exhausted
   size_t lineno_;
 
 public:
-  Reader(const std::string &name, std::istream &in);
+  Reader(const std::string &name, const Source &source);
+  // Reads only chunk; offsets stay relative to the start of source.
+  Reader(const std::string &name, const Source &source, const Chunk &chunk);
   Reader(const Reader &) = delete;
   Reader(Reader &&) = default;
   ~Reader();
@@ -34,42 +53,81 @@ public:
   Location loc();
   unsigned char read();
   Reader &operator++();
+
+  // raw access to the current line for the run scanners.
+  const char *cursor() const { return cur_; }
+  const char *eol() const { return eol_; }
+  uint32_t offset() const { return cur_ - begin_; }
+  void seek(const char *p) {
+    assert(p >= cur_ && p <= eol_);
+    cur_ = p;
+  }
   const std::string &name() const;
 };
 
+// ILexer appends tokens to a flat stream; consumers address them by index.
 class ILexer {
 public:
   ILexer() {}
   virtual ~ILexer(){};
 
-  virtual std::unique_ptr<Token> lex() = 0;
-  virtual std::vector<std::unique_ptr<Token>> reset() = 0;
+  // Lexes the next token and returns its index in `tokens()`.
+  virtual size_t lex() = 0;
+  // Lexes the remainder of the input.
+  virtual const std::vector<Token> &reset() = 0;
+  virtual const std::vector<Token> &tokens() const = 0;
+  virtual const Source &source() const = 0;
 };
 
 class Lexer final : public ILexer {
   bool require_line();
 
-  Keyword parse_keyword(const std::string &id);
+  Keyword parse_keyword(std::string_view id);
   Operator parse_op();
 
-  std::unique_ptr<Token> gather_identifier();
-  std::unique_ptr<Token> gather_numeric();
-
-  std::unique_ptr<Token> check_for_keyword(std::unique_ptr<std::string> id);
+  Token next();
+  Token gather_identifier();
+  Token gather_numeric();
+  // An invalid token, with an error saying why reported to ctx_.
+  Token invalid(Location loc, uint32_t offset, uint32_t length,
+                const std::string &why);
 
+  Context &ctx_;
+  const Source &source_;
+  Interner &interner_;
   Reader reader_;
+  std::vector<Token> tokens_;
 
 public:
   static std::string to_string(const Keyword);
   static std::string to_string(const Operator);
 
   Lexer(Context &);
+  Lexer(Context &, const Chunk &);
   Lexer(const Lexer &) = delete;
   Lexer(Lexer &&) = default;
   ~Lexer();
 
-  std::unique_ptr<Token> lex() override;
-  std::vector<std::unique_ptr<Token>> reset() override;
+  size_t lex() override;
+  const std::vector<Token> &reset() override;
+  const std::vector<Token> &tokens() const override;
+  const Source &source() const override;
+};
+
+// Replay hands out the tokens of a lexer that has already been reset, so
+// lexing can be done, and timed, ahead of parsing.
+class Replay final : public ILexer {
+  ILexer &lexer_;
+  size_t next_;
+
+public:
+  explicit Replay(ILexer &lexer);
+  Replay(const Replay &) = delete;
+
+  size_t lex() override;
+  const std::vector<Token> &reset() override;
+  const std::vector<Token> &tokens() const override;
+  const Source &source() const override;
 };
 
 } // namespace lex
@@ -0,0 +1,160 @@
+#ifndef LANG_COMPILER_LEXER_TABLES_H
+#define LANG_COMPILER_LEXER_TABLES_H
+
+#include "token.h"
+#include <array>
+#include <cstdint>
+#include <string_view>
+
+// Lexer tables generated at compile time from LANG_KEYWORDS and
+// LANG_OPERATORS (token.h): a byte classifier, a DFA over the operator
+// spellings and a perfect hash over the keyword spellings.
+
+namespace lang {
+namespace compiler {
+namespace lex {
+namespace tables {
+
+struct Spelling {
+  std::string_view text;
+  int value;
+};
+
+#define LANG_KEYWORD_SPELLING(kw, spelling) Spelling{spelling, kw},
+constexpr Spelling KEYWORDS[] = {LANG_KEYWORDS(LANG_KEYWORD_SPELLING)};
+#undef LANG_KEYWORD_SPELLING
+
+#define LANG_OPERATOR_SPELLING(op, value, spelling) Spelling{spelling, op},
+constexpr Spelling OPERATORS[] = {LANG_OPERATORS(LANG_OPERATOR_SPELLING)};
+#undef LANG_OPERATOR_SPELLING
+
+// Character classes
+//------------------------------------------------------------------------------
+enum CharClass : uint8_t {
+  ccINVALID = 0,
+  ccSPACE,
+  ccIDENTIFIER,
+  ccDIGIT,
+  ccOPERATOR,
+};
+
+constexpr std::array<CharClass, 256> make_classes() {
+  std::array<CharClass, 256> classes{};
+  classes[' '] = classes['\t'] = classes['\r'] = ccSPACE;
+  for (int c = 'a'; c <= 'z'; ++c) {
+    classes[c] = classes[c - 'a' + 'A'] = ccIDENTIFIER;
+  }
+  classes['_'] = ccIDENTIFIER;
+  for (int c = '0'; c <= '9'; ++c) {
+    classes[c] = ccDIGIT;
+  }
+  for (auto &op : OPERATORS) {
+    classes[static_cast<unsigned char>(op.text[0])] = ccOPERATOR;
+  }
+  return classes;
+}
+
+constexpr std::array<CharClass, 256> CLASSES = make_classes();
+
+// Operator DFA
+//------------------------------------------------------------------------------
+// A trie over the operator spellings. State 0 is the start state and doubles
+// as the dead state: `next[s][c] == 0` means no operator continues with c.
+constexpr size_t operator_states() {
+  size_t states = 1;
+  for (auto &op : OPERATORS) {
+    states += op.text.size();
+  }
+  return states;
+}
+
+struct OperatorDFA {
+  uint8_t next[operator_states()][256];
+  Operator accept[operator_states()];
+};
+
+constexpr OperatorDFA make_operator_dfa() {
+  OperatorDFA dfa{};
+  for (size_t s = 0; s < operator_states(); ++s) {
+    dfa.accept[s] = Operator::opINVALID;
+  }
+
+  size_t states = 1;
+  for (auto &op : OPERATORS) {
+    size_t state = 0;
+    for (char c : op.text) {
+      auto &next = dfa.next[state][static_cast<unsigned char>(c)];
+      if (next == 0) {
+        next = states++;
+      }
+      state = next;
+    }
+    dfa.accept[state] = static_cast<Operator>(op.value);
+  }
+  return dfa;
+}
+
+constexpr OperatorDFA OPERATOR_DFA = make_operator_dfa();
+
+static_assert(operator_states() < 256, "operator DFA states must fit a byte");
+
+// Keyword perfect hash
+//------------------------------------------------------------------------------
+// slot = (first * MULTIPLIER + last + length) % KEYWORD_SLOTS, where the
+// multiplier is searched for at compile time so that no two keywords share a
+// slot. A lookup is one hash and at most one comparison.
+constexpr size_t KEYWORD_SLOTS = 32;
+
+constexpr size_t keyword_slot(uint32_t multiplier, std::string_view id) {
+  return (static_cast<unsigned char>(id.front()) * multiplier +
+          static_cast<unsigned char>(id.back()) + id.size()) %
+         KEYWORD_SLOTS;
+}
+
+constexpr uint32_t find_keyword_multiplier() {
+  for (uint32_t multiplier = 1; multiplier < 1024; ++multiplier) {
+    bool used[KEYWORD_SLOTS] = {};
+    bool perfect = true;
+    for (auto &kw : KEYWORDS) {
+      auto slot = keyword_slot(multiplier, kw.text);
+      perfect = perfect && !used[slot];
+      used[slot] = true;
+    }
+    if (perfect) {
+      return multiplier;
+    }
+  }
+  return 0;
+}
+
+constexpr uint32_t KEYWORD_MULTIPLIER = find_keyword_multiplier();
+
+static_assert(KEYWORD_MULTIPLIER != 0,
+              "no perfect hash for LANG_KEYWORDS; grow KEYWORD_SLOTS");
+
+constexpr std::array<Spelling, KEYWORD_SLOTS> make_keyword_slots() {
+  std::array<Spelling, KEYWORD_SLOTS> slots{};
+  for (auto &slot : slots) {
+    slot.value = Keyword::kwINVALID;
+  }
+  for (auto &kw : KEYWORDS) {
+    slots[keyword_slot(KEYWORD_MULTIPLIER, kw.text)] = kw;
+  }
+  return slots;
+}
+
+constexpr std::array<Spelling, KEYWORD_SLOTS> KEYWORD_TABLE =
+    make_keyword_slots();
+
+inline Keyword keyword(std::string_view id) {
+  auto &slot = KEYWORD_TABLE[keyword_slot(KEYWORD_MULTIPLIER, id)];
+  return slot.text == id ? static_cast<Keyword>(slot.value)
+                         : Keyword::kwINVALID;
+}
+
+} // namespace tables
+} // namespace lex
+} // namespace compiler
+} // namespace lang
+
+#endif // LANG_COMPILER_LEXER_TABLES_H
@@ -0,0 +1,49 @@
+#ifndef LANG_COMPILER_NATIVE_H
+#define LANG_COMPILER_NATIVE_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+
+namespace lang {
+namespace compiler {
+namespace native {
+
+// The most arguments call() can pass.
+const size_t MAX_ARGS = 8;
+
+namespace detail {
+
+typedef int64_t (*Caller)(uintptr_t, const int64_t *);
+
+template <size_t... I>
+int64_t call(uintptr_t entry, const int64_t *args, std::index_sequence<I...>) {
+  typedef int64_t (*Fn)(decltype(I, int64_t())...);
+  return reinterpret_cast<Fn>(entry)(args[I]...);
+}
+
+template <size_t N> int64_t call(uintptr_t entry, const int64_t *args) {
+  return call(entry, args, std::make_index_sequence<N>());
+}
+
+template <size_t... N>
+constexpr std::array<Caller, sizeof...(N)> callers(std::index_sequence<N...>) {
+  return {call<N>...};
+}
+
+} // namespace detail
+
+// Calls the native fn at entry, which takes count int64 arguments and
+// returns an int64; count must not exceed MAX_ARGS.
+inline int64_t call(uintptr_t entry, const int64_t *args, size_t count) {
+  static constexpr auto callers =
+      detail::callers(std::make_index_sequence<MAX_ARGS + 1>());
+  return callers[count](entry, args);
+}
+
+} // namespace native
+} // namespace compiler
+} // namespace lang
+
+#endif // LANG_COMPILER_NATIVE_H
@@ -0,0 +1,449 @@
+#include "object.h"
+#include "parallel.h"
+#include <atomic>
+#include <cstdlib>
+#include <mutex>
+
+#include <llvm/ADT/SmallString.h>
+#include <llvm/CodeGen/ParallelCG.h>
+#include <llvm/IR/IRBuilder.h>
+#include <llvm/IR/LegacyPassManager.h>
+#include <llvm/IR/Verifier.h>
+#include <llvm/MC/SubtargetFeature.h>
+#include <llvm/MC/TargetRegistry.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/Host.h>
+#include <llvm/Support/Program.h>
+#include <llvm/Support/TargetSelect.h>
+#include <llvm/Support/raw_ostream.h>
+
+using namespace llvm;
+
+namespace lang {
+namespace compiler {
+namespace object {
+
+namespace {
+
+// Gives every fn of module a "lang." prefix; see add_entry.
+void prefix(Module &module) {
+  for (auto &fn : module) {
+    if (!fn.isIntrinsic()) {
+      fn.setName("lang." + fn.getName());
+    }
+  }
+}
+
+// Writes data to a new temporary file and adds its path to objects.
+std::unique_ptr<const err::Error> temporary(StringRef data,
+                                            std::vector<std::string> &objects) {
+  int fd = -1;
+  SmallString<128> path;
+  if (auto ec = sys::fs::createTemporaryFile("lang", "o", fd, path)) {
+    return err::object("cannot create object file", ec.message());
+  }
+  objects.push_back(path.str().str());
+  raw_fd_ostream out(fd, true);
+  out << data;
+  out.close();
+  if (out.has_error()) {
+    auto message = out.error().message();
+    out.clear_error();
+    return err::object("cannot write " + objects.back(), message);
+  }
+  return nullptr;
+}
+
+// Links objects into path as write does, then removes them.
+std::unique_ptr<const err::Error>
+finish(std::vector<std::string> &objects, const std::string &path,
+       const std::string *entry, std::unique_ptr<const err::Error> error) {
+  if (error == nullptr && (entry != nullptr || objects.size() > 1)) {
+    error = link(objects, path, entry == nullptr);
+  } else if (error == nullptr) {
+    if (auto ec = sys::fs::copy_file(objects[0], path)) {
+      error = err::object("cannot write " + path, ec.message());
+    }
+  }
+
+  for (auto &object : objects) {
+    sys::fs::remove(object);
+  }
+  return error;
+}
+
+} // namespace
+
+std::unique_ptr<const err::Error> compile(Module &module,
+                                          TargetMachine &machine,
+                                          SmallVectorImpl<char> &buffer) {
+  module.setTargetTriple(machine.getTargetTriple().str());
+  module.setDataLayout(machine.createDataLayout());
+  legacy::PassManager passes;
+  raw_svector_ostream out(buffer);
+  if (machine.addPassesToEmitFile(passes, out, nullptr, CGFT_ObjectFile)) {
+    return err::object("cannot emit object code",
+                       "for " + machine.getTargetTriple().str());
+  }
+  passes.run(module);
+  return nullptr;
+}
+
+std::unique_ptr<TargetMachine> host(std::unique_ptr<const err::Error> &error,
+                                    codegen::OptLevel level) {
+  static std::once_flag once;
+  std::call_once(once, []() {
+    InitializeNativeTarget();
+    InitializeNativeTargetAsmPrinter();
+  });
+
+  auto triple = sys::getProcessTriple();
+  std::string message;
+  auto target = TargetRegistry::lookupTarget(triple, message);
+  if (target == nullptr) {
+    error = err::object("cannot target host", message);
+    return nullptr;
+  }
+
+  SubtargetFeatures features;
+  StringMap<bool> cpu;
+  if (sys::getHostCPUFeatures(cpu)) {
+    for (auto &feature : cpu) {
+      features.AddFeature(feature.first(), feature.second);
+    }
+  }
+  CodeGenOpt::Level levels[] = {CodeGenOpt::None, CodeGenOpt::Less,
+                                CodeGenOpt::Default, CodeGenOpt::Aggressive};
+  // position-independent, as the system compiler links PIE by default.
+  std::unique_ptr<TargetMachine> machine(target->createTargetMachine(
+      triple, sys::getHostCPUName(), features.getString(), TargetOptions(),
+      Reloc::PIC_, None, levels[static_cast<int>(level)]));
+  if (machine == nullptr) {
+    error = err::object("cannot target host", "no target machine for " +
+                                                  triple);
+  }
+  return machine;
+}
+
+std::unique_ptr<const err::Error> emit(Module &module, codegen::OptLevel level,
+                                       size_t jobs,
+                                       std::vector<std::string> &objects) {
+  // each piece is generated on its own thread, by its own TargetMachine,
+  // all created here so that a failure is reported rather than handed to
+  // splitCodeGen.
+  std::vector<std::unique_ptr<TargetMachine>> machines(
+      std::max<size_t>(jobs, 1));
+  for (auto &machine : machines) {
+    std::unique_ptr<const err::Error> error;
+    if (!(machine = host(error, level))) {
+      return error;
+    }
+  }
+  module.setTargetTriple(machines[0]->getTargetTriple().str());
+  module.setDataLayout(machines[0]->createDataLayout());
+
+  std::vector<std::unique_ptr<raw_fd_ostream>> files;
+  std::vector<raw_pwrite_stream *> outs;
+  for (size_t i = 0; i < machines.size(); ++i) {
+    int fd = -1;
+    SmallString<128> path;
+    if (auto ec = sys::fs::createTemporaryFile("lang", "o", fd, path)) {
+      return err::object("cannot create object file", ec.message());
+    }
+    objects.push_back(path.str().str());
+    files.push_back(std::make_unique<raw_fd_ostream>(fd, true));
+    outs.push_back(files.back().get());
+  }
+
+  // the factory is called once per piece, from the thread generating it.
+  std::atomic<size_t> next(0);
+  splitCodeGen(module, outs, {},
+               [&machines, &next]() { return std::move(machines[next++]); });
+
+  for (size_t i = 0; i < files.size(); ++i) {
+    files[i]->close();
+    if (files[i]->has_error()) {
+      auto message = files[i]->error().message();
+      files[i]->clear_error();
+      return err::object("cannot write " + objects[i], message);
+    }
+  }
+  return nullptr;
+}
+
+std::unique_ptr<const err::Error> emit(std::vector<codegen::Shard> &shards,
+                                       codegen::OptLevel level, size_t jobs,
+                                       std::vector<std::string> &objects) {
+  std::vector<SmallVector<char, 0>> code(shards.size());
+  std::vector<std::unique_ptr<const err::Error>> errors(shards.size());
+  // shards are on LLVMContexts of their own, so each worker can compile
+  // them with a TargetMachine of its own.
+  std::vector<std::unique_ptr<TargetMachine>> machines(
+      std::max<size_t>(jobs, 1));
+  parallel_for_workers(jobs, shards.size(), [&](size_t j, size_t i) {
+    if (machines[j] == nullptr && !(machines[j] = host(errors[i], level))) {
+      return;
+    }
+    errors[i] = compile(*shards[i].module, *machines[j], code[i]);
+  });
+
+  for (size_t i = 0; i < shards.size(); ++i) {
+    if (errors[i] != nullptr) {
+      return std::move(errors[i]);
+    }
+    if (auto error = temporary(StringRef(code[i].data(), code[i].size()),
+                               objects)) {
+      return error;
+    }
+  }
+  return nullptr;
+}
+
+std::unique_ptr<const err::Error> add_entry(Module &module,
+                                            const std::string &fn) {
+  auto target = module.getFunction(fn);
+  if (target == nullptr) {
+    return err::object("undefined fn " + fn, "cannot make it the entry");
+  }
+  prefix(module);
+
+  auto &llvm = module.getContext();
+  auto i32 = Type::getInt32Ty(llvm);
+  auto i64 = Type::getInt64Ty(llvm);
+  auto str = Type::getInt8PtrTy(llvm);
+  auto strs = str->getPointerTo();
+  auto strtoll = module.getOrInsertFunction(
+      "strtoll", FunctionType::get(i64, {str, strs, i32}, false));
+  auto printf = module.getOrInsertFunction(
+      "printf", FunctionType::get(i32, {str}, true));
+  auto dprintf = module.getOrInsertFunction(
+      "dprintf", FunctionType::get(i32, {i32, str}, true));
+
+  auto main = Function::Create(FunctionType::get(i32, {i32, strs}, false),
+                               Function::ExternalLinkage, "main", module);
+  auto argc = main->getArg(0), argv = main->getArg(1);
+  auto run = BasicBlock::Create(llvm, "run", main);
+  auto usage = BasicBlock::Create(llvm, "usage", main);
+  IRBuilder<> builder(BasicBlock::Create(llvm, "entry", main, run));
+  auto params = target->arg_size();
+  builder.CreateCondBr(builder.CreateICmpEQ(argc, builder.getInt32(params + 1)),
+                       run, usage);
+
+  builder.SetInsertPoint(usage);
+  std::string help = "usage: %s";
+  for (size_t i = 0; i < params; ++i) {
+    help += " ARG";
+  }
+  builder.CreateCall(dprintf, {builder.getInt32(2),
+                               builder.CreateGlobalStringPtr(help + "\n"),
+                               builder.CreateLoad(str, argv)});
+  builder.CreateRet(builder.getInt32(2));
+
+  builder.SetInsertPoint(run);
+  std::vector<Value *> args;
+  for (size_t i = 0; i < params; ++i) {
+    auto slot = builder.CreateConstGEP1_64(str, argv, i + 1);
+    auto arg = builder.CreateLoad(str, slot);
+    args.push_back(builder.CreateCall(
+        strtoll, {arg, ConstantPointerNull::get(strs), builder.getInt32(10)}));
+  }
+  auto result = builder.CreateCall(target, args);
+  builder.CreateCall(printf, {builder.CreateGlobalStringPtr("%lld\n"), result});
+  builder.CreateRet(builder.getInt32(0));
+
+  std::string message;
+  raw_string_ostream out(message);
+  if (verifyFunction(*main, &out)) {
+    return err::object("cannot make " + fn + " the entry", out.str());
+  }
+  return nullptr;
+}
+
+std::unique_ptr<const err::Error> link(const std::vector<std::string> &objects,
+                                       const std::string &path,
+                                       bool relocatable) {
+  auto cc = std::getenv("CC") ? std::getenv("CC") : "cc";
+  auto program = sys::findProgramByName(cc);
+  if (!program) {
+    return err::object("cannot link " + path,
+                       std::string("no ") + cc + ": " +
+                           program.getError().message());
+  }
+
+  std::vector<StringRef> argv{*program};
+  if (relocatable) {
+    argv.push_back("-r");
+  }
+  argv.insert(argv.end(), objects.begin(), objects.end());
+  argv.push_back("-o");
+  argv.push_back(path);
+
+  std::string message;
+  if (sys::ExecuteAndWait(*program, argv, None, {}, 0, 0, &message) != 0) {
+    return err::object("cannot link " + path,
+                       message.empty() ? *program + " failed" : message);
+  }
+  return nullptr;
+}
+
+std::unique_ptr<const err::Error> write(Module &module,
+                                        codegen::OptLevel level, size_t jobs,
+                                        const std::string &path,
+                                        const std::string *entry) {
+  if (entry != nullptr) {
+    if (auto error = add_entry(module, *entry)) {
+      return error;
+    }
+  }
+
+  std::vector<std::string> objects;
+  auto error = emit(module, level, jobs, objects);
+  return finish(objects, path, entry, std::move(error));
+}
+
+std::unique_ptr<const err::Error> write(std::vector<codegen::Shard> &shards,
+                                        codegen::OptLevel level, size_t jobs,
+                                        const std::string &path,
+                                        const std::string *entry) {
+  if (entry != nullptr) {
+    // the entry goes into the shard that defines its fn, if one does.
+    size_t home = 0;
+    for (size_t i = 0; i < shards.size(); ++i) {
+      auto fn = shards[i].module->getFunction(*entry);
+      if (fn != nullptr && !fn->isDeclaration()) {
+        home = i;
+        break;
+      }
+    }
+    for (size_t i = 0; i < shards.size(); ++i) {
+      if (i != home) {
+        prefix(*shards[i].module);
+      } else if (auto error = add_entry(*shards[i].module, *entry)) {
+        return error;
+      }
+    }
+  }
+
+  std::vector<std::string> objects;
+  auto error = emit(shards, level, jobs, objects);
+  return finish(objects, path, entry, std::move(error));
+}
+
+std::unique_ptr<const err::Error> write(Context &ctx, cache::Cache &cache,
+                                        codegen::OptLevel level, size_t jobs,
+                                        const std::string &path,
+                                        const std::string *entry) {
+  std::unique_ptr<const err::Error> error;
+  auto machine = host(error, level);
+  if (machine == nullptr) {
+    return error;
+  }
+  // the "lang." prefix is part of the code.
+  auto flags = "object " + machine->getTargetTriple().str() + " " +
+               machine->getTargetCPU().str() + " " +
+               machine->getTargetFeatureString().str() + " O" +
+               std::to_string(static_cast<int>(level)) +
+               (entry != nullptr ? " prefixed" : "");
+
+  Definitions defs(ctx);
+  std::vector<std::pair<const ast::Function *, size_t>> fns;
+  size_t position = 0;
+  ctx.each_expr([&](const ast::Expression &expr) {
+    if (expr.kind() == ast::Kind::Function) {
+      auto &fn = static_cast<const ast::Function &>(expr);
+      if (defs.is_first(fn.proto().name(), position)) {
+        fns.emplace_back(&fn, position);
+      }
+    }
+    ++position;
+  });
+
+  std::vector<SmallVector<char, 0>> code(fns.size());
+  std::vector<std::unique_ptr<const err::Error>> errors(fns.size());
+  // guards the errors of ctx and machines.
+  std::mutex mutex;
+  std::vector<std::unique_ptr<TargetMachine>> machines;
+  parallel_for(jobs, fns.size(), [&](size_t i) {
+    auto &fn = *fns[i].first;
+    auto key = cache::key(ctx.interner(), defs, fn, fns[i].second, flags);
+    if (auto object = cache.get(key)) {
+      code[i].assign(object->getBufferStart(), object->getBufferEnd());
+      return;
+    }
+
+    LLVMContext llvm;
+    codegen::Codegen codegen(ctx, llvm, level);
+    auto generated = codegen.generate(fn, defs, fns[i].second) != nullptr;
+    codegen.finish();
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      codegen.flush_errors();
+    }
+    auto &name = ctx.interner().name(fn.proto().name());
+    if (!generated) {
+      errors[i] = err::object("cannot generate fn " + name, "");
+      return;
+    }
+
+    auto module = codegen.release();
+    if (entry != nullptr) {
+      prefix(*module);
+    }
+    // creating a TargetMachine costs more than compiling a small fn.
+    std::unique_ptr<const err::Error> error;
+    std::unique_ptr<TargetMachine> machine;
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      if (!machines.empty()) {
+        machine = std::move(machines.back());
+        machines.pop_back();
+      }
+    }
+    if (machine == nullptr) {
+      machine = host(error, level);
+    }
+    if (machine != nullptr) {
+      error = compile(*module, *machine, code[i]);
+      std::lock_guard<std::mutex> lock(mutex);
+      machines.push_back(std::move(machine));
+    }
+    if (error != nullptr) {
+      errors[i] = std::move(error);
+      return;
+    }
+    cache.put(key, StringRef(code[i].data(), code[i].size()));
+  });
+
+  std::vector<std::string> objects;
+  for (size_t i = 0; i < fns.size() && error == nullptr; ++i) {
+    error = errors[i] ? std::move(errors[i])
+                      : temporary(StringRef(code[i].data(), code[i].size()),
+                                  objects);
+  }
+  if (error == nullptr && entry != nullptr) {
+    // the stub goes in a module of its own, with the entry declared.
+    LLVMContext llvm;
+    Module stub("entry", llvm);
+    for (auto &fn : fns) {
+      if (ctx.interner().name(fn.first->proto().name()) == *entry) {
+        auto i64 = Type::getInt64Ty(llvm);
+        std::vector<Type *> params(fn.first->proto().params().size(), i64);
+        Function::Create(FunctionType::get(i64, params, false),
+                         Function::ExternalLinkage, *entry, stub);
+      }
+    }
+    SmallVector<char, 0> buffer;
+    if (!(error = add_entry(stub, *entry)) &&
+        !(error = compile(stub, *machine, buffer))) {
+      error = temporary(StringRef(buffer.data(), buffer.size()), objects);
+    }
+  }
+  if (error == nullptr && objects.empty()) {
+    error = err::object("cannot write " + path, "no fns");
+  }
+  return finish(objects, path, entry, std::move(error));
+}
+
+} // namespace object
+} // namespace compiler
+} // namespace lang
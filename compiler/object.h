@@ -0,0 +1,81 @@
+#ifndef LANG_COMPILER_OBJECT_H
+#define LANG_COMPILER_OBJECT_H
+
+#include "cache.h"
+#include "codegen.h"
+#include "context.h"
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <llvm/ADT/SmallVector.h>
+#include <llvm/IR/Module.h>
+#include <llvm/Target/TargetMachine.h>
+
+namespace lang {
+namespace compiler {
+namespace object {
+
+// Creates a TargetMachine for the host that emits position-independent code
+// at level, or returns nullptr and sets error.
+std::unique_ptr<llvm::TargetMachine>
+host(std::unique_ptr<const err::Error> &error, codegen::OptLevel level);
+
+// Compiles module to object code for machine into buffer.
+std::unique_ptr<const err::Error> compile(llvm::Module &module,
+                                          llvm::TargetMachine &machine,
+                                          llvm::SmallVectorImpl<char> &buffer);
+
+// Emits module as object code for the host into jobs temporary files, whose
+// paths are stored in objects; the caller removes them. With more than one
+// job, module is split into pieces of about equal size (llvm::SplitModule)
+// whose code is generated concurrently, and the pieces must be linked
+// together. module is left unusable.
+std::unique_ptr<const err::Error> emit(llvm::Module &module,
+                                       codegen::OptLevel level, size_t jobs,
+                                       std::vector<std::string> &objects);
+// Like emit, with an object file for each shard (see
+// codegen::generate_parallel), compiled on up to jobs threads.
+std::unique_ptr<const err::Error> emit(std::vector<codegen::Shard> &shards,
+                                       codegen::OptLevel level, size_t jobs,
+                                       std::vector<std::string> &objects);
+
+// Adds a C `main` to module that calls fn, defined or declared there, with
+// its command-line arguments, parsed as integers, and prints what fn
+// returns. Every fn of module gets a "lang." prefix, so none can clash with
+// the C library.
+std::unique_ptr<const err::Error> add_entry(llvm::Module &module,
+                                            const std::string &fn);
+
+// Links objects with the system C compiler into an executable at path or,
+// if relocatable, into a single object file.
+std::unique_ptr<const err::Error> link(const std::vector<std::string> &objects,
+                                       const std::string &path,
+                                       bool relocatable);
+
+// Writes module to path as an object file or, with an entry fn, as an
+// executable that runs it. Code is generated on up to jobs threads.
+std::unique_ptr<const err::Error> write(llvm::Module &module,
+                                        codegen::OptLevel level, size_t jobs,
+                                        const std::string &path,
+                                        const std::string *entry);
+// Like write, for shards, which are emitted as they are rather than linked
+// into one module first. The shards are left unusable.
+std::unique_ptr<const err::Error> write(std::vector<codegen::Shard> &shards,
+                                        codegen::OptLevel level, size_t jobs,
+                                        const std::string &path,
+                                        const std::string *entry);
+// Like write, for the fns of ctx, each generated and compiled on its own,
+// on up to jobs threads. A fn whose key (see cache::key) is in cache skips
+// both; every other one is stored there. Errors in fns go to ctx. Since fns
+// are optimized one by one, none is inlined into another.
+std::unique_ptr<const err::Error> write(Context &ctx, cache::Cache &cache,
+                                        codegen::OptLevel level, size_t jobs,
+                                        const std::string &path,
+                                        const std::string *entry);
+
+} // namespace object
+} // namespace compiler
+} // namespace lang
+
+#endif // LANG_COMPILER_OBJECT_H
@@ -0,0 +1,46 @@
+#ifndef LANG_COMPILER_PARALLEL_H
+#define LANG_COMPILER_PARALLEL_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+namespace lang {
+namespace compiler {
+
+// Calls fn(worker, i) for every i in [0, count) on up to `jobs` threads,
+// the calling thread included, and returns once all calls are done. worker
+// in [0, jobs) names the thread making the call, so calls can reuse state
+// kept per worker. Indices are handed out in increasing order, so callers
+// that write results to slot i get them back in order regardless of
+// scheduling.
+template <typename Fn>
+void parallel_for_workers(size_t jobs, size_t count, Fn fn) {
+  std::atomic<size_t> next(0);
+  auto work = [&next, count, &fn](size_t worker) {
+    for (size_t i = next++; i < count; i = next++) {
+      fn(worker, i);
+    }
+  };
+
+  std::vector<std::thread> threads;
+  for (size_t j = 1; j < std::min(jobs, count); ++j) {
+    threads.emplace_back(work, j);
+  }
+  work(0);
+  for (auto &thread : threads) {
+    thread.join();
+  }
+}
+
+// Like parallel_for_workers, calling fn(i).
+template <typename Fn> void parallel_for(size_t jobs, size_t count, Fn fn) {
+  parallel_for_workers(jobs, count, [&fn](size_t, size_t i) { fn(i); });
+}
+
+} // namespace compiler
+} // namespace lang
+
+#endif // LANG_COMPILER_PARALLEL_H
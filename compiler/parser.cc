@@ -1,4 +1,5 @@
 #include "cfg.h"
+#include "parallel.h"
 #include "parser.h"
 #include <cassert>
 #include <memory>
@@ -9,39 +10,91 @@ namespace compiler {
 // Location UNKNOWN_LOC = Location();
 
 Parser::Parser(lex::ILexer &lexer, Context &ctx)
-    : _ctx(ctx), _lexer(lexer), _curr_token(nullptr), _next_token(nullptr) {}
+    : _ctx(ctx), _lexer(lexer), _next(0), _counted(ctx.arena().bytes()) {}
 
 Parser::~Parser() {}
 
-void Parser::parse() {
-  _next_token = _lexer.lex();
+bool Parser::parse() {
+  Stats::Timer timer(_ctx.stats(), Stats::PARSE);
+  Trace::Span span(_ctx.trace(), "frontend", "parse");
+  _next = _lexer.lex();
   auto peep = peek();
-  while (!peep->eof()) {
-    if (!peep->is_keyword()) {
-      _ctx.report_error(err::unexpected_token(*peep));
+  while (!peep.eof()) {
+    if (!peep.is_keyword(lex::Keyword::kwFN)) {
+      report_unexpected(peep);
       break;
     }
 
-    switch (peep->keyword()) {
-    case lex::Keyword::kwFN:
-      if (auto fn = parse_fn()) {
-        _ctx.push_node(std::move(fn));
-      }
-    default:
-      // TODO: report error.
-      break;
+    if (auto fn = parse_fn()) {
+      _ctx.push_node(fn);
     }
-
     peep = peek();
   }
+  span.end();
+  timer.stop();
 
+  Stats::Timer cfg(_ctx.stats(), Stats::CFG);
+  Trace::Span blocks(_ctx.trace(), "frontend", "cfg");
   cfg::CFGParser::parse_into(_ctx);
+  return peep.eof();
 }
 
-std::shared_ptr<const ast::Function> Parser::parse_fn() {
+bool Parser::parse(lex::Lexer &lexer, Context &ctx) {
+  auto stats = ctx.stats();
+  if (stats == nullptr && ctx.trace() == nullptr) {
+    return Parser(lexer, ctx).parse();
+  }
+
+  // the parser otherwise lexes on demand, which is too fine-grained to time.
+  Stats::Timer timer(stats, Stats::LEX);
+  Trace::Span span(ctx.trace(), "frontend", "lex");
+  auto &tokens = lexer.reset();
+  span.end();
+  timer.stop();
+  if (stats != nullptr) {
+    stats->add_tokens(tokens.size());
+  }
+  lex::Replay replay(lexer);
+  return Parser(replay, ctx).parse();
+}
+
+void Parser::parse(Context &ctx, size_t jobs) {
+  if (jobs <= 1) {
+    lex::Lexer lexer(ctx);
+    parse(lexer, ctx);
+    return;
+  }
+
+  // a few chunks per job evens out functions of different sizes.
+  auto chunks = lex::split(ctx.source(), jobs * 4);
+  std::vector<std::unique_ptr<Context>> shards(chunks.size());
+  std::vector<char> complete(chunks.size());
+  parallel_for(jobs, chunks.size(), [&](size_t i) {
+    // shards borrow the whole source so token offsets and errors line up.
+    auto &text = ctx.source();
+    auto source = Source::borrow(text.begin(), text.size());
+    shards[i] =
+        std::make_unique<Context>(ctx.global(), ctx.name(), std::move(source));
+    shards[i]->set_stats(ctx.stats());
+    shards[i]->set_trace(ctx.trace());
+    lex::Lexer lexer(*shards[i], chunks[i]);
+    complete[i] = parse(lexer, *shards[i]);
+  });
+
+  // a sequential parse stops at a stray top-level token, so the shards
+  // after the one that met it are dropped.
+  for (size_t i = 0; i < shards.size(); ++i) {
+    ctx.merge(*shards[i]);
+    if (!complete[i]) {
+      break;
+    }
+  }
+}
+
+const ast::Function *Parser::parse_fn() {
   auto token = advance();
-  if (!token->is_keyword(lex::Keyword::kwFN)) {
-    _ctx.report_error(err::unexpected_token(*token, "Expected `fn'"));
+  if (!token.is_keyword(lex::Keyword::kwFN)) {
+    report_unexpected(token, "Expected `fn'");
 
     return nullptr;
   }
@@ -52,68 +105,64 @@ std::shared_ptr<const ast::Function> Parser::parse_fn() {
 
   auto body = parse_fn_body();
 
-  return std::make_shared<const ast::Function>(std::move(prototype),
-                                               std::move(body));
+  return make<ast::Function>(prototype, body);
 }
 
-std::shared_ptr<const ast::Prototype> Parser::parse_prototype() {
+const ast::Prototype *Parser::parse_prototype() {
   auto token = advance();
-  if (!token->is_identifier()) {
-    _ctx.report_error(err::unexpected_token(*token, "Expected fn name"));
+  if (!token.is_identifier()) {
+    report_unexpected(token, "Expected fn name");
     return nullptr;
   }
 
-  const std::string name = token->identifier();
+  auto name = token.symbol();
   auto params = parse_parameters();
 
-  return std::make_shared<const ast::Prototype>(name, std::move(params));
+  return make<ast::Prototype>(name, params);
 }
 
-std::vector<std::shared_ptr<const ast::Parameter>> Parser::parse_parameters() {
-  std::vector<std::shared_ptr<const ast::Parameter>> params;
+Span<const ast::Parameter *> Parser::parse_parameters() {
+  std::vector<const ast::Parameter *> params;
 
   auto token = advance();
-  if (!token->is_operator(lex::Operator::opLPAREN)) {
-    _ctx.report_error(err::unexpected_token(*token, "Expected params '('"));
-    return params;
+  if (!token.is_operator(lex::Operator::opLPAREN)) {
+    report_unexpected(token, "Expected params '('");
+    return _ctx.arena().copy(params);
   }
 
-  for (token = advance(); token->is_identifier(); token = advance()) {
-    auto param =
-        std::make_unique<const ast::Parameter>(false, token->identifier());
-    params.push_back(std::move(param));
+  for (token = advance(); token.is_identifier(); token = advance()) {
+    params.push_back(make<ast::Parameter>(false, token.symbol()));
 
     token = advance();
-    if (!token->is_operator(lex::Operator::opCOMMA)) {
+    if (!token.is_operator(lex::Operator::opCOMMA)) {
       break;
     }
   }
 
-  if (!token->is_operator(lex::Operator::opRPAREN)) {
-    _ctx.report_error(err::unexpected_token(*token, "Expected params ')'"));
-    return params;
+  if (!token.is_operator(lex::Operator::opRPAREN)) {
+    report_unexpected(token, "Expected params ')'");
   }
 
-  return params;
+  return _ctx.arena().copy(params);
 }
 
-std::vector<std::shared_ptr<const ast::Expression>> Parser::parse_fn_body() {
-  std::vector<std::shared_ptr<const ast::Expression>> body;
+ast::Expressions Parser::parse_fn_body() {
+  std::vector<const ast::Expression *> body;
 
   auto token = advance();
-  if (!token->is_operator(lex::Operator::opEQUAL)) {
-    _ctx.report_error(err::unexpected_token(*token, "Expected fn '='"));
-    return body;
+  if (!token.is_operator(lex::Operator::opEQUAL)) {
+    report_unexpected(token, "Expected fn '='");
+    return ast::Expressions();
   }
 
   gather_block(body);
-  return body;
+  return _ctx.arena().copy(body);
 }
 
-std::shared_ptr<const ast::Expression> Parser::parse_stmt() {
-  switch (peek()->type()) {
+const ast::Expression *Parser::parse_stmt() {
+  switch (peek().type()) {
   case lex::Type::tKEYWORD:
-    switch (peek()->keyword()) {
+    switch (peek().keyword()) {
     case lex::Keyword::kwVAL:
       return parse_decl();
     case lex::Keyword::kwIF:
@@ -126,40 +175,39 @@ std::shared_ptr<const ast::Expression> Parser::parse_stmt() {
   }
 }
 
-std::shared_ptr<const ast::Expression> Parser::parse_if() {
+const ast::Expression *Parser::parse_if() {
   auto token = advance();
-  if (!token->is_keyword(lex::Keyword::kwIF) &&
-      !token->is_keyword(lex::Keyword::kwELIF)) {
-    _ctx.report_error(err::unexpected_token(*token, "Expected `if' or `elif'"));
+  if (!token.is_keyword(lex::Keyword::kwIF) &&
+      !token.is_keyword(lex::Keyword::kwELIF)) {
+    report_unexpected(token, "Expected `if' or `elif'");
     return nullptr;
   }
 
   auto cond = parse_expr();
-  std::vector<std::shared_ptr<const ast::Expression>> thn;
-  std::vector<std::shared_ptr<const ast::Expression>> els;
+  std::vector<const ast::Expression *> thn;
+  std::vector<const ast::Expression *> els;
 
   gather_block(thn);
 
-  if (peek()->is_keyword(lex::Keyword::kwELSE)) {
+  if (peek().is_keyword(lex::Keyword::kwELSE)) {
     advance(); // eat 'else'
     gather_block(els);
-  } else if (peek()->is_keyword(lex::Keyword::kwELIF)) {
+  } else if (peek().is_keyword(lex::Keyword::kwELIF)) {
     auto expr = parse_if();
     if (expr != nullptr) {
-      els.push_back(std::move(expr));
+      els.push_back(expr);
     }
   }
 
-  return std::make_unique<ast::If>(std::move(cond), std::move(thn),
-                                   std::move(els));
+  auto &arena = _ctx.arena();
+  return make<ast::If>(cond, arena.copy(thn), arena.copy(els));
 }
 
-void Parser::gather_block(
-    std::vector<std::shared_ptr<const ast::Expression>> &body) {
-  if (!peek()->is_operator(lex::Operator::opLCURLY)) {
+void Parser::gather_block(std::vector<const ast::Expression *> &body) {
+  if (!peek().is_operator(lex::Operator::opLCURLY)) {
     auto expr = parse_stmt();
     if (expr != nullptr) {
-      body.push_back(std::move(expr));
+      body.push_back(expr);
     }
     return;
   } else {
@@ -168,177 +216,172 @@ void Parser::gather_block(
 
   for (auto expr = parse_stmt(); expr != nullptr; expr = parse_stmt()) {
     if (expr != nullptr) {
-      body.push_back(std::move(expr));
+      body.push_back(expr);
     } else {
       break;
     }
 
-    if (peek()->is_operator(lex::Operator::opRCURLY)) {
+    if (peek().is_operator(lex::Operator::opRCURLY)) {
       break;
     }
   }
 
   auto token = advance();
-  if (!token->is_operator(lex::Operator::opRCURLY)) {
-    _ctx.report_error(err::unexpected_token(*token, "Expected fn '}'"));
+  if (!token.is_operator(lex::Operator::opRCURLY)) {
+    report_unexpected(token, "Expected fn '}'");
   }
 }
 
-std::shared_ptr<const ast::Expression> Parser::parse_decl() {
+const ast::Expression *Parser::parse_decl() {
   auto token = advance();
-  if (!token->is_keyword(lex::Keyword::kwVAL)) {
-    _ctx.report_error(err::unexpected_token(*token, "Expected `val'"));
+  if (!token.is_keyword(lex::Keyword::kwVAL)) {
+    report_unexpected(token, "Expected `val'");
     return nullptr;
   }
 
-  std::vector<std::string> names;
-  for (token = advance(); token->is_identifier(); token = advance()) {
-    names.push_back(token->identifier());
+  std::vector<Symbol> names;
+  for (token = advance(); token.is_identifier(); token = advance()) {
+    names.push_back(token.symbol());
 
-    if (!peek()->is_operator(lex::Operator::opCOMMA)) {
+    if (!peek().is_operator(lex::Operator::opCOMMA)) {
       break;
     }
   }
 
   token = advance();
-  if (!token->is_operator(lex::Operator::opEQUAL)) {
-    _ctx.report_error(err::unexpected_token(*token, "Expected `='"));
+  if (!token.is_operator(lex::Operator::opEQUAL)) {
+    report_unexpected(token, "Expected `='");
     return nullptr;
   }
 
-  std::vector<std::shared_ptr<const ast::Expression>> values;
+  std::vector<const ast::Expression *> values;
   for (auto it = names.begin(); it != names.end(); ++it) {
     values.push_back(parse_expr());
 
-    if (!peek()->is_operator(lex::Operator::opCOMMA)) {
+    if (!peek().is_operator(lex::Operator::opCOMMA)) {
       break;
     }
   }
 
   if (names.size() != values.size()) {
-    _ctx.report_error(err::unexpected_token(
-        *token, "num of declarations: " + std::to_string(names.size()) +
-                    "; does not match initialization: " +
-                    std::to_string(values.size())));
+    report_unexpected(token, "num of declarations: " +
+                                 std::to_string(names.size()) +
+                                 "; does not match initialization: " +
+                                 std::to_string(values.size()));
     return nullptr;
   }
 
   if (names.size() == 1) {
-    return std::make_unique<const ast::Value>(true, names[0],
-                                              std::move(values[0]));
+    return make<ast::Value>(true, names[0], values[0]);
   } else {
-    _ctx.report_error(
-        err::unexpected_token(*token, "NOT IMPLEMENTED: tuple assignment"));
+    report_unexpected(token, "NOT IMPLEMENTED: tuple assignment");
     return nullptr;
   }
 }
 
-std::shared_ptr<const ast::Expression> Parser::parse_expr() {
+const ast::Expression *Parser::parse_expr() {
   auto lhs = parse_primary();
   if (!lhs) {
     return nullptr;
   }
 
   auto token = peek();
-  if (!token->is_operator()) {
-    _ctx.report_error(
-        err::unexpected_token(*token, "Expected binary operator"));
+  if (!token.is_operator()) {
+    report_unexpected(token, "Expected binary operator");
     return lhs;
   }
 
-  switch (token->op()) {
+  switch (token.op()) {
   // case lex::Operator::opEQUAL:
   //   return parse_assign(ctx, std::move(lhs));
   default:
-    return parse_binary_expr(Precedence::NORMAL, std::move(lhs));
+    return parse_binary_expr(Precedence::NORMAL, lhs);
   }
 }
 
-std::shared_ptr<const ast::Expression> Parser::parse_primary() {
+const ast::Expression *Parser::parse_primary() {
   auto peep = peek();
-  switch (peep->type()) {
+  switch (peep.type()) {
   case lex::Type::tIDENTIFIER: {
     auto token = advance();
     peep = peek();
-    if (peep->is_operator(lex::Operator::opLPAREN)) {
-      return parse_call(token->identifier());
+    if (peep.is_operator(lex::Operator::opLPAREN)) {
+      return parse_call(token.symbol());
     } else {
-      return std::make_unique<ast::Identifier>(token->identifier());
+      return make<ast::Identifier>(token.symbol());
     }
   }
   case lex::Type::tINTEGER:
     return parse_integer();
   case lex::Type::tOPERATOR:
-    if (peep->is_operator(lex::Operator::opLPAREN)) {
+    if (peep.is_operator(lex::Operator::opLPAREN)) {
       return parse_paren_expr();
     }
   default:
     // TODO: report error
-    // ctx.report_error(err::unexpected_token(*peep, "Expected token type"));
+    // report_unexpected(peep, "Expected token type");
     return nullptr;
   }
 }
 
-std::shared_ptr<const ast::Expression>
-Parser::parse_call(const std::string &name) {
-  std::vector<std::shared_ptr<const ast::Expression>> args;
+const ast::Expression *Parser::parse_call(Symbol name) {
+  std::vector<const ast::Expression *> args;
 
   auto token = advance();
-  if (!token->is_operator(lex::Operator::opLPAREN)) {
-    _ctx.report_error(err::unexpected_token(*token, "Expected call '('"));
+  if (!token.is_operator(lex::Operator::opLPAREN)) {
+    report_unexpected(token, "Expected call '('");
     return nullptr;
   }
 
-  for (auto peep = peek(); !peep->is_operator(); peep = peek()) {
+  for (auto peep = peek(); !peep.is_operator(); peep = peek()) {
     args.push_back(parse_expr());
 
     token = advance();
-    if (!token->is_operator(lex::Operator::opCOMMA)) {
+    if (!token.is_operator(lex::Operator::opCOMMA)) {
       break;
     }
   }
 
-  if (!token->is_operator(lex::Operator::opRPAREN)) {
-    _ctx.report_error(err::unexpected_token(*token, "Expected call ')'"));
+  if (!token.is_operator(lex::Operator::opRPAREN)) {
+    report_unexpected(token, "Expected call ')'");
     return nullptr;
   }
 
-  return std::make_unique<const ast::Call>(name, std::move(args));
+  return make<ast::Call>(name, _ctx.arena().copy(args));
 }
 
-std::shared_ptr<const ast::Expression> Parser::parse_operand() {
+const ast::Expression *Parser::parse_operand() {
   auto token = peek();
-  switch (token->type()) {
+  switch (token.type()) {
   case lex::Type::tIDENTIFIER:
     return parse_identifier();
   case lex::Type::tINTEGER:
     return parse_integer();
   case lex::Type::tOPERATOR:
-    if (token->is_operator(lex::Operator::opLPAREN)) {
+    if (token.is_operator(lex::Operator::opLPAREN)) {
       return parse_paren_expr();
     }
   default:
-    _ctx.report_error(err::unexpected_token(*token, "Expected operand"));
+    report_unexpected(token, "Expected operand");
     return nullptr;
   }
 }
 
-std::shared_ptr<const ast::Identifier> Parser::parse_identifier() {
-  assert(peek()->is_identifier());
+const ast::Identifier *Parser::parse_identifier() {
+  assert(peek().is_identifier());
   auto token = advance();
-  return std::make_unique<ast::Identifier>(token->identifier());
+  return make<ast::Identifier>(token.symbol());
 }
 
-std::shared_ptr<const ast::Integer> Parser::parse_integer() {
-  assert(peek()->is_integer());
+const ast::Integer *Parser::parse_integer() {
+  assert(peek().is_integer());
   auto token = advance();
-  return std::make_unique<ast::Integer>(token->integer());
+  return make<ast::Integer>(token.integer());
 }
 
-std::shared_ptr<const ast::Expression> Parser::parse_paren_expr() {
-  if (!peek()->is_operator(lex::Operator::opLPAREN)) {
-    _ctx.report_error(
-        err::unexpected_token(*peek(), "Expected paren expr '('"));
+const ast::Expression *Parser::parse_paren_expr() {
+  if (!peek().is_operator(lex::Operator::opLPAREN)) {
+    report_unexpected(peek(), "Expected paren expr '('");
     return nullptr;
   }
   advance();
@@ -347,23 +390,21 @@ std::shared_ptr<const ast::Expression> Parser::parse_paren_expr() {
   if (!expr)
     return nullptr;
 
-  if (!peek()->is_operator(lex::Operator::opRPAREN)) {
-    _ctx.report_error(
-        err::unexpected_token(*peek(), "Expected paren expr ')'"));
+  if (!peek().is_operator(lex::Operator::opRPAREN)) {
+    report_unexpected(peek(), "Expected paren expr ')'");
     return nullptr;
   }
   advance();
 
   return expr;
 }
-std::shared_ptr<const ast::Expression>
-Parser::parse_assign(std::shared_ptr<const ast::Expression> lhs) {
+const ast::Expression *Parser::parse_assign(const ast::Expression *lhs) {
   auto token = advance();
-  if (!token->is_operator(lex::Operator::opEQUAL)) {
-    _ctx.report_error(err::unexpected_token(*token, "Expected '='"));
+  if (!token.is_operator(lex::Operator::opEQUAL)) {
+    report_unexpected(token, "Expected '='");
   }
 
-  return std::make_unique<const ast::Assignment>(std::move(lhs), parse_expr());
+  return make<ast::Assignment>(lhs, parse_expr());
 }
 
 Parser::Precedence determine_precedence(const lex::Token &token) {
@@ -380,17 +421,16 @@ Parser::Precedence determine_precedence(const lex::Token &token) {
     return Parser::Precedence::INVALID;
   }
 }
-std::shared_ptr<const ast::Expression>
-Parser::parse_binary_expr(int expr_precedence,
-                          std::shared_ptr<const ast::Expression> lhs) {
+const ast::Expression *
+Parser::parse_binary_expr(int expr_precedence, const ast::Expression *lhs) {
   while (true) {
     auto token = peek();
 
-    int tok_precedence = determine_precedence(*token);
+    int tok_precedence = determine_precedence(token);
     if (tok_precedence < expr_precedence)
       return lhs;
 
-    auto op = advance()->op();
+    auto op = advance().op();
     auto rhs = parse_primary();
     if (!rhs) {
       return nullptr;
@@ -398,32 +438,33 @@ Parser::parse_binary_expr(int expr_precedence,
 
     token = peek();
 
-    int next_precedence = determine_precedence(*token);
+    int next_precedence = determine_precedence(token);
     if (tok_precedence < next_precedence) {
-      rhs = parse_binary_expr(tok_precedence, std::move(rhs));
+      rhs = parse_binary_expr(tok_precedence, rhs);
       if (!rhs) {
         return nullptr;
       }
     }
 
-    lhs = std::make_unique<const ast::BinaryExpression>(op, std::move(lhs),
-                                                        std::move(rhs));
+    lhs = make<ast::BinaryExpression>(op, lhs, rhs);
   }
 
   return lhs;
 }
 
-std::unique_ptr<lex::Token> Parser::advance() {
-  if (_curr_token == _next_token)
-    _next_token = _lexer.lex();
-
-  // auto retval = std::move(_curr_token);
-  _curr_token = std::move(_next_token);
-  _next_token = _lexer.lex();
-  return std::move(_curr_token);
+lex::Token Parser::advance() {
+  auto curr = _next;
+  _next = _lexer.lex();
+  return _lexer.tokens()[curr];
 }
 
-lex::Token *Parser::peek() const { return _next_token.get(); }
+lex::Token Parser::peek() const { return _lexer.tokens()[_next]; }
+
+void Parser::report_unexpected(const lex::Token &token,
+                               const std::string &explanation) {
+  _ctx.report_error(
+      err::unexpected_token(token, _lexer.source(), explanation));
+}
 
 } // namespace compiler
 } // namespace lang
@@ -4,6 +4,8 @@
 #include "context.h"
 #include "expressions.h"
 #include "lexer.h"
+#include "stats.h"
+#include "trace.h"
 
 namespace lang {
 namespace compiler {
@@ -11,34 +13,44 @@ namespace compiler {
 class Parser {
   Context &_ctx;
   lex::ILexer &_lexer;
-  std::unique_ptr<lex::Token> _curr_token, _next_token;
+  size_t _next; // index of the lookahead token in _lexer.tokens()
+  size_t _counted; // arena bytes counted toward nodes in stats
 
-  std::unique_ptr<lex::Token> advance();
-  lex::Token *peek() const;
+  lex::Token advance();
+  lex::Token peek() const;
+  template <typename T, typename... Args> const T *make(Args &&... args) {
+    auto node = _ctx.arena().make<T>(std::forward<Args>(args)...);
+    if (auto stats = _ctx.stats()) {
+      // the node and the child lists copied for it since the last one.
+      auto bytes = _ctx.arena().bytes();
+      stats->add_node(node->kind(), bytes - _counted);
+      _counted = bytes;
+    }
+    return node;
+  }
+  void report_unexpected(const lex::Token &, const std::string & = "");
 
-  std::shared_ptr<const ast::Function> parse_fn();
-  std::shared_ptr<const ast::Prototype> parse_prototype();
-  std::vector<std::shared_ptr<const ast::Parameter>> parse_parameters();
-  std::vector<std::shared_ptr<const ast::Expression>> parse_fn_body();
+  const ast::Function *parse_fn();
+  const ast::Prototype *parse_prototype();
+  Span<const ast::Parameter *> parse_parameters();
+  ast::Expressions parse_fn_body();
 
-  std::shared_ptr<const ast::Expression> parse_stmt();
-  std::shared_ptr<const ast::Expression> parse_decl();
-  std::shared_ptr<const ast::Expression> parse_if();
-  std::shared_ptr<const ast::Expression>
-  parse_assign(std::shared_ptr<const ast::Expression> lhs);
+  const ast::Expression *parse_stmt();
+  const ast::Expression *parse_decl();
+  const ast::Expression *parse_if();
+  const ast::Expression *parse_assign(const ast::Expression *lhs);
 
-  std::shared_ptr<const ast::Expression> parse_expr();
-  std::shared_ptr<const ast::Expression> parse_primary();
-  std::shared_ptr<const ast::Expression> parse_operand();
-  std::shared_ptr<const ast::Expression> parse_call(const std::string &);
-  std::shared_ptr<const ast::Expression> parse_paren_expr();
-  std::shared_ptr<const ast::Expression>
-  parse_binary_expr(int, std::shared_ptr<const ast::Expression>);
+  const ast::Expression *parse_expr();
+  const ast::Expression *parse_primary();
+  const ast::Expression *parse_operand();
+  const ast::Expression *parse_call(Symbol);
+  const ast::Expression *parse_paren_expr();
+  const ast::Expression *parse_binary_expr(int, const ast::Expression *);
 
-  std::shared_ptr<const ast::Identifier> parse_identifier();
-  std::shared_ptr<const ast::Integer> parse_integer();
+  const ast::Identifier *parse_identifier();
+  const ast::Integer *parse_integer();
 
-  void gather_block(std::vector<std::shared_ptr<const ast::Expression>> &);
+  void gather_block(std::vector<const ast::Expression *> &);
 
 public:
   enum Precedence {
@@ -53,7 +65,17 @@ public:
   Parser(Parser &&) = delete;
   ~Parser();
 
-  void parse();
+  // Parses fns up to the end of the input, or up to a top-level token that
+  // does not start one, which is reported; returns whether it reached the end.
+  bool parse();
+
+  // Parses the whole of lexer into ctx, timing lexing apart from parsing
+  // when ctx records stats or a trace. Returns what parse() does.
+  static bool parse(lex::Lexer &lexer, Context &ctx);
+  // Parses all of ctx.source() into ctx. With more than one job the source is
+  // split at top-level fn definitions (see lex::split) and the pieces are
+  // parsed concurrently, then merged back in source order.
+  static void parse(Context &ctx, size_t jobs);
 };
 
 } // namespace compiler
@@ -0,0 +1,172 @@
+#include "scan.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace lang {
+namespace compiler {
+namespace lex {
+namespace scan {
+
+namespace scalar {
+
+static inline bool is_whitespace(unsigned char cc) {
+  return cc == ' ' || cc == '\t' || cc == '\r';
+}
+
+static inline bool is_digit(unsigned char cc) {
+  return cc >= '0' && cc <= '9';
+}
+
+static inline bool is_identifier(unsigned char cc) {
+  return (cc >= 'A' && cc <= 'Z') || (cc >= 'a' && cc <= 'z') || cc == '_' ||
+         is_digit(cc);
+}
+
+const char *skip_whitespace(const char *p, const char *end) {
+  while (p != end && is_whitespace(*p)) {
+    ++p;
+  }
+  return p;
+}
+
+const char *skip_identifier(const char *p, const char *end) {
+  while (p != end && is_identifier(*p)) {
+    ++p;
+  }
+  return p;
+}
+
+const char *skip_digits(const char *p, const char *end) {
+  while (p != end && is_digit(*p)) {
+    ++p;
+  }
+  return p;
+}
+
+} // namespace scalar
+
+#if defined(__AVX2__) || defined(__SSE2__)
+
+#if defined(__AVX2__)
+typedef __m256i vec;
+static const int WIDTH = 32;
+static inline vec load(const char *p) {
+  return _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+}
+static inline vec splat(char c) { return _mm256_set1_epi8(c); }
+static inline vec eq(vec a, vec b) { return _mm256_cmpeq_epi8(a, b); }
+static inline vec lt(vec a, vec b) { return _mm256_cmpgt_epi8(b, a); }
+static inline vec add(vec a, vec b) { return _mm256_add_epi8(a, b); }
+static inline vec any(vec a, vec b) { return _mm256_or_si256(a, b); }
+static inline unsigned mask(vec a) { return _mm256_movemask_epi8(a); }
+static const unsigned FULL = 0xffffffffu;
+#else
+typedef __m128i vec;
+static const int WIDTH = 16;
+static inline vec load(const char *p) {
+  return _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+}
+static inline vec splat(char c) { return _mm_set1_epi8(c); }
+static inline vec eq(vec a, vec b) { return _mm_cmpeq_epi8(a, b); }
+static inline vec lt(vec a, vec b) { return _mm_cmplt_epi8(a, b); }
+static inline vec add(vec a, vec b) { return _mm_add_epi8(a, b); }
+static inline vec any(vec a, vec b) { return _mm_or_si128(a, b); }
+static inline unsigned mask(vec a) { return _mm_movemask_epi8(a); }
+static const unsigned FULL = 0xffffu;
+#endif
+
+// Lanes of v in [lo, hi]. Shifting lo down to -128 turns the unsigned range
+// check into a single signed compare; bytes >= 0x80 always land outside.
+static inline vec in_range(vec v, char lo, char hi) {
+  vec shifted = add(v, splat(static_cast<char>(-128 - lo)));
+  return lt(shifted, splat(static_cast<char>(-128 + (hi - lo + 1))));
+}
+
+// Advances p while every lane of classify(block) is set, then hands the
+// remaining tail to the scalar scanner. Most runs in real sources are a few
+// bytes long, so the first PREFIX bytes are checked one at a time before
+// paying for a vector load.
+static const int PREFIX = 8;
+
+template <typename Classify, typename Is, typename Scalar>
+static inline const char *skip(const char *p, const char *end,
+                               Classify classify, Is is, Scalar scalar) {
+  if (end - p < WIDTH + PREFIX) {
+    return scalar(p, end);
+  }
+  for (int i = 0; i < PREFIX; ++i, ++p) {
+    if (!is(*p)) {
+      return p;
+    }
+  }
+  for (; end - p >= WIDTH; p += WIDTH) {
+    unsigned m = mask(classify(load(p)));
+    if (m != FULL) {
+      return p + __builtin_ctz(~m);
+    }
+  }
+  return scalar(p, end);
+}
+
+const char *skip_whitespace(const char *p, const char *end) {
+  return skip(
+      p, end,
+      [](vec v) {
+        return any(any(eq(v, splat(' ')), eq(v, splat('\t'))),
+                   eq(v, splat('\r')));
+      },
+      scalar::is_whitespace, scalar::skip_whitespace);
+}
+
+const char *skip_identifier(const char *p, const char *end) {
+  return skip(
+      p, end,
+      [](vec v) {
+        // setting bit 5 folds 'A'-'Z' onto 'a'-'z' without letting any other
+        // identifier byte alias a letter.
+        return any(in_range(any(v, splat(0x20)), 'a', 'z'),
+                   any(in_range(v, '0', '9'), eq(v, splat('_'))));
+      },
+      scalar::is_identifier, scalar::skip_identifier);
+}
+
+const char *skip_digits(const char *p, const char *end) {
+  return skip(
+      p, end, [](vec v) { return in_range(v, '0', '9'); }, scalar::is_digit,
+      scalar::skip_digits);
+}
+
+#else
+
+const char *skip_whitespace(const char *p, const char *end) {
+  return scalar::skip_whitespace(p, end);
+}
+
+const char *skip_identifier(const char *p, const char *end) {
+  return scalar::skip_identifier(p, end);
+}
+
+const char *skip_digits(const char *p, const char *end) {
+  return scalar::skip_digits(p, end);
+}
+
+#endif
+
+const char *isa() {
+#if defined(__AVX2__)
+  return "avx2";
+#elif defined(__SSE2__)
+  return "sse2";
+#else
+  return "scalar";
+#endif
+}
+
+} // namespace scan
+} // namespace lex
+} // namespace compiler
+} // namespace lang
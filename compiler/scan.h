@@ -0,0 +1,34 @@
+#ifndef LANG_COMPILER_SCAN_H
+#define LANG_COMPILER_SCAN_H
+
+namespace lang {
+namespace compiler {
+namespace lex {
+namespace scan {
+
+// Each scanner returns a pointer to the first byte in [p, end) that does not
+// belong to the run, or end. The vector variants process 32 (AVX2) or 16
+// (SSE2) bytes per step and finish the tail with the scalar loop.
+
+// Skips ' ', '\t' and '\r'.
+const char *skip_whitespace(const char *p, const char *end);
+// Skips [A-Za-z0-9_].
+const char *skip_identifier(const char *p, const char *end);
+// Skips [0-9].
+const char *skip_digits(const char *p, const char *end);
+
+// Name of the instruction set the dispatching scanners were built for.
+const char *isa();
+
+namespace scalar {
+const char *skip_whitespace(const char *p, const char *end);
+const char *skip_identifier(const char *p, const char *end);
+const char *skip_digits(const char *p, const char *end);
+} // namespace scalar
+
+} // namespace scan
+} // namespace lex
+} // namespace compiler
+} // namespace lang
+
+#endif // LANG_COMPILER_SCAN_H
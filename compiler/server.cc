@@ -0,0 +1,364 @@
+#include "server.h"
+#include "object.h"
+#include "parser.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <llvm/ADT/SmallVector.h>
+#include <llvm/Support/raw_ostream.h>
+
+namespace lang {
+namespace compiler {
+namespace server {
+
+namespace {
+
+// Headers are short; a longer line is not a request.
+const size_t LINE = 256;
+// Nor is a larger name, source or reply.
+const size_t LIMIT = size_t(1) << 30;
+
+bool write_all(int fd, const char *data, size_t size) {
+  while (size > 0) {
+    // a client that went away must not kill the server with SIGPIPE.
+    auto sent = ::send(fd, data, size, MSG_NOSIGNAL);
+    if (sent < 0 && errno == EINTR) {
+      continue;
+    }
+    if (sent <= 0) {
+      return false;
+    }
+    data += sent;
+    size -= sent;
+  }
+  return true;
+}
+
+bool read_all(int fd, char *data, size_t size) {
+  while (size > 0) {
+    auto received = ::read(fd, data, size);
+    if (received < 0 && errno == EINTR) {
+      continue;
+    }
+    if (received <= 0) {
+      return false;
+    }
+    data += received;
+    size -= received;
+  }
+  return true;
+}
+
+// Reads up to a newline, which is dropped. Byte by byte, so nothing after
+// it is consumed.
+bool read_line(int fd, std::string &line) {
+  line.clear();
+  char c;
+  while (line.size() < LINE && read_all(fd, &c, 1)) {
+    if (c == '\n') {
+      return true;
+    }
+    line.push_back(c);
+  }
+  return false;
+}
+
+// Reads size bytes into data, unless size is over LIMIT.
+bool read_string(int fd, size_t size, std::string &data) {
+  if (size > LIMIT) {
+    return false;
+  }
+  data.resize(size);
+  return size == 0 || read_all(fd, &data[0], size);
+}
+
+const char *const EMITS[] = {"ir", "object", "check"};
+
+std::unique_ptr<const err::Error> bad_request(const std::string &why) {
+  return err::server("bad request", why);
+}
+
+// The socket times out reads, which then fail with EAGAIN. errno is cleared
+// first, as a read of nothing at the end of the stream does not set it.
+std::unique_ptr<const err::Error> read(int fd, Request &request) {
+  std::string line, emit, source;
+  int level = -1;
+  size_t names = 0, texts = 0, jobs = 0;
+  errno = 0;
+  auto timed_out = []() { return errno == EAGAIN || errno == EWOULDBLOCK; };
+  if (!read_line(fd, line)) {
+    return bad_request(timed_out() ? "timed out" : "no header");
+  }
+  std::istringstream header(line);
+  if (!(header >> emit >> level >> source >> names >> texts >> jobs)) {
+    return bad_request("malformed header: " + line);
+  }
+
+  size_t i = 0;
+  while (i < 3 && emit != EMITS[i]) {
+    ++i;
+  }
+  if (i == 3 || level < 0 || level > 3 ||
+      (source != "path" && source != "text")) {
+    return bad_request("malformed header: " + line);
+  }
+  request.emit = static_cast<Emit>(i);
+  request.level = static_cast<codegen::OptLevel>(level);
+  request.path = source == "path";
+  request.jobs = jobs;
+  if (!read_string(fd, names, request.name) ||
+      !read_string(fd, texts, request.text)) {
+    return bad_request(timed_out() ? "timed out" : "truncated");
+  }
+  return nullptr;
+}
+
+bool write(int fd, const Reply &reply) {
+  auto header = std::string(reply.ok ? "ok " : "error ") +
+                std::to_string(reply.data.size()) + "\n";
+  return write_all(fd, header.data(), header.size()) &&
+         write_all(fd, reply.data.data(), reply.data.size());
+}
+
+} // namespace
+
+std::string default_path() {
+  if (auto runtime = std::getenv("XDG_RUNTIME_DIR")) {
+    return std::string(runtime) + "/lang.sock";
+  }
+  return "/tmp/lang-" + std::to_string(::getuid()) + ".sock";
+}
+
+// -----------------------------------------------------------------------------
+// Server
+// -----------------------------------------------------------------------------
+Server::Server(const std::string &path, int socket,
+               std::chrono::milliseconds timeout)
+    : path_(path), socket_(socket), timeout_(timeout), stop_(false) {}
+
+Server::~Server() {
+  stop();
+  for (auto &worker : workers_) {
+    worker.join();
+  }
+  for (auto fd : queue_) {
+    ::close(fd);
+  }
+  ::close(socket_);
+  ::unlink(path_.c_str());
+}
+
+std::unique_ptr<Server>
+Server::listen(std::unique_ptr<const err::Error> &error,
+               const std::string &path, size_t jobs,
+               std::chrono::milliseconds timeout) {
+  sockaddr_un address{};
+  address.sun_family = AF_UNIX;
+  if (path.size() >= sizeof(address.sun_path)) {
+    error = err::server("cannot listen on " + path, "path too long");
+    return nullptr;
+  }
+  std::strcpy(address.sun_path, path.c_str());
+
+  int fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (fd < 0) {
+    error = err::server("cannot listen on " + path, std::strerror(errno));
+    return nullptr;
+  }
+  // a server that did not exit cleanly leaves its socket behind.
+  ::unlink(path.c_str());
+  if (::bind(fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) ||
+      ::listen(fd, SOMAXCONN)) {
+    error = err::server("cannot listen on " + path, std::strerror(errno));
+    ::close(fd);
+    return nullptr;
+  }
+
+  std::unique_ptr<Server> server(new Server(path, fd, timeout));
+  for (size_t i = 0; i < std::max<size_t>(jobs, 1); ++i) {
+    server->workers_.emplace_back(&Server::work, server.get());
+  }
+  return server;
+}
+
+void Server::serve() {
+  for (;;) {
+    int fd = ::accept4(socket_, nullptr, nullptr, SOCK_CLOEXEC);
+    if (fd < 0) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (stop_) {
+        return;
+      }
+      continue;
+    }
+    timeval timeout{};
+    timeout.tv_sec = timeout_.count() / 1000;
+    timeout.tv_usec = timeout_.count() % 1000 * 1000;
+    if (::setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout))) {
+      ::close(fd);
+      continue;
+    }
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      queue_.push_back(fd);
+    }
+    changed_.notify_one();
+  }
+}
+
+void Server::stop() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  // wakes up accept.
+  ::shutdown(socket_, SHUT_RDWR);
+  changed_.notify_all();
+}
+
+void Server::work() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  for (;;) {
+    changed_.wait(lock, [this]() { return stop_ || !queue_.empty(); });
+    if (stop_) {
+      return;
+    }
+    auto fd = queue_.front();
+    queue_.pop_front();
+    lock.unlock();
+    handle(fd);
+    ::close(fd);
+    lock.lock();
+  }
+}
+
+void Server::handle(int fd) {
+  Request request;
+  if (auto error = read(fd, request)) {
+    std::ostringstream out;
+    out << *error;
+    write(fd, Reply{false, out.str()});
+    return;
+  }
+  write(fd, compile(request));
+}
+
+Reply Server::compile(const Request &request) {
+  std::ostringstream errors;
+  std::unique_ptr<const Source> source;
+  if (!request.path) {
+    source = Source::borrow(request.text.data(), request.text.size());
+  } else if (!(source = Source::load(request.name, errors))) {
+    return Reply{false, errors.str()};
+  }
+
+  // names live as long as the request, however long the server runs.
+  GlobalContext global;
+  Context ctx(global, request.name, std::move(source));
+  auto failed = [&ctx, &errors]() {
+    ctx.each_error(
+        [&errors](const err::Error &error) { errors << error << "\n"; });
+    return !errors.str().empty();
+  };
+  Parser::parse(ctx, std::min(request.jobs, workers_.size()));
+  if (failed()) {
+    return Reply{false, errors.str()};
+  } else if (request.emit == Emit::Check) {
+    return Reply{true, ""};
+  }
+
+  llvm::LLVMContext llvm;
+  codegen::Codegen codegen(ctx, llvm, request.level);
+  codegen.generate();
+  if (failed()) {
+    return Reply{false, errors.str()};
+  }
+  auto module = codegen.release();
+
+  Reply reply{true, ""};
+  if (request.emit == Emit::IR) {
+    llvm::raw_string_ostream out(reply.data);
+    module->print(out, nullptr);
+  } else if (request.emit == Emit::Object) {
+    auto &idle = machines_[static_cast<int>(request.level)];
+    std::unique_ptr<llvm::TargetMachine> machine;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (!idle.empty()) {
+        machine = std::move(idle.back());
+        idle.pop_back();
+      }
+    }
+    std::unique_ptr<const err::Error> error;
+    if (machine == nullptr) {
+      machine = object::host(error, request.level);
+    }
+    llvm::SmallVector<char, 0> code;
+    if (machine != nullptr) {
+      error = object::compile(*module, *machine, code);
+      std::lock_guard<std::mutex> lock(mutex_);
+      idle.push_back(std::move(machine));
+    }
+    if (error != nullptr) {
+      errors << *error << "\n";
+      return Reply{false, errors.str()};
+    }
+    reply.data.assign(code.data(), code.size());
+  }
+  return reply;
+}
+
+std::unique_ptr<const err::Error> send(const std::string &path,
+                                       const Request &request, Reply &reply) {
+  sockaddr_un address{};
+  address.sun_family = AF_UNIX;
+  if (path.size() >= sizeof(address.sun_path)) {
+    return err::server("cannot connect to " + path, "path too long");
+  }
+  std::strcpy(address.sun_path, path.c_str());
+
+  int fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (fd < 0 ||
+      ::connect(fd, reinterpret_cast<sockaddr *>(&address), sizeof(address))) {
+    auto error = err::server("cannot connect to " + path, std::strerror(errno));
+    if (fd >= 0) {
+      ::close(fd);
+    }
+    return error;
+  }
+
+  auto header = std::string(EMITS[static_cast<int>(request.emit)]) + " " +
+                std::to_string(static_cast<int>(request.level)) +
+                (request.path ? " path " : " text ") +
+                std::to_string(request.name.size()) + " " +
+                std::to_string(request.text.size()) + " " +
+                std::to_string(request.jobs) + "\n";
+  std::string line, status;
+  size_t size = 0;
+  std::unique_ptr<const err::Error> error;
+  if (!write_all(fd, header.data(), header.size()) ||
+      !write_all(fd, request.name.data(), request.name.size()) ||
+      !write_all(fd, request.text.data(), request.text.size())) {
+    error = err::server("cannot send to " + path, std::strerror(errno));
+  } else if (!read_line(fd, line) ||
+             !(std::istringstream(line) >> status >> size) ||
+             !read_string(fd, size, reply.data)) {
+    error = err::server("no reply from " + path, line);
+  } else {
+    reply.ok = status == "ok";
+  }
+  ::close(fd);
+  return error;
+}
+
+} // namespace server
+} // namespace compiler
+} // namespace lang
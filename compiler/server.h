@@ -0,0 +1,103 @@
+#ifndef LANG_COMPILER_SERVER_H
+#define LANG_COMPILER_SERVER_H
+
+#include "codegen.h"
+#include "context.h"
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <llvm/Target/TargetMachine.h>
+
+namespace lang {
+namespace compiler {
+namespace server {
+
+// What a request asks the server for.
+enum class Emit { IR, Object, Check };
+
+// Request is one source to compile. On the wire it is a line
+//
+//   <ir|object|check> <level> <path|text> <name size> <text size> <jobs>
+//
+// followed by the name and the text. A path request has no text: the
+// server reads the source from the file name.
+struct Request {
+  Emit emit;
+  codegen::OptLevel level;
+  bool path;
+  std::string name;
+  std::string text;
+  // pieces the source is parsed in at once, at most the server's workers.
+  size_t jobs = 1;
+};
+
+// Reply is what the server sends back: a line `<ok|error> <size>` followed
+// by data, which is the IR or object code asked for, or the errors found.
+struct Reply {
+  bool ok;
+  std::string data;
+};
+
+// The socket a user's server listens on unless told otherwise: lang.sock in
+// $XDG_RUNTIME_DIR, or a per-user file in /tmp.
+std::string default_path();
+
+// Server compiles requests sent over a Unix socket on a pool of threads.
+// Unlike a process per compile, it pays for LLVM initialization and
+// TargetMachines once. Each request interns its names on its own, so
+// memory does not grow with the requests served.
+class Server {
+  const std::string path_;
+  const int socket_;
+  // how long a client may leave the server waiting for its request.
+  const std::chrono::milliseconds timeout_;
+
+  std::mutex mutex_;
+  std::condition_variable changed_;
+  // accepted connections waiting for a worker.
+  std::deque<int> queue_;
+  bool stop_;
+  std::vector<std::thread> workers_;
+  // idle TargetMachines, by level.
+  std::vector<std::unique_ptr<llvm::TargetMachine>> machines_[4];
+
+  Server(const std::string &path, int socket,
+         std::chrono::milliseconds timeout);
+  void work();
+  void handle(int fd);
+  Reply compile(const Request &request);
+
+public:
+  ~Server();
+
+  // Listens on the socket path, replacing any file there, with jobs
+  // workers, or returns nullptr and sets error. A client that sends nothing
+  // for timeout while the server reads its request gets a bad request
+  // reply, so it cannot hold on to a worker.
+  static std::unique_ptr<Server>
+  listen(std::unique_ptr<const err::Error> &error, const std::string &path,
+         size_t jobs,
+         std::chrono::milliseconds timeout = std::chrono::seconds(10));
+
+  // Accepts connections, one request each, until stop is called.
+  void serve();
+  // Makes serve return; requests already accepted are dropped. Safe to call
+  // from any thread.
+  void stop();
+};
+
+// Sends request to the server listening on path and stores its reply.
+std::unique_ptr<const err::Error> send(const std::string &path,
+                                       const Request &request, Reply &reply);
+
+} // namespace server
+} // namespace compiler
+} // namespace lang
+
+#endif // LANG_COMPILER_SERVER_H
@@ -0,0 +1,261 @@
+#include "session.h"
+#include "lexer.h"
+#include "parallel.h"
+#include "parser.h"
+#include <string_view>
+#include <unordered_map>
+
+#include <llvm/Bitcode/BitcodeReader.h>
+#include <llvm/Bitcode/BitcodeWriter.h>
+#include <llvm/Linker/Linker.h>
+#include <llvm/Support/raw_ostream.h>
+
+using namespace llvm;
+
+namespace lang {
+namespace compiler {
+
+// -----------------------------------------------------------------------------
+// Session
+// -----------------------------------------------------------------------------
+Session::Session(const std::string &name, codegen::OptLevel level,
+                 size_t jobs)
+    : name_(name), level_(level), jobs_(jobs),
+      ctx_(std::make_unique<Context>(global_, name, Source::borrow("", 0))),
+      module_(std::make_unique<Module>(name, llvm_)) {}
+
+Session::~Session() {}
+
+Session::Stats Session::update(std::unique_ptr<const Source> source) {
+  Stats stats{0, 0, 0};
+
+  // pieces of the previous version, by text.
+  std::unordered_map<std::string_view, std::vector<std::unique_ptr<Piece>>>
+      previous;
+  for (auto &piece : pieces_) {
+    auto &text = piece->text;
+    previous[text].push_back(std::move(piece));
+  }
+
+  std::vector<std::unique_ptr<Piece>> pieces;
+  std::vector<Piece *> unparsed;
+  for (auto &chunk : lex::split(*source, source->size())) {
+    std::string_view text(source->begin() + chunk.begin,
+                          chunk.end - chunk.begin);
+    auto it = previous.find(text);
+    // tokens keep the line they were lexed on, which only matters to errors:
+    // a piece that moved is parsed again unless it parsed and generated
+    // without any.
+    if (it != previous.end() && !it->second.empty() &&
+        ((it->second.back()->errors == 0 && it->second.back()->generated) ||
+         it->second.back()->line == chunk.line)) {
+      pieces.push_back(std::move(it->second.back()));
+      it->second.pop_back();
+      continue;
+    }
+
+    auto piece = std::make_unique<Piece>();
+    piece->text = std::string(text);
+    piece->line = chunk.line;
+    piece->errors = 0;
+    piece->generated = false;
+    unparsed.push_back(piece.get());
+    pieces.push_back(std::move(piece));
+  }
+
+  parallel_for(jobs_, unparsed.size(), [this, &unparsed](size_t i) {
+    auto &piece = *unparsed[i];
+    auto &text = piece.text;
+    piece.ctx = std::make_unique<Context>(
+        global_, name_, Source::borrow(text.data(), text.size()));
+    lex::Lexer lexer(*piece.ctx,
+                     lex::Chunk{0, uint32_t(text.size()), piece.line});
+    Parser(lexer, *piece.ctx).parse();
+    piece.ctx->each_error([&piece](const err::Error &) { ++piece.errors; });
+  });
+
+  // the fns of pieces that are gone leave the module.
+  for (auto &texts : previous) {
+    for (auto &piece : texts.second) {
+      remove(*piece);
+    }
+  }
+
+  ctx_ = std::make_unique<Context>(global_, name_, std::move(source));
+  pieces_ = std::move(pieces);
+  for (auto &piece : pieces_) {
+    piece->ctx->each_expr(
+        [this](const ast::Expression &expr) { ctx_->push_node(&expr); });
+    piece->ctx->each_error([this](const err::Error &error) {
+      ctx_->report_error(std::make_unique<err::Error>(error));
+    });
+  }
+
+  Definitions defs(*ctx_);
+  std::vector<std::pair<Piece *, size_t>> stale_pieces;
+  size_t position = 0;
+  for (auto &piece : pieces_) {
+    if (stale(*piece, defs, position)) {
+      remove(*piece);
+      stale_pieces.emplace_back(piece.get(), position);
+    }
+    piece->ctx->each_expr(
+        [&position](const ast::Expression &) { ++position; });
+  }
+  std::vector<SmallVector<char, 0>> code(stale_pieces.size());
+  parallel_for(jobs_, stale_pieces.size(), [&](size_t i) {
+    generate(*stale_pieces[i].first, defs, stale_pieces[i].second, code[i]);
+  });
+
+  // what is left of removed fns are declarations; those still called have
+  // the same prototype as before, or their callers would be stale.
+  for (auto it = module_->begin(); it != module_->end();) {
+    auto &fn = *it++;
+    if (fn.isDeclaration() && fn.use_empty()) {
+      fn.eraseFromParent();
+    }
+  }
+  Linker linker(*module_);
+  for (size_t i = 0; i < stale_pieces.size(); ++i) {
+    add(linker, *stale_pieces[i].first,
+        StringRef(code[i].data(), code[i].size()));
+  }
+  // fns go in source order, whatever order they were added in.
+  for (auto &piece : pieces_) {
+    for (auto &name : piece->fns) {
+      if (auto fn = module_->getFunction(name)) {
+        fn->removeFromParent();
+        module_->getFunctionList().push_back(fn);
+      }
+    }
+  }
+  codegen::sort_declarations(*module_);
+
+  stats.pieces = pieces_.size();
+  stats.parsed = unparsed.size();
+  stats.generated = stale_pieces.size();
+  return stats;
+}
+
+bool Session::stale(const Piece &piece, const Definitions &defs,
+                    size_t position) const {
+  if (!piece.generated) {
+    return true;
+  }
+
+  // a fn that became, or stopped being, the first of its name.
+  bool stale = false;
+  size_t i = 0;
+  piece.ctx->each_expr([&](const ast::Expression &expr) {
+    bool first = expr.kind() == ast::Kind::Function &&
+                 defs.is_first(
+                     static_cast<const ast::Function &>(expr).proto().name(),
+                     position + i);
+    stale = stale || first != piece.first[i];
+    ++i;
+  });
+
+  // a callee that went away or changed its prototype. Callees defined in
+  // the piece itself are in its code, so later fns of the piece resolve the
+  // rest as the first one does.
+  for (auto &callee : piece.callees) {
+    auto proto = defs.lookup(callee.first, position);
+    stale = stale || proto == nullptr ||
+            proto->params().size() != callee.second;
+  }
+  return stale;
+}
+
+void Session::generate(Piece &piece, const Definitions &defs,
+                       size_t position, SmallVectorImpl<char> &code) {
+  LLVMContext llvm;
+  codegen::Codegen codegen(*ctx_, llvm, level_);
+  piece.generated = true;
+  piece.first.clear();
+  piece.ctx->each_expr([&](const ast::Expression &expr) {
+    bool first = false;
+    if (expr.kind() == ast::Kind::Function) {
+      auto &fn = static_cast<const ast::Function &>(expr);
+      first = defs.is_first(fn.proto().name(), position);
+      // a piece that did not parse has its syntax errors, and no fns.
+      if (first && (piece.errors > 0 ||
+                    codegen.generate(fn, defs, position) == nullptr)) {
+        piece.generated = false;
+      }
+    }
+    piece.first.push_back(first);
+    ++position;
+  });
+  codegen.finish();
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    codegen.flush_errors();
+  }
+
+  // a piece that failed is generated again next time; what did generate
+  // still goes in the module, for the errors of its callers to be the same
+  // as in a full build.
+  piece.callees.clear();
+  for (auto &fn : codegen.module()) {
+    if (!fn.isDeclaration()) {
+      piece.fns.push_back(fn.getName().str());
+    } else if (!fn.isIntrinsic()) {
+      piece.callees.emplace_back(ctx_->interner().intern(fn.getName().str()),
+                                 fn.arg_size());
+    }
+  }
+  raw_svector_ostream out(code);
+  WriteBitcodeToFile(codegen.module(), out);
+}
+
+void Session::remove(Piece &piece) {
+  for (auto &name : piece.fns) {
+    if (auto fn = module_->getFunction(name)) {
+      fn->deleteBody();
+    }
+  }
+  piece.fns.clear();
+  piece.generated = false;
+}
+
+void Session::add(Linker &linker, Piece &piece, StringRef code) {
+  auto module = parseBitcodeFile(MemoryBufferRef(code, name_), llvm_);
+  if (!module) {
+    ctx_->report_error(
+        err::unknown("cannot read piece", toString(module.takeError())));
+    piece.fns.clear();
+    piece.generated = false;
+    return;
+  }
+  if (linker.linkInModule(std::move(*module))) {
+    ctx_->report_error(err::unknown("cannot link piece", ""));
+    piece.fns.clear();
+    piece.generated = false;
+  }
+}
+
+Context &Session::context() { return *ctx_; }
+
+const Module &Session::module() const { return *module_; }
+
+codegen::Shard Session::shard() const {
+  // modules cannot be shared between LLVMContexts.
+  codegen::Shard shard{std::make_unique<LLVMContext>(), nullptr};
+  SmallVector<char, 0> buffer;
+  raw_svector_ostream out(buffer);
+  WriteBitcodeToFile(*module_, out);
+  auto module = parseBitcodeFile(
+      MemoryBufferRef(StringRef(buffer.data(), buffer.size()), name_),
+      *shard.llvm);
+  if (!module) {
+    ctx_->report_error(
+        err::unknown("cannot copy module", toString(module.takeError())));
+    shard.module = std::make_unique<Module>(name_, *shard.llvm);
+    return shard;
+  }
+  shard.module = std::move(*module);
+  return shard;
+}
+
+} // namespace compiler
+} // namespace lang
@@ -0,0 +1,98 @@
+#ifndef LANG_COMPILER_SESSION_H
+#define LANG_COMPILER_SESSION_H
+
+#include "codegen.h"
+#include "context.h"
+#include "definitions.h"
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <llvm/ADT/SmallVector.h>
+#include <llvm/ADT/StringRef.h>
+#include <llvm/IR/LLVMContext.h>
+#include <llvm/IR/Module.h>
+#include <llvm/Linker/Linker.h>
+
+namespace lang {
+namespace compiler {
+
+// Session compiles successive versions of one source file, redoing only
+// what an edit invalidates. The source is cut into pieces at top-level fns
+// (see lex::split); a piece whose text is unchanged keeps its tokens and
+// tree, and its fns keep their IR in the module of the session as long as
+// the prototypes of their callees stay the same. Since fns are optimized
+// one by one, none is inlined into another.
+class Session {
+  // Piece is one top-level fn, with the text after it up to the next one.
+  struct Piece {
+    std::string text;
+    uint32_t line;
+    // the piece parsed on its own, borrowing text.
+    std::unique_ptr<Context> ctx;
+    // errors from parsing ctx.
+    size_t errors;
+    // whether every first definition of ctx is in the module.
+    bool generated;
+    // the fns of ctx that were first definitions and are in the module,
+    // and the arity of every other fn they call, as resolved then.
+    std::vector<bool> first;
+    std::vector<std::string> fns;
+    std::vector<std::pair<Symbol, size_t>> callees;
+  };
+
+  GlobalContext global_;
+  const std::string name_;
+  const codegen::OptLevel level_;
+  const size_t jobs_;
+  std::vector<std::unique_ptr<Piece>> pieces_;
+  std::unique_ptr<Context> ctx_;
+  // guards the errors of ctx_ while pieces are generated.
+  std::mutex mutex_;
+  // the IR of every piece, in order.
+  llvm::LLVMContext llvm_;
+  std::unique_ptr<llvm::Module> module_;
+
+  bool stale(const Piece &piece, const Definitions &defs,
+             size_t position) const;
+  void generate(Piece &piece, const Definitions &defs, size_t position,
+                llvm::SmallVectorImpl<char> &code);
+  void remove(Piece &piece);
+  void add(llvm::Linker &linker, Piece &piece, llvm::StringRef code);
+
+public:
+  // What an update did.
+  struct Stats {
+    size_t pieces;
+    // pieces lexed and parsed again.
+    size_t parsed;
+    // pieces whose IR was generated again.
+    size_t generated;
+  };
+
+  // A session for the file name, which generates IR at level and lexes,
+  // parses and generates pieces on up to jobs threads.
+  Session(const std::string &name, codegen::OptLevel level,
+          size_t jobs = 1);
+  Session(const Session &) = delete;
+  ~Session();
+
+  // Compiles source, the new version of the file. Errors go to context().
+  Stats update(std::unique_ptr<const Source> source);
+  // The unit of the latest version: the top-level nodes of every piece in
+  // order and their errors. Its cfg is not built.
+  Context &context();
+  // The module of the latest version, only meaningful if it has no errors,
+  // and a copy of it on an LLVMContext of its own, for a JIT or code
+  // generation to take over.
+  const llvm::Module &module() const;
+  codegen::Shard shard() const;
+};
+
+} // namespace compiler
+} // namespace lang
+
+#endif // LANG_COMPILER_SESSION_H
@@ -0,0 +1,84 @@
+#include "source.h"
+#include <fstream>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace lang {
+namespace compiler {
+
+Source::Source(const char *data, size_t size, bool mapped)
+    : data_(data), size_(size), mapped_(mapped) {}
+
+Source::Source(std::string owned)
+    : data_(nullptr), size_(owned.size()), mapped_(false),
+      owned_(std::move(owned)) {
+  data_ = owned_.data();
+}
+
+Source::~Source() {
+  if (mapped_) {
+    munmap(const_cast<char *>(data_), size_);
+  }
+}
+
+std::unique_ptr<const Source> Source::map(const std::string &path) {
+  int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return nullptr;
+  }
+
+  struct stat st;
+  if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+    close(fd);
+    return nullptr;
+  }
+
+  if (st.st_size == 0) {
+    // mmap rejects empty mappings.
+    close(fd);
+    return std::unique_ptr<const Source>(new Source(std::string()));
+  }
+
+  size_t size = st.st_size;
+  void *addr = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (addr == MAP_FAILED) {
+    return nullptr;
+  }
+  madvise(addr, size, MADV_SEQUENTIAL);
+
+  return std::unique_ptr<const Source>(
+      new Source(static_cast<const char *>(addr), size, true));
+}
+
+std::unique_ptr<const Source> Source::borrow(const char *data, size_t size) {
+  return std::unique_ptr<const Source>(new Source(data, size, false));
+}
+
+std::unique_ptr<const Source> Source::read(std::istream &in) {
+  std::string buf;
+  char chunk[1 << 16];
+  while (in.read(chunk, sizeof(chunk)) || in.gcount() > 0) {
+    buf.append(chunk, in.gcount());
+  }
+  return std::unique_ptr<const Source>(new Source(std::move(buf)));
+}
+
+std::unique_ptr<const Source> Source::load(const std::string &path,
+                                           std::ostream &errors) {
+  if (auto source = map(path)) {
+    return source;
+  }
+  std::ifstream in(path);
+  if (!in) {
+    errors << path << ": cannot read file\n";
+    return nullptr;
+  }
+  return read(in);
+}
+
+} // namespace compiler
+} // namespace lang
@@ -0,0 +1,49 @@
+#ifndef LANG_COMPILER_SOURCE_H
+#define LANG_COMPILER_SOURCE_H
+
+#include <cstddef>
+#include <istream>
+#include <memory>
+#include <ostream>
+#include <string>
+
+namespace lang {
+namespace compiler {
+
+// Source is the contiguous, immutable text of a compilation unit. The bytes
+// are either mmapped from a regular file, borrowed from a caller-owned buffer
+// (which must outlive the Source), or read up-front from a std::istream when
+// the input cannot be mapped (pipes, sockets, string streams).
+class Source {
+  const char *data_;
+  size_t size_;
+  bool mapped_;
+  std::string owned_;
+
+  Source(const char *data, size_t size, bool mapped);
+  Source(std::string owned);
+
+public:
+  Source(const Source &) = delete;
+  Source(Source &&) = delete;
+  ~Source();
+
+  // Maps the file at path; returns nullptr if it cannot be opened or is not a
+  // regular file, in which case callers should fall back to `read`.
+  static std::unique_ptr<const Source> map(const std::string &path);
+  static std::unique_ptr<const Source> borrow(const char *data, size_t size);
+  static std::unique_ptr<const Source> read(std::istream &in);
+  // Maps the file at path, or reads it if it cannot be mapped; if neither
+  // works, writes "path: cannot read file" to errors and returns nullptr.
+  static std::unique_ptr<const Source> load(const std::string &path,
+                                            std::ostream &errors);
+
+  const char *begin() const { return data_; }
+  const char *end() const { return data_ + size_; }
+  size_t size() const { return size_; }
+};
+
+} // namespace compiler
+} // namespace lang
+
+#endif // LANG_COMPILER_SOURCE_H
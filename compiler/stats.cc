@@ -0,0 +1,272 @@
+#include "stats.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <ctime>
+
+namespace lang {
+namespace compiler {
+
+namespace {
+
+const char *const PHASE_NAMES[] = {"lex", "parse", "cfg", "codegen",
+                                   "optimize"};
+
+const char *const KIND_NAMES[] = {
+    "Assignment", "BinaryExpression", "Call",      "Function",
+    "If",         "Identifier",       "Integer",   "Parameter",
+    "Prototype",  "TupleAssignment",  "Value",
+};
+
+// The Stats and phase that allocations on this thread count toward.
+thread_local struct {
+  Stats *stats;
+  Stats::Phase phase;
+} current = {nullptr, Stats::LEX};
+
+// Formats nanoseconds as milliseconds.
+std::string ms(uint64_t ns) {
+  char buffer[32];
+  std::snprintf(buffer, sizeof(buffer), "%.3f", ns / 1e6);
+  return buffer;
+}
+
+// Formats bytes as kilobytes.
+std::string kb(uint64_t bytes) {
+  char buffer[32];
+  std::snprintf(buffer, sizeof(buffer), "%.1f", bytes / 1024.0);
+  return buffer;
+}
+
+// Pads text to width, on the left for numbers.
+std::string pad(const std::string &text, size_t width, bool number = true) {
+  if (text.size() >= width) {
+    return text;
+  }
+  std::string space(width - text.size(), ' ');
+  return number ? space + text : text + space;
+}
+
+} // namespace
+
+// -----------------------------------------------------------------------------
+// Timer
+// -----------------------------------------------------------------------------
+Stats::Timer::Timer(Stats *stats, Phase phase)
+    : stats_(stats), phase_(phase), start_{0, 0}, outer_stats_(nullptr),
+      outer_phase_(phase) {
+  if (stats_ != nullptr) {
+    outer_stats_ = current.stats;
+    outer_phase_ = current.phase;
+    current.stats = stats_;
+    current.phase = phase_;
+    start_ = now();
+    stats_->start(phase_, start_.wall);
+  }
+}
+
+Stats::Timer::~Timer() { stop(); }
+
+Stats::Time Stats::Timer::stop() {
+  if (stats_ == nullptr) {
+    return Time{0, 0};
+  }
+  auto end = now();
+  Time time{end.wall - start_.wall, end.cpu - start_.cpu};
+  current.stats = outer_stats_;
+  current.phase = outer_phase_;
+  stats_->stop(phase_, end.wall, time);
+  stats_ = nullptr;
+  return time;
+}
+
+// -----------------------------------------------------------------------------
+// Stats
+// -----------------------------------------------------------------------------
+std::atomic<bool> Stats::counting_(false);
+std::atomic<int64_t> Stats::live_(0);
+
+const char *Stats::name(Phase phase) { return PHASE_NAMES[phase]; }
+
+Stats::Time Stats::now() {
+  timespec cpu;
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpu);
+  auto wall = std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now().time_since_epoch());
+  return Time{uint64_t(wall.count()),
+              uint64_t(cpu.tv_sec) * 1000000000 + uint64_t(cpu.tv_nsec)};
+}
+
+void Stats::start(Phase phase, uint64_t wall) {
+  std::lock_guard<std::mutex> lock(elapsed_mutex_);
+  for (auto elapsed : {&elapsed_[phase], &elapsed_[PHASES]}) {
+    if (elapsed->running++ == 0) {
+      elapsed->since = wall;
+    }
+  }
+}
+
+void Stats::stop(Phase phase, uint64_t wall, Time time) {
+  phases_[phase].cpu += time.cpu;
+  ++phases_[phase].count;
+  std::lock_guard<std::mutex> lock(elapsed_mutex_);
+  for (auto elapsed : {&elapsed_[phase], &elapsed_[PHASES]}) {
+    if (--elapsed->running == 0) {
+      elapsed->wall += wall - elapsed->since;
+    }
+  }
+}
+
+Stats::Time Stats::time(Phase phase) const {
+  std::lock_guard<std::mutex> lock(elapsed_mutex_);
+  return Time{elapsed_[phase].wall, phases_[phase].cpu};
+}
+
+void Stats::count_allocations() { counting_ = true; }
+
+void Stats::allocated(size_t size) {
+  if (!counting()) {
+    return;
+  }
+  int64_t live = live_.fetch_add(size, std::memory_order_relaxed) + size;
+  if (current.stats == nullptr) {
+    return;
+  }
+  auto &phase = current.stats->phases_[current.phase];
+  phase.allocations.fetch_add(1, std::memory_order_relaxed);
+  phase.allocated.fetch_add(size, std::memory_order_relaxed);
+  auto peak = phase.peak.load(std::memory_order_relaxed);
+  while (live > peak && !phase.peak.compare_exchange_weak(peak, live)) {
+  }
+}
+
+void Stats::freed(size_t size) {
+  if (counting()) {
+    live_.fetch_sub(size, std::memory_order_relaxed);
+  }
+}
+
+uint64_t Stats::nodes() const {
+  uint64_t count = 0;
+  for (auto &nodes : nodes_) {
+    count += nodes;
+  }
+  return count;
+}
+
+void Stats::add_function(const std::string &name, Time time,
+                         uint64_t instructions) {
+  instructions_ += instructions;
+  std::lock_guard<std::mutex> lock(mutex_);
+  functions_.push_back(Function{name, time, instructions});
+}
+
+void Stats::print(std::ostream &out, bool phases_only) const {
+  out << pad("phase", 10, false) << pad("wall ms", 12) << pad("cpu ms", 12)
+      << pad("count", 10);
+  if (counting()) {
+    out << pad("allocs", 12) << pad("alloc KB", 12) << pad("peak KB", 12);
+  }
+  out << "\n";
+  uint64_t cpu = 0;
+  for (size_t i = 0; i < PHASES; ++i) {
+    auto &phase = phases_[i];
+    out << pad(PHASE_NAMES[i], 10, false)
+        << pad(ms(time(Phase(i)).wall), 12) << pad(ms(phase.cpu), 12)
+        << pad(std::to_string(phase.count), 10);
+    if (counting()) {
+      out << pad(std::to_string(phase.allocations), 12)
+          << pad(kb(phase.allocated), 12)
+          << pad(kb(peak(Phase(i))), 12);
+    }
+    out << "\n";
+    cpu += phase.cpu;
+  }
+  uint64_t wall;
+  {
+    std::lock_guard<std::mutex> lock(elapsed_mutex_);
+    wall = elapsed_[PHASES].wall;
+  }
+  out << pad("total", 10, false) << pad(ms(wall), 12) << pad(ms(cpu), 12)
+      << "\n";
+  if (phases_only) {
+    return;
+  }
+
+  out << "\n"
+      << pad("tokens", 18, false) << pad(std::to_string(tokens_), 10) << "\n"
+      << pad("basic blocks", 18, false) << pad(std::to_string(blocks_), 10)
+      << "\n"
+      << pad("instructions", 18, false)
+      << pad(std::to_string(instructions_), 10) << "\n";
+  out << "\n" << pad("node", 18, false) << pad("count", 10) << pad("KB", 12)
+      << "\n";
+  for (size_t i = 0; i < KINDS; ++i) {
+    if (nodes_[i] > 0) {
+      out << pad(KIND_NAMES[i], 18, false) << pad(std::to_string(nodes_[i]), 10)
+          << pad(kb(node_bytes_[i]), 12) << "\n";
+    }
+  }
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (functions_.empty()) {
+    return;
+  }
+  auto slowest = functions_;
+  std::sort(slowest.begin(), slowest.end(),
+            [](const Function &a, const Function &b) {
+              return a.time.wall > b.time.wall;
+            });
+  slowest.resize(std::min(slowest.size(), SLOWEST));
+  out << "\n"
+      << pad("fn", 18, false) << pad("wall ms", 12) << pad("cpu ms", 12)
+      << pad("instructions", 14) << "\n";
+  for (auto &fn : slowest) {
+    out << pad(fn.name, 18, false) << pad(ms(fn.time.wall), 12)
+        << pad(ms(fn.time.cpu), 12)
+        << pad(std::to_string(fn.instructions), 14) << "\n";
+  }
+  if (functions_.size() > slowest.size()) {
+    out << "(" << functions_.size() - slowest.size() << " more fns)\n";
+  }
+}
+
+void Stats::print_json(std::ostream &out) const {
+  // names are identifiers, which need no escaping.
+  out << "{\"phases\":{";
+  for (size_t i = 0; i < PHASES; ++i) {
+    auto &phase = phases_[i];
+    out << (i > 0 ? "," : "") << "\"" << PHASE_NAMES[i] << "\":{\"wall_ms\":"
+        << ms(time(Phase(i)).wall) << ",\"cpu_ms\":" << ms(phase.cpu)
+        << ",\"count\":" << phase.count;
+    if (counting()) {
+      out << ",\"allocations\":" << phase.allocations
+          << ",\"allocated_bytes\":" << phase.allocated
+          << ",\"peak_bytes\":" << peak(Phase(i));
+    }
+    out << "}";
+  }
+  out << "},\"tokens\":" << tokens_ << ",\"basic_blocks\":" << blocks_
+      << ",\"instructions\":" << instructions_ << ",\"nodes\":{";
+  for (size_t i = 0; i < KINDS; ++i) {
+    out << (i > 0 ? "," : "") << "\"" << KIND_NAMES[i] << "\":" << nodes_[i];
+  }
+  out << "},\"node_bytes\":{";
+  for (size_t i = 0; i < KINDS; ++i) {
+    out << (i > 0 ? "," : "") << "\"" << KIND_NAMES[i]
+        << "\":" << node_bytes_[i];
+  }
+  out << "},\"functions\":[";
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (size_t i = 0; i < functions_.size(); ++i) {
+    auto &fn = functions_[i];
+    out << (i > 0 ? "," : "") << "{\"name\":\"" << fn.name
+        << "\",\"wall_ms\":" << ms(fn.time.wall)
+        << ",\"cpu_ms\":" << ms(fn.time.cpu)
+        << ",\"instructions\":" << fn.instructions << "}";
+  }
+  out << "]}\n";
+}
+
+} // namespace compiler
+} // namespace lang
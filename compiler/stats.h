@@ -0,0 +1,155 @@
+#ifndef LANG_COMPILER_STATS_H
+#define LANG_COMPILER_STATS_H
+
+#include "expressions.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace lang {
+namespace compiler {
+
+// Stats records where compilation spends its time: wall and CPU time per
+// phase and per generated fn, and counts of what the phases produce. A
+// Context only records into Stats it is given (see Context::set_stats), so
+// when disabled, instrumentation costs a null check. Recording is
+// thread-safe, so the shards of a unit and fns generated concurrently can
+// share one. A phase's wall time is how long any thread was in it, while
+// its CPU time is summed over threads.
+//
+// Stats can also count heap allocations per phase, for a program whose
+// operator new and delete report them (see allocated), as those of
+// compiler/alloc.cc do.
+class Stats {
+public:
+  enum Phase { LEX, PARSE, CFG, CODEGEN, OPTIMIZE, PHASES };
+
+  // Time in nanoseconds; cpu is that of the calling thread.
+  struct Time {
+    uint64_t wall;
+    uint64_t cpu;
+  };
+
+  // Timer measures from its construction to stop, or its destruction, and
+  // adds the time to a phase, unless stats is null. Meanwhile the phase is
+  // running, and allocations on the calling thread count toward it.
+  class Timer {
+    Stats *stats_;
+    const Phase phase_;
+    Time start_;
+    // the phase allocations counted toward before.
+    Stats *outer_stats_;
+    Phase outer_phase_;
+
+  public:
+    Timer(Stats *stats, Phase phase);
+    Timer(const Timer &) = delete;
+    ~Timer();
+
+    // Adds the time taken so far and returns it; later calls return zero.
+    Time stop();
+  };
+
+  struct Function {
+    std::string name;
+    Time time;
+    uint64_t instructions;
+  };
+
+  static const char *name(Phase phase);
+  static Time now();
+
+  void add_tokens(uint64_t count) { tokens_ += count; }
+  // A node of kind that takes bytes of its unit's arena.
+  void add_node(ast::Kind kind, uint64_t bytes) {
+    ++nodes_[static_cast<size_t>(kind)];
+    node_bytes_[static_cast<size_t>(kind)] += bytes;
+  }
+  void add_blocks(uint64_t count) { blocks_ += count; }
+  // A top-level fn, generated in time into instructions LLVM instructions.
+  void add_function(const std::string &name, Time time,
+                    uint64_t instructions);
+
+  Time time(Phase phase) const;
+  uint64_t allocations(Phase phase) const {
+    return phases_[phase].allocations;
+  }
+  // The most bytes live on the heap of the whole process, as seen by an
+  // allocation made in phase. That includes memory held by earlier phases
+  // and by other threads, so it bounds the memory the phase needs rather
+  // than measuring it. Zero if nothing was seen, or if more was freed than
+  // allocated since counting started.
+  uint64_t peak(Phase phase) const {
+    return std::max<int64_t>(phases_[phase].peak, 0);
+  }
+  uint64_t tokens() const { return tokens_; }
+  // of every kind.
+  uint64_t nodes() const;
+  uint64_t blocks() const { return blocks_; }
+  uint64_t instructions() const { return instructions_; }
+
+  // Counts allocations from now on, in this and every other Stats.
+  static void count_allocations();
+  static bool counting() { return counting_.load(std::memory_order_relaxed); }
+  // Called for each heap allocation and release of size bytes; they do
+  // nothing unless counting.
+  static void allocated(size_t size);
+  static void freed(size_t size);
+
+  // Prints the phases as a table and, unless only phases are asked for,
+  // the counts and the slowest fns.
+  void print(std::ostream &out, bool phases_only = false) const;
+  // Prints everything as a JSON object, with times in milliseconds.
+  void print_json(std::ostream &out) const;
+
+private:
+  static const size_t KINDS = static_cast<size_t>(ast::Kind::Value) + 1;
+  // how many fns print lists.
+  static const size_t SLOWEST = 10;
+
+  struct Total {
+    std::atomic<uint64_t> cpu{0};
+    std::atomic<uint64_t> count{0};
+    std::atomic<uint64_t> allocations{0};
+    std::atomic<uint64_t> allocated{0};
+    // most bytes live_ was seen at by an allocation in the phase.
+    std::atomic<int64_t> peak{0};
+  };
+  static std::atomic<bool> counting_;
+  // bytes allocated less bytes freed since counting started.
+  static std::atomic<int64_t> live_;
+
+  // The wall time while timers of a phase ran, counted once however many
+  // ran at a time.
+  struct Elapsed {
+    uint32_t running = 0;
+    uint64_t since = 0;
+    uint64_t wall = 0;
+  };
+
+  // at wall, a timer of phase starts or stops.
+  void start(Phase phase, uint64_t wall);
+  void stop(Phase phase, uint64_t wall, Time time);
+
+  Total phases_[PHASES];
+  mutable std::mutex elapsed_mutex_;
+  // per phase, then of any phase.
+  Elapsed elapsed_[PHASES + 1];
+  std::atomic<uint64_t> tokens_{0};
+  std::atomic<uint64_t> nodes_[KINDS] = {};
+  std::atomic<uint64_t> node_bytes_[KINDS] = {};
+  std::atomic<uint64_t> blocks_{0};
+  std::atomic<uint64_t> instructions_{0};
+
+  mutable std::mutex mutex_;
+  std::vector<Function> functions_;
+};
+
+} // namespace compiler
+} // namespace lang
+
+#endif // LANG_COMPILER_STATS_H
@@ -0,0 +1,112 @@
+#include "tiered.h"
+
+namespace lang {
+namespace compiler {
+namespace jit {
+
+// -----------------------------------------------------------------------------
+// Tiered
+// -----------------------------------------------------------------------------
+Tiered::Tiered(Context &ctx, std::unique_ptr<JIT> jit)
+    : ctx_(ctx), program_(ctx), interpreter_(program_, ctx.interner()),
+      jit_(std::move(jit)), pending_(0), promoted_(0), stop_(false) {}
+
+Tiered::~Tiered() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  changed_.notify_all();
+  if (worker_.joinable()) {
+    worker_.join();
+  }
+  report();
+}
+
+std::unique_ptr<Tiered>
+Tiered::create(std::unique_ptr<const err::Error> &error, Context &ctx,
+               uint64_t threshold, codegen::OptLevel level,
+               cache::Cache *cache) {
+  auto jit = JIT::create(error, level);
+  if (jit == nullptr) {
+    return nullptr;
+  }
+  if ((error = jit->add_lazy(ctx, cache))) {
+    return nullptr;
+  }
+
+  std::unique_ptr<Tiered> tiered(new Tiered(ctx, std::move(jit)));
+  tiered->interpreter_.set_tiering(tiered.get(), threshold);
+  tiered->worker_ = std::thread(&Tiered::work, tiered.get());
+  return tiered;
+}
+
+void Tiered::hot(uint32_t fn) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    queue_.push_back(fn);
+    ++pending_;
+  }
+  changed_.notify_all();
+}
+
+void Tiered::work() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  for (;;) {
+    changed_.wait(lock, [this]() { return stop_ || !queue_.empty(); });
+    if (stop_) {
+      return;
+    }
+    auto fn = queue_.front();
+    queue_.pop_front();
+    lock.unlock();
+
+    // a fn that fails to compile stays interpreted; why is kept for ctx.
+    auto &name = ctx_.interner().name(program_.functions()[fn].name);
+    uintptr_t entry = 0;
+    auto error = jit_->lookup(name, entry);
+    if (error == nullptr) {
+      interpreter_.promote(fn, entry);
+    }
+
+    lock.lock();
+    --pending_;
+    if (error == nullptr) {
+      ++promoted_;
+    } else {
+      failed_.push_back(std::move(error));
+    }
+    changed_.notify_all();
+  }
+}
+
+std::unique_ptr<const err::Error>
+Tiered::run(Symbol name, const std::vector<int64_t> &args, int64_t &result) {
+  return interpreter_.run(name, args, result);
+}
+
+void Tiered::drain() {
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    changed_.wait(lock, [this]() { return pending_ == 0; });
+  }
+  report();
+}
+
+void Tiered::report() {
+  // the worker is idle or gone, so nothing compiles to ctx meanwhile.
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (auto &error : failed_) {
+    ctx_.report_error(std::move(error));
+  }
+  failed_.clear();
+}
+
+size_t Tiered::promoted() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return promoted_;
+}
+
+} // namespace jit
+} // namespace compiler
+} // namespace lang
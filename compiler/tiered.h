@@ -0,0 +1,84 @@
+#ifndef LANG_COMPILER_TIERED_H
+#define LANG_COMPILER_TIERED_H
+
+#include "bytecode.h"
+#include "context.h"
+#include "interpreter.h"
+#include "jit.h"
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace lang {
+namespace compiler {
+namespace jit {
+
+// Tiered runs the fns of a unit on the bytecode interpreter, which costs
+// nothing up front, and compiles the fns that get hot to optimized native
+// code on a background thread. Calls to a fn switch to its native code once
+// it is ready; the fns that native code calls are compiled on their first
+// call, as with JIT::add_lazy.
+class Tiered : public bytecode::Tiering {
+  Context &ctx_;
+  bytecode::Program program_;
+  bytecode::Interpreter interpreter_;
+  std::unique_ptr<JIT> jit_;
+
+  std::mutex mutex_;
+  std::condition_variable changed_;
+  // hot fns waiting for the worker.
+  std::deque<uint32_t> queue_;
+  // hot fns not yet compiled, the one being compiled included.
+  size_t pending_;
+  size_t promoted_;
+  // why hot fns failed to compile, until handed to ctx_.
+  std::vector<std::unique_ptr<const err::Error>> failed_;
+  bool stop_;
+  std::thread worker_;
+
+  Tiered(Context &ctx, std::unique_ptr<JIT> jit);
+  void work();
+  // Hands the errors in failed_ to ctx_.
+  void report();
+
+public:
+  // Calls and back-edges that make a fn hot, unless told otherwise.
+  static const uint64_t HOT = 1000;
+
+  ~Tiered();
+
+  // Compiles ctx to bytecode and sets up a JIT at level, or returns nullptr
+  // and sets error. Errors in the fns of ctx go to ctx, which must outlive
+  // the engine, as must cache; see JIT::add_lazy.
+  static std::unique_ptr<Tiered>
+  create(std::unique_ptr<const err::Error> &error, Context &ctx,
+         uint64_t threshold = HOT,
+         codegen::OptLevel level = codegen::OptLevel::O2,
+         cache::Cache *cache = nullptr);
+
+  void hot(uint32_t fn) override;
+
+  // Calls fn name with args and stores what it returns in result. name must
+  // already be interned.
+  std::unique_ptr<const err::Error> run(Symbol name,
+                                        const std::vector<int64_t> &args,
+                                        int64_t &result);
+
+  // Waits until every fn that got hot is compiled or failed to compile, and
+  // reports why any failed to ctx; so does the destructor.
+  void drain();
+  // How many fns run native code.
+  size_t promoted();
+  const bytecode::Program &program() const { return program_; }
+  const bytecode::Interpreter &interpreter() const { return interpreter_; }
+};
+
+} // namespace jit
+} // namespace compiler
+} // namespace lang
+
+#endif // LANG_COMPILER_TIERED_H
@@ -1,51 +1,68 @@
 #ifndef LANG_COMPILER_TOKEN_H
 #define LANG_COMPILER_TOKEN_H
 
+#include "interner.h"
+#include "source.h"
 #include <cassert>
 #include <cstdint>
-#include <memory>
+#include <string>
+#include <string_view>
+#include <type_traits>
 
 namespace lang {
 namespace compiler {
 namespace lex {
 
 struct Location {
-  const uint32_t line;
-  const uint32_t col;
+  uint32_t line;
+  uint32_t col;
 
   Location() : line(0), col(0) {}
   Location(uint32_t l, uint32_t c) : line(l), col(c) {}
 };
 
+// X(keyword, spelling). Adding a keyword is a one-line change here; the
+// lexer's perfect hash (lexer_tables.h) is rebuilt at compile time.
+#define LANG_KEYWORDS(X)                                                       \
+  X(kwFN, "fn")                                                                \
+  X(kwVAR, "var")                                                              \
+  X(kwVAL, "val")                                                              \
+  X(kwIF, "if")                                                                \
+  X(kwELSE, "else")                                                            \
+  X(kwELIF, "elif")
+
+// X(operator, value, spelling). Single character operators use their ASCII
+// code as value; the parser relies on this for ast::BinaryExpression::op.
+#define LANG_OPERATORS(X)                                                      \
+  X(opLPAREN, 40, "(")                                                         \
+  X(opRPAREN, 41, ")")                                                         \
+  X(opSTAR, 42, "*")                                                           \
+  X(opPLUS, 43, "+")                                                           \
+  X(opCOMMA, 44, ",")                                                          \
+  X(opDASH, 45, "-")                                                           \
+  X(opSLASH, 47, "/")                                                          \
+  X(opCOLON, 58, ":")                                                          \
+  X(opSEMICOLON, 59, ";")                                                      \
+  X(opEQUAL, 61, "=")                                                          \
+  X(opLSQUARE, 91, "[")                                                        \
+  X(opRSQUARE, 93, "]")                                                        \
+  X(opLCURLY, 123, "{")                                                        \
+  X(opRCURLY, 125, "}")                                                        \
+  X(opCOMPARE, 128, "==")
+
+#define LANG_KEYWORD_ENUM(kw, spelling) kw,
 enum Keyword {
   kwINVALID = -1,
-  kwFN = 1,
-  kwVAR,
-  kwVAL,
-  kwIF,
-  kwELSE,
-  kwELIF,
+  LANG_KEYWORDS(LANG_KEYWORD_ENUM) kwCOUNT,
 };
+#undef LANG_KEYWORD_ENUM
 
+#define LANG_OPERATOR_ENUM(op, value, spelling) op = value,
 enum Operator {
   opINVALID = -1,
-  opLPAREN = 40,
-  opRPAREN = 41,
-  opSTAR = 42,
-  opPLUS = 43,
-  opCOMMA = 44,
-  opDASH = 45,
-  opSLASH = 47,
-  opCOLON = 58,
-  opSEMICOLON = 59,
-  opEQUAL = 61,
-  opLSQUARE = 91,
-  opRSQUARE = 93,
-  opLCURLY = 123,
-  // opPIPE = 124,
-  opRCURLY = 125,
-  opCOMPARE = 128,
+  LANG_OPERATORS(LANG_OPERATOR_ENUM)
 };
+#undef LANG_OPERATOR_ENUM
 
 enum Type {
   tEOF = -1,
@@ -59,23 +76,25 @@ enum Type {
   tFLOAT
 };
 
+// Token is a plain value; identifier and string payloads are not copied out
+// of the Source but referenced by offset/length (see `text`). Identifiers
+// also carry the Symbol they were interned as.
 class Token final {
-  const Type type_;
-  const Location loc_;
+  Type type_;
+  Location loc_;
+  uint32_t offset_;
+  uint32_t length_;
   union {
     Keyword keyword;
     Operator op;
     int64_t integer;
-    const std::string *string;
+    uint32_t symbol;
   } u_;
 
 public:
-  Token(const Type type, const Location loc) : type_(type), loc_(loc){};
-  Token(const Token &) = delete;
-  Token(Token &&) = delete;
-  ~Token();
-
-  Token &operator=(const Token &);
+  Token() : Token(Type::tINVALID, Location(), 0, 0) {}
+  Token(const Type type, const Location loc, uint32_t offset, uint32_t length)
+      : type_(type), loc_(loc), offset_(offset), length_(length), u_{} {};
 
   bool invalid() const { return type_ == Type::tINVALID; }
   bool eof() const { return type_ == Type::tEOF; }
@@ -88,6 +107,9 @@ public:
   bool is_operator(Operator op) const { return is_operator() && u_.op == op; }
 
   Type type() const { return type_; }
+  Location loc() const { return loc_; }
+  uint32_t offset() const { return offset_; }
+  uint32_t length() const { return length_; }
   Keyword keyword() const {
     assert(is_keyword());
     return u_.keyword;
@@ -96,61 +118,71 @@ public:
     assert(is_operator());
     return u_.op;
   }
-  const std::string identifier() const {
+  std::string_view identifier(const Source &source) const {
+    assert(is_identifier());
+    return text(source);
+  }
+  Symbol symbol() const {
     assert(is_identifier());
-    return std::string(*u_.string);
+    return Symbol(u_.symbol);
   }
   int64_t integer() const {
     assert(is_integer());
     return u_.integer;
   }
 
-  const std::string string() const;
+  // The bytes of the token in the source it was lexed from.
+  std::string_view text(const Source &source) const {
+    return std::string_view(source.begin() + offset_, length_);
+  }
+
+  const std::string string(const Source &source) const;
 
-  static std::unique_ptr<Token> make_invalid() {
+  static Token make_invalid() {
     // TODO: introduce a constant here
-    return make(Type::tINVALID, Location());
+    return Token(Type::tINVALID, Location(), 0, 0);
   }
-  static std::unique_ptr<Token> make_eof() {
-    // TODO: introduce a constant here
-    return make(Type::tEOF, Location());
+  static Token make_invalid(const Location loc, uint32_t offset,
+                            uint32_t length) {
+    return Token(Type::tINVALID, loc, offset, length);
   }
-  static std::unique_ptr<Token> make_op(const Operator op, const Location loc) {
-    auto token = make(Type::tOPERATOR, loc);
-    token->u_.op = op;
-    return token;
+  static Token make_eof(uint32_t offset) {
+    // TODO: introduce a constant here
+    return Token(Type::tEOF, Location(), offset, 0);
   }
-  static std::unique_ptr<Token> make_keyword(const Keyword keyword,
-                                             const Location loc) {
-    auto token = make(Type::tKEYWORD, loc);
-    token->u_.keyword = keyword;
+  static Token make_op(const Operator op, const Location loc, uint32_t offset,
+                       uint32_t length) {
+    Token token(Type::tOPERATOR, loc, offset, length);
+    token.u_.op = op;
     return token;
   }
-  static std::unique_ptr<Token>
-  make_identifier(std::unique_ptr<std::string> name, const Location loc) {
-    auto token = make(Type::tIDENTIFIER, loc);
-    token->u_.string = name.release();
+  static Token make_keyword(const Keyword keyword, const Location loc,
+                            uint32_t offset, uint32_t length) {
+    Token token(Type::tKEYWORD, loc, offset, length);
+    token.u_.keyword = keyword;
     return token;
   }
-  static std::unique_ptr<Token> make_string(std::unique_ptr<std::string> name,
-                                            const Location loc) {
-    auto token = make(Type::tIDENTIFIER, loc);
-    token->u_.string = name.release();
+  static Token make_identifier(const Symbol symbol, const Location loc,
+                               uint32_t offset, uint32_t length) {
+    Token token(Type::tIDENTIFIER, loc, offset, length);
+    token.u_.symbol = symbol.id();
     return token;
   }
-  static std::unique_ptr<Token> make_integer(const int value,
-                                             const Location loc) {
-    auto token = make(Type::tINTEGER, loc);
-    token->u_.integer = value;
-    return token;
+  static Token make_string(const Location loc, uint32_t offset,
+                           uint32_t length) {
+    return Token(Type::tSTRING, loc, offset, length);
   }
-
-  static std::unique_ptr<Token> make(const Type type, const Location loc) {
-    std::unique_ptr<Token> token = std::make_unique<Token>(type, loc);
+  static Token make_integer(const int64_t value, const Location loc,
+                            uint32_t offset, uint32_t length) {
+    Token token(Type::tINTEGER, loc, offset, length);
+    token.u_.integer = value;
     return token;
   }
 };
 
+static_assert(std::is_trivially_copyable<Token>::value,
+              "tokens are stored by value in the token stream");
+
 } // namespace lex
 } // namespace compiler
 } // namespace lang
@@ -0,0 +1,121 @@
+#include "trace.h"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+
+namespace lang {
+namespace compiler {
+
+namespace {
+
+std::atomic<uint64_t> traces(0);
+
+// The buffer the calling thread last recorded into, and whose it is.
+thread_local struct {
+  uint64_t trace;
+  void *buffer;
+} last = {0, nullptr};
+
+// Formats nanoseconds as the microseconds of the trace format.
+std::string us(uint64_t ns) {
+  char buffer[32];
+  std::snprintf(buffer, sizeof(buffer), "%.3f", ns / 1e3);
+  return buffer;
+}
+
+void write_string(std::ostream &out, const std::string &text) {
+  out << '"';
+  for (auto c : text) {
+    if (c == '"' || c == '\\') {
+      out << '\\' << c;
+    } else if (static_cast<unsigned char>(c) < 0x20) {
+      char escape[8];
+      std::snprintf(escape, sizeof(escape), "\\u%04x", c);
+      out << escape;
+    } else {
+      out << c;
+    }
+  }
+  out << '"';
+}
+
+} // namespace
+
+// -----------------------------------------------------------------------------
+// Span
+// -----------------------------------------------------------------------------
+Trace::Span::Span(Trace *trace, const char *category, std::string_view name)
+    : trace_(trace), category_(category), name_(name), begin_(0) {
+  if (trace_ != nullptr) {
+    begin_ = now();
+  }
+}
+
+Trace::Span::~Span() { end(); }
+
+void Trace::Span::end() {
+  if (trace_ != nullptr) {
+    trace_->add(category_, std::string(name_), begin_, now());
+    trace_ = nullptr;
+  }
+}
+
+// -----------------------------------------------------------------------------
+// Trace
+// -----------------------------------------------------------------------------
+Trace::Trace() : id_(++traces), start_(now()) {}
+
+uint64_t Trace::now() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+void Trace::add(const char *category, std::string name, uint64_t begin,
+                uint64_t end) {
+  buffer().events.push_back(
+      Event{category, std::move(name), begin - start_, end - begin});
+}
+
+Trace::Buffer &Trace::buffer() {
+  if (last.trace == id_) {
+    return *static_cast<Buffer *>(last.buffer);
+  }
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto thread = std::this_thread::get_id();
+  Buffer *found = nullptr;
+  for (auto &buffer : buffers_) {
+    if (buffer->thread == thread) {
+      found = buffer.get();
+      break;
+    }
+  }
+  if (found == nullptr) {
+    buffers_.push_back(std::make_unique<Buffer>());
+    found = buffers_.back().get();
+    found->thread = thread;
+  }
+  last.trace = id_;
+  last.buffer = found;
+  return *found;
+}
+
+void Trace::write(std::ostream &out) const {
+  out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+  const char *separator = "";
+  for (size_t tid = 0; tid < buffers_.size(); ++tid) {
+    for (auto &event : buffers_[tid]->events) {
+      out << separator << "\n{\"ph\":\"X\",\"pid\":1,\"tid\":" << tid + 1
+          << ",\"cat\":\"" << event.category << "\",\"name\":";
+      write_string(out, event.name);
+      out << ",\"ts\":" << us(event.begin) << ",\"dur\":" << us(event.duration)
+          << "}";
+      separator = ",";
+    }
+  }
+  out << "\n]}\n";
+}
+
+} // namespace compiler
+} // namespace lang
@@ -0,0 +1,81 @@
+#ifndef LANG_COMPILER_TRACE_H
+#define LANG_COMPILER_TRACE_H
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace lang {
+namespace compiler {
+
+// Trace records spans of the compile on each thread and writes them in the
+// Chrome trace-event format, for chrome://tracing or Perfetto. Where Stats
+// adds times up, a trace shows when each span ran and on which thread, so
+// stalls and imbalance between workers show. A Context only traces into a
+// Trace it is given (see Context::set_trace).
+//
+// Each thread appends to a buffer of its own without locking; the lock is
+// only taken the first time a thread records into a Trace. So write must
+// not be called until the threads that recorded are done.
+class Trace {
+public:
+  // Span records from its construction to end, or its destruction, on the
+  // calling thread, unless trace is null. name must outlive the span.
+  class Span {
+    Trace *trace_;
+    const char *category_;
+    std::string_view name_;
+    uint64_t begin_;
+
+  public:
+    Span(Trace *trace, const char *category, std::string_view name);
+    Span(const Span &) = delete;
+    ~Span();
+
+    void end();
+  };
+
+  Trace();
+  Trace(const Trace &) = delete;
+
+  // Nanoseconds on the clock spans are measured with.
+  static uint64_t now();
+
+  // Records a span of the calling thread from begin to end.
+  void add(const char *category, std::string name, uint64_t begin,
+           uint64_t end);
+
+  // Writes every span recorded as a JSON object.
+  void write(std::ostream &out) const;
+
+private:
+  struct Event {
+    const char *category;
+    std::string name;
+    uint64_t begin;
+    uint64_t duration;
+  };
+  struct Buffer {
+    std::thread::id thread;
+    std::vector<Event> events;
+  };
+
+  // The buffer of the calling thread.
+  Buffer &buffer();
+
+  // tells the traces a thread has recorded into apart.
+  const uint64_t id_;
+  const uint64_t start_;
+  std::mutex mutex_;
+  std::vector<std::unique_ptr<Buffer>> buffers_;
+};
+
+} // namespace compiler
+} // namespace lang
+
+#endif // LANG_COMPILER_TRACE_H
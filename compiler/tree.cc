@@ -0,0 +1,400 @@
+#include "tree.h"
+#include "context.h"
+#include <cassert>
+
+namespace lang {
+namespace compiler {
+namespace ast {
+
+// -----------------------------------------------------------------------------
+// Building
+// -----------------------------------------------------------------------------
+Node Tree::add(Kind kind, uint32_t payload, uint32_t lhs, uint32_t rhs) {
+  assert(kinds_.size() < Node::INVALID);
+  Node node(kinds_.size());
+  kinds_.push_back(kind);
+  payload_.push_back(payload);
+  lhs_.push_back(lhs);
+  rhs_.push_back(rhs);
+  return node;
+}
+
+uint32_t Tree::add_list(const std::vector<Node> &nodes) {
+  uint32_t at = extra_.size();
+  extra_.push_back(Node(nodes.size()));
+  extra_.insert(extra_.end(), nodes.begin(), nodes.end());
+  return at;
+}
+
+Nodes Tree::list(uint32_t at) const {
+  return Nodes(extra_.data() + at + 1, extra_[at].id());
+}
+
+Node Tree::add_assignment(Node left, Node right) {
+  return add(Kind::Assignment, 0, left.id(), right.id());
+}
+
+Node Tree::add_binary(char op, Node left, Node right) {
+  return add(Kind::BinaryExpression, op, left.id(), right.id());
+}
+
+Node Tree::add_call(Symbol name, const std::vector<Node> &args) {
+  return add(Kind::Call, name.id(), add_list(args), 0);
+}
+
+Node Tree::add_function(Node proto, const std::vector<Node> &body) {
+  return add(Kind::Function, proto.id(), add_list(body), 0);
+}
+
+Node Tree::add_if(Node cond, const std::vector<Node> &thn,
+                  const std::vector<Node> &els) {
+  auto lhs = add_list(thn);
+  return add(Kind::If, cond.id(), lhs, add_list(els));
+}
+
+Node Tree::add_identifier(Symbol name) {
+  return add(Kind::Identifier, name.id(), 0, 0);
+}
+
+Node Tree::add_integer(int64_t value) {
+  integers_.push_back(value);
+  return add(Kind::Integer, integers_.size() - 1, 0, 0);
+}
+
+Node Tree::add_parameter(bool constant, Symbol name) {
+  return add(Kind::Parameter, name.id(), 0, constant);
+}
+
+Node Tree::add_prototype(Symbol name, const std::vector<Node> &params) {
+  return add(Kind::Prototype, name.id(), add_list(params), 0);
+}
+
+Node Tree::add_tuple_assignment(const std::vector<Node> &left,
+                                const std::vector<Node> &right) {
+  auto lhs = add_list(left);
+  return add(Kind::TupleAssignment, 0, lhs, add_list(right));
+}
+
+Node Tree::add_value(bool constant, Symbol name, Node value) {
+  return add(Kind::Value, name.id(), value.id(), constant);
+}
+
+// -----------------------------------------------------------------------------
+// Accessors
+// -----------------------------------------------------------------------------
+char Tree::op(Node node) const {
+  assert(kind(node) == Kind::BinaryExpression);
+  return payload_[node.id()];
+}
+
+Symbol Tree::name(Node node) const {
+  assert(kind(node) == Kind::Call || kind(node) == Kind::Identifier ||
+         kind(node) == Kind::Parameter || kind(node) == Kind::Prototype ||
+         kind(node) == Kind::Value);
+  return Symbol(payload_[node.id()]);
+}
+
+int64_t Tree::integer(Node node) const {
+  assert(kind(node) == Kind::Integer);
+  return integers_[payload_[node.id()]];
+}
+
+bool Tree::constant(Node node) const {
+  assert(kind(node) == Kind::Parameter || kind(node) == Kind::Value);
+  return rhs_[node.id()];
+}
+
+Node Tree::left(Node node) const {
+  assert(kind(node) == Kind::Assignment ||
+         kind(node) == Kind::BinaryExpression);
+  return Node(lhs_[node.id()]);
+}
+
+Node Tree::right(Node node) const {
+  assert(kind(node) == Kind::Assignment ||
+         kind(node) == Kind::BinaryExpression);
+  return Node(rhs_[node.id()]);
+}
+
+Node Tree::cond(Node node) const {
+  assert(kind(node) == Kind::If);
+  return Node(payload_[node.id()]);
+}
+
+Node Tree::proto(Node node) const {
+  assert(kind(node) == Kind::Function);
+  return Node(payload_[node.id()]);
+}
+
+Node Tree::value(Node node) const {
+  assert(kind(node) == Kind::Value);
+  return Node(lhs_[node.id()]);
+}
+
+Nodes Tree::args(Node node) const {
+  assert(kind(node) == Kind::Call);
+  return list(lhs_[node.id()]);
+}
+
+Nodes Tree::body(Node node) const {
+  assert(kind(node) == Kind::Function);
+  return list(lhs_[node.id()]);
+}
+
+Nodes Tree::params(Node node) const {
+  assert(kind(node) == Kind::Prototype);
+  return list(lhs_[node.id()]);
+}
+
+Nodes Tree::thn(Node node) const {
+  assert(kind(node) == Kind::If);
+  return list(lhs_[node.id()]);
+}
+
+Nodes Tree::els(Node node) const {
+  assert(kind(node) == Kind::If);
+  return list(rhs_[node.id()]);
+}
+
+Nodes Tree::lefts(Node node) const {
+  assert(kind(node) == Kind::TupleAssignment);
+  return list(lhs_[node.id()]);
+}
+
+Nodes Tree::rights(Node node) const {
+  assert(kind(node) == Kind::TupleAssignment);
+  return list(rhs_[node.id()]);
+}
+
+size_t Tree::bytes() const {
+  return kinds_.capacity() * sizeof(Kind) +
+         (payload_.capacity() + lhs_.capacity() + rhs_.capacity()) *
+             sizeof(uint32_t) +
+         (extra_.capacity() + roots_.capacity()) * sizeof(Node) +
+         integers_.capacity() * sizeof(int64_t);
+}
+
+void Tree::shrink_to_fit() {
+  kinds_.shrink_to_fit();
+  payload_.shrink_to_fit();
+  lhs_.shrink_to_fit();
+  rhs_.shrink_to_fit();
+  extra_.shrink_to_fit();
+  integers_.shrink_to_fit();
+  roots_.shrink_to_fit();
+}
+
+// -----------------------------------------------------------------------------
+// Printing
+// -----------------------------------------------------------------------------
+void Tree::print_body(std::ostream &out, const Interner &names, int indent,
+                      Nodes body) const {
+  if (body.empty()) {
+    out << "\n" << std::string(indent + 4, ' ') << "())";
+    return;
+  }
+
+  auto it = body.begin();
+  out << "\n" << std::string(indent + 4, ' ') << '(';
+  print(out, names, *it, indent + 4);
+
+  for (++it; it != body.end(); ++it) {
+    out << "\n" << std::string(indent + 5, ' ');
+    print(out, names, *it, indent + 5);
+  }
+}
+
+void Tree::print(std::ostream &out, const Interner &names, Node node,
+                 int indent) const {
+  switch (kind(node)) {
+  case Kind::Assignment:
+    out << "(asgn ";
+    for (auto child : {left(node), right(node)}) {
+      if (child.valid()) {
+        out << "\n";
+        print(out, names, child, indent + 6);
+      } else {
+        out << "nil";
+      }
+    }
+    out << ")";
+    break;
+  case Kind::BinaryExpression:
+    out << "(" << op(node);
+    for (auto child : {left(node), right(node)}) {
+      out << "\n" << std::string(indent + 1, ' ');
+      if (child.valid()) {
+        print(out, names, child, indent + 1);
+      } else {
+        out << "nil";
+      }
+    }
+    out << ")";
+    break;
+  case Kind::Call: {
+    out << "(call " << names.name(name(node));
+    for (auto arg : args(node)) {
+      out << "\n" << std::string(indent + 7, ' ');
+      print(out, names, arg, indent + 7);
+    }
+    out << ")";
+    break;
+  }
+  case Kind::Function:
+    out << "(fn ";
+    print(out, names, proto(node), indent + 4);
+    print_body(out, names, indent, body(node));
+    out << "))";
+    break;
+  case Kind::If:
+    out << "(if ";
+    print(out, names, cond(node), indent + 4);
+    print_body(out, names, indent, thn(node));
+    print_body(out, names, indent, els(node));
+    out << ")";
+    break;
+  case Kind::Identifier:
+    out << "(id " << names.name(name(node)) << ")";
+    break;
+  case Kind::Integer:
+    out << "(int " << integer(node) << ")";
+    break;
+  case Kind::Parameter:
+    out << "(param " << (constant(node) ? "val" : "var") << " "
+        << names.name(name(node)) << ")";
+    break;
+  case Kind::Prototype: {
+    out << "(proto " << names.name(name(node));
+
+    auto params = this->params(node);
+    if (params.empty()) {
+      out << " ())";
+      break;
+    }
+
+    auto it = params.begin();
+    out << "\n" << std::string(indent + 7, ' ') << '(';
+    print(out, names, *it);
+
+    for (++it; it != params.end(); ++it) {
+      out << "\n";
+      out << std::string(indent + 8, ' ');
+      print(out, names, *it, indent + 8);
+    }
+    out << "))";
+    break;
+  }
+  case Kind::TupleAssignment: {
+    out << "(asgn ";
+    auto lefts = this->lefts(node);
+    auto rights = this->rights(node);
+    for (size_t i = 0; i < lefts.size() && i < rights.size(); ++i) {
+      print(out, names, lefts[i]);
+      print(out, names, rights[i]);
+    }
+    break;
+  }
+  case Kind::Value:
+    out << "(" << (constant(node) ? "val" : "var") << " "
+        << names.name(name(node));
+    if (!value(node).valid()) {
+      out << " nil";
+    } else {
+      out << "\n" << std::string(indent + 6, ' ');
+      print(out, names, value(node), indent + 6);
+    }
+    out << ")";
+    break;
+  }
+}
+
+// -----------------------------------------------------------------------------
+// Lowering
+// -----------------------------------------------------------------------------
+namespace {
+
+class Lowering : public Visitor<Lowering, Node> {
+  Tree &tree_;
+
+  Node lower(const Expression *expr) {
+    return expr == nullptr ? Node() : dispatch(*expr);
+  }
+
+  template <typename T> std::vector<Node> lower(const Span<T> &exprs) {
+    std::vector<Node> nodes;
+    nodes.reserve(exprs.size());
+    for (auto expr : exprs) {
+      nodes.push_back(lower(expr));
+    }
+    return nodes;
+  }
+
+public:
+  Lowering(Tree &tree) : tree_(tree) {}
+
+  Node visit(const Assignment &expr) {
+    auto left = lower(&expr.left());
+    return tree_.add_assignment(left, lower(&expr.right()));
+  }
+
+  Node visit(const BinaryExpression &expr) {
+    auto left = lower(&expr.left());
+    auto right = lower(&expr.right());
+    return tree_.add_binary(expr.op(), left, right);
+  }
+
+  Node visit(const Call &expr) {
+    return tree_.add_call(expr.name(), lower(expr.args()));
+  }
+
+  Node visit(const Function &expr) {
+    auto proto = lower(&expr.proto());
+    return tree_.add_function(proto, lower(expr.body()));
+  }
+
+  Node visit(const If &expr) {
+    auto cond = lower(&expr.cond());
+    auto thn = lower(expr.thn());
+    return tree_.add_if(cond, thn, lower(expr.els()));
+  }
+
+  Node visit(const Identifier &expr) {
+    return tree_.add_identifier(expr.name());
+  }
+
+  Node visit(const Integer &expr) { return tree_.add_integer(expr.value()); }
+
+  Node visit(const Parameter &expr) {
+    return tree_.add_parameter(expr.constant(), expr.name());
+  }
+
+  Node visit(const Prototype &expr) {
+    return tree_.add_prototype(expr.name(), lower(expr.params()));
+  }
+
+  Node visit(const TupleAssignment &expr) {
+    auto left = lower(expr.left());
+    return tree_.add_tuple_assignment(left, lower(expr.right()));
+  }
+
+  Node visit(const Value &expr) {
+    auto value = expr.has_value() ? lower(&expr.value()) : Node();
+    return tree_.add_value(expr.constant(), expr.name(), value);
+  }
+};
+
+} // namespace
+
+Tree lower(Context &ctx) {
+  Tree tree;
+  Lowering lowering(tree);
+  ctx.each_expr([&tree, &lowering](const Expression &expr) {
+    tree.push_root(lowering.dispatch(expr));
+  });
+  tree.shrink_to_fit();
+  return tree;
+}
+
+} // namespace ast
+} // namespace compiler
+} // namespace lang
@@ -0,0 +1,138 @@
+#ifndef LANG_COMPILER_TREE_H
+#define LANG_COMPILER_TREE_H
+
+#include "arena.h"
+#include "expressions.h"
+#include "interner.h"
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+namespace lang {
+namespace compiler {
+
+class Context;
+
+namespace ast {
+
+// Node is a 32-bit handle to a node of a Tree.
+class Node {
+  uint32_t id_;
+
+public:
+  static const uint32_t INVALID = UINT32_MAX;
+
+  Node() : id_(INVALID) {}
+  explicit Node(uint32_t id) : id_(id) {}
+
+  uint32_t id() const { return id_; }
+  bool valid() const { return id_ != INVALID; }
+
+  bool operator==(const Node &other) const { return id_ == other.id_; }
+  bool operator!=(const Node &other) const { return id_ != other.id_; }
+};
+
+typedef Span<Node> Nodes;
+
+// Tree stores an AST as parallel arrays indexed by Node. Each node has a
+// kind, a payload and two operands, whose meaning depends on the kind:
+//
+//   kind             payload    lhs          rhs
+//   Assignment       -          left node    right node
+//   BinaryExpression op         left node    right node
+//   Call             name       args list    -
+//   Function         proto node body list    -
+//   If               cond node  then list    else list
+//   Identifier       name       -            -
+//   Integer          literal    -            -
+//   Parameter        name       -            constant
+//   Prototype        name       params list  -
+//   TupleAssignment  -          left list    right list
+//   Value            name       value node   constant
+//
+// Lists live in `extra_` as a count, stored as the id of a Node, followed by
+// that many handles, so a list is a span of extra_ itself. Children are
+// added before their parents, so the nodes of a function body are one
+// contiguous run of the arrays.
+//
+// The compiler does not use Tree: the parser builds the arena AST, which
+// every pass walks. Tree is a layout to measure against it; bench-tree
+// lowers a parsed unit into one and compares the memory of the two and the
+// time of a pass over each. Like compiler/alloc.cc, tree.cc is in no
+// library, and the programs that use it compile it in.
+class Tree {
+  std::vector<Kind> kinds_;
+  std::vector<uint32_t> payload_;
+  std::vector<uint32_t> lhs_;
+  std::vector<uint32_t> rhs_;
+  std::vector<Node> extra_;
+  std::vector<int64_t> integers_;
+  std::vector<Node> roots_;
+
+  Node add(Kind kind, uint32_t payload, uint32_t lhs, uint32_t rhs);
+  uint32_t add_list(const std::vector<Node> &nodes);
+  Nodes list(uint32_t at) const;
+
+  void print_body(std::ostream &out, const Interner &names, int indent,
+                  Nodes body) const;
+
+public:
+  Tree() {}
+  Tree(const Tree &) = delete;
+  Tree(Tree &&) = default;
+
+  Node add_assignment(Node left, Node right);
+  Node add_binary(char op, Node left, Node right);
+  Node add_call(Symbol name, const std::vector<Node> &args);
+  Node add_function(Node proto, const std::vector<Node> &body);
+  Node add_if(Node cond, const std::vector<Node> &thn,
+              const std::vector<Node> &els);
+  Node add_identifier(Symbol name);
+  Node add_integer(int64_t value);
+  Node add_parameter(bool constant, Symbol name);
+  Node add_prototype(Symbol name, const std::vector<Node> &params);
+  Node add_tuple_assignment(const std::vector<Node> &left,
+                            const std::vector<Node> &right);
+  Node add_value(bool constant, Symbol name, Node value);
+
+  // top level expressions, in source order.
+  void push_root(Node node) { roots_.push_back(node); }
+  const std::vector<Node> &roots() const { return roots_; }
+
+  Kind kind(Node node) const { return kinds_[node.id()]; }
+  char op(Node node) const;
+  Symbol name(Node node) const;
+  int64_t integer(Node node) const;
+  bool constant(Node node) const;
+  Node left(Node node) const;
+  Node right(Node node) const;
+  Node cond(Node node) const;
+  Node proto(Node node) const;
+  Node value(Node node) const;
+  Nodes args(Node node) const;
+  Nodes body(Node node) const;
+  Nodes params(Node node) const;
+  Nodes thn(Node node) const;
+  Nodes els(Node node) const;
+  Nodes lefts(Node node) const;
+  Nodes rights(Node node) const;
+
+  size_t size() const { return kinds_.size(); }
+  // bytes held by the arrays.
+  size_t bytes() const;
+  // Releases spare capacity once the tree is complete.
+  void shrink_to_fit();
+
+  // Prints node in the same format as ast::Expression::print.
+  void print(std::ostream &out, const Interner &names, Node node,
+             int indent = 0) const;
+};
+
+// Lowers the arena AST of ctx into a Tree.
+Tree lower(Context &ctx);
+
+} // namespace ast
+} // namespace compiler
+} // namespace lang
+
+#endif // LANG_COMPILER_TREE_H
@@ -1,6 +1,720 @@
 #define DOCTEST_CONFIG_IMPLEMENT
+#include "compiler/bytecode.h"
+#include "compiler/cfg.h"
+#include "compiler/codegen.h"
+#include "compiler/interpreter.h"
+#include "compiler/jit.h"
+#include "compiler/object.h"
+#include "compiler/parallel.h"
+#include "compiler/parser.h"
+#include "compiler/server.h"
+#include "compiler/session.h"
+#include "compiler/stats.h"
+#include "compiler/tiered.h"
+#include "compiler/trace.h"
+#include "cxxopts.hpp"
 #include "doctest.h"
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <sstream>
+#include <thread>
+#include <unordered_map>
 
-int main() {
-  return 1;
+#include <llvm/ADT/SmallString.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/Path.h>
+#include <llvm/Support/raw_os_ostream.h>
+#include <llvm/Support/raw_ostream.h>
+
+namespace lang {
+namespace compiler {
+
+// Prints the errors of ctx and returns how many there were.
+size_t report_errors(Context &ctx) {
+  size_t count = 0;
+  ctx.each_error([&count](const err::Error &err) {
+    std::cerr << err << "\n";
+    ++count;
+  });
+  return count;
+}
+
+// Generates ctx into a shard or, with more than one job, into shards
+// generated at once (see codegen::generate_parallel).
+std::vector<codegen::Shard> generate(Context &ctx, codegen::OptLevel level,
+                                     size_t jobs) {
+  if (jobs > 1) {
+    return codegen::generate_parallel(ctx, jobs, level);
+  }
+  std::vector<codegen::Shard> shards;
+  shards.push_back(codegen::generate_shard(ctx, level));
+  return shards;
+}
+
+// Runs fn name with args on jit, unless error is set, and prints its result.
+int execute(jit::JIT *jit, std::unique_ptr<const err::Error> error,
+            const std::string &name, const std::vector<int64_t> &args) {
+  int64_t result = 0;
+  if (error == nullptr) {
+    error = jit->run(name, args, result);
+  }
+  if (error != nullptr) {
+    std::cerr << *error << "\n";
+    return 1;
+  }
+  std::cout << result << "\n";
+  return 0;
+}
+
+// Runs fn name of shards with args and prints its result. Each shard is
+// added to the JIT as a module of its own.
+int execute(std::vector<codegen::Shard> shards, codegen::OptLevel level,
+            const std::string &name, const std::vector<int64_t> &args) {
+  std::unique_ptr<const err::Error> error;
+  auto jit = jit::JIT::create(error, level);
+  for (size_t i = 0; jit != nullptr && error == nullptr && i < shards.size();
+       ++i) {
+    error = jit->add(std::move(shards[i]));
+  }
+  return execute(jit.get(), std::move(error), name, args);
+}
+
+// Runs fn name of ctx with args and prints its result. A lazy run generates
+// only the fns that are called, unless cache has them; any other run
+// generates all of them on up to jobs threads.
+int execute(Context &ctx, codegen::OptLevel level, size_t jobs, bool lazy,
+            cache::Cache *cache, const std::string &name,
+            const std::vector<int64_t> &args) {
+  if (!lazy) {
+    auto shards = generate(ctx, level, jobs);
+    if (report_errors(ctx) > 0) {
+      return 1;
+    }
+    return execute(std::move(shards), level, name, args);
+  }
+
+  std::unique_ptr<const err::Error> error;
+  auto jit = jit::JIT::create(error, level);
+  if (jit != nullptr) {
+    error = jit->add_lazy(ctx, cache);
+  }
+  return execute(jit.get(), std::move(error), name, args);
+}
+
+// Like execute, on the bytecode interpreter.
+int interpret(Context &ctx, const std::string &name,
+              const std::vector<int64_t> &args) {
+  bytecode::Program program(ctx);
+  if (report_errors(ctx) > 0) {
+    return 1;
+  }
+
+  int64_t result = 0;
+  bytecode::Interpreter interpreter(program, ctx.interner());
+  if (auto error = interpreter.run(ctx.interner().intern(name), args, result)) {
+    std::cerr << *error << "\n";
+    return 1;
+  }
+  std::cout << result << "\n";
+  return 0;
+}
+
+// Like execute, starting on the bytecode interpreter and moving fns called
+// hot times to native code.
+int tiered(Context &ctx, codegen::OptLevel level, uint64_t hot,
+           cache::Cache *cache, const std::string &name,
+           const std::vector<int64_t> &args) {
+  std::unique_ptr<const err::Error> error;
+  auto engine = jit::Tiered::create(error, ctx, hot, level, cache);
+  if (engine == nullptr) {
+    std::cerr << *error << "\n";
+    return 1;
+  }
+  if (report_errors(ctx) > 0) {
+    return 1;
+  }
+
+  int64_t result = 0;
+  if ((error = engine->run(ctx.interner().intern(name), args, result))) {
+    std::cerr << *error << "\n";
+    return 1;
+  }
+  std::cout << result << "\n";
+  // fns that failed to compile ran interpreted, so result stands.
+  engine->drain();
+  return report_errors(ctx) > 0 ? 1 : 0;
+}
+
+// How a fn given to --run is executed.
+enum class Mode { JIT, Lazy, Interpret, Tiered };
+
+// Where compile writes machine code; an empty path prints IR instead.
+struct Output {
+  std::string path;
+  // fn an executable runs, or nullptr for an object file.
+  const std::string *entry;
+  // pieces that are parsed, and whose code is generated, at once.
+  size_t jobs;
+};
+
+int compile(const std::string &path, codegen::OptLevel level, Mode mode,
+            uint64_t hot, const std::string *run,
+            const std::vector<int64_t> &args, const Output &output,
+            cache::Cache *cache, Stats *stats, Trace *trace) {
+  auto source = Source::load(path, std::cerr);
+  if (!source) {
+    return 1;
+  }
+
+  GlobalContext gctx;
+  Context ctx(gctx, path, std::move(source));
+  ctx.set_stats(stats);
+  ctx.set_trace(trace);
+  Parser::parse(ctx, output.jobs);
+  if (report_errors(ctx) > 0) {
+    return 1;
+  }
+
+  if (run != nullptr && mode == Mode::Interpret) {
+    return interpret(ctx, *run, args);
+  } else if (run != nullptr && mode == Mode::Tiered) {
+    return tiered(ctx, level, hot, cache, *run, args);
+  } else if (run != nullptr) {
+    return execute(ctx, level, output.jobs, mode == Mode::Lazy, cache, *run,
+                   args);
+  }
+
+  if (!output.path.empty() && cache != nullptr) {
+    auto error = object::write(ctx, *cache, level, output.jobs, output.path,
+                               output.entry);
+    if (report_errors(ctx) > 0) {
+      return 1;
+    }
+    if (error != nullptr) {
+      std::cerr << *error << "\n";
+      return 1;
+    }
+    return 0;
+  }
+
+  if (output.path.empty()) {
+    // IR is printed as a single module, which linking shards costs more
+    // than generating it on one thread.
+    auto shard = codegen::generate_shard(ctx, level);
+    if (report_errors(ctx) > 0) {
+      return 1;
+    }
+    shard.module->print(llvm::outs(), nullptr);
+    return 0;
+  }
+  auto shards = generate(ctx, level, output.jobs);
+  if (report_errors(ctx) > 0) {
+    return 1;
+  }
+  Trace::Span span(trace, "codegen", "object");
+  if (auto error = object::write(shards, level, output.jobs, output.path,
+                                 output.entry)) {
+    std::cerr << *error << "\n";
+    return 1;
+  }
+  return 0;
+}
+
+// Compiles path like compile, again whenever it changes, and reports how
+// long each version took. Fns whose text is unchanged are not parsed again,
+// nor generated again unless the prototype of a callee changed. Never
+// returns.
+int watch(const std::string &path, codegen::OptLevel level,
+          const std::string *run, const std::vector<int64_t> &args,
+          const Output &output) {
+  Session session(path, level, output.jobs);
+  llvm::sys::TimePoint<> seen;
+  for (;; std::this_thread::sleep_for(std::chrono::milliseconds(100))) {
+    llvm::sys::fs::file_status status;
+    if (llvm::sys::fs::status(path, status) ||
+        status.getLastModificationTime() == seen) {
+      continue;
+    }
+    seen = status.getLastModificationTime();
+    // a mapping would break if the file is written while it is compiled.
+    std::fstream in(path, std::ios::in);
+    if (!in) {
+      std::cerr << path << ": cannot read file\n";
+      continue;
+    }
+    auto source = Source::read(in);
+
+    auto start = std::chrono::steady_clock::now();
+    auto stats = session.update(std::move(source));
+    std::chrono::duration<double, std::milli> elapsed =
+        std::chrono::steady_clock::now() - start;
+    if (report_errors(session.context()) > 0) {
+      continue;
+    }
+    std::cerr << path << ": " << stats.parsed << " of " << stats.pieces
+              << " fns parsed, " << stats.generated << " generated in "
+              << elapsed.count() << " ms\n";
+
+    if (output.path.empty() && run == nullptr) {
+      session.module().print(llvm::outs(), nullptr);
+      llvm::outs().flush();
+      continue;
+    }
+    auto shard = session.shard();
+    if (run != nullptr) {
+      std::vector<codegen::Shard> shards;
+      shards.push_back(std::move(shard));
+      execute(std::move(shards), level, *run, args);
+      std::cout.flush();
+    } else if (auto error = object::write(*shard.module, level, output.jobs,
+                                          output.path, output.entry)) {
+      std::cerr << *error << "\n";
+    }
+  }
+}
+
+// Serves compile requests on the socket path with jobs workers until
+// killed.
+int serve(const std::string &path, size_t jobs) {
+  std::unique_ptr<const err::Error> error;
+  auto server = server::Server::listen(error, path, jobs);
+  if (server == nullptr) {
+    std::cerr << *error << "\n";
+    return 1;
+  }
+  server->serve();
+  return 0;
+}
+
+// Has the server listening on socket compile path at level, and prints the
+// IR or writes the object file it sends back like compile.
+int remote(const std::string &socket, const std::string &path,
+           codegen::OptLevel level, const Output &output) {
+  if (output.entry != nullptr) {
+    std::cerr << "cannot link an executable on a server\n";
+    return 1;
+  }
+  // the server may run in another directory.
+  llvm::SmallString<128> absolute(path);
+  llvm::sys::fs::make_absolute(absolute);
+  server::Request request{output.path.empty() ? server::Emit::IR
+                                              : server::Emit::Object,
+                          level, true, absolute.str().str(), "",
+                          output.jobs};
+  server::Reply reply;
+  if (auto error = server::send(socket, request, reply)) {
+    std::cerr << *error << "\n";
+    return 1;
+  }
+  if (!reply.ok) {
+    std::cerr << reply.data;
+    return 1;
+  }
+  if (output.path.empty()) {
+    std::cout << reply.data;
+    return 0;
+  }
+  std::ofstream out(output.path, std::ios::binary);
+  out << reply.data;
+  if (!out.flush()) {
+    std::cerr << output.path << ": cannot write file\n";
+    return 1;
+  }
+  return 0;
+}
+
+// What --emit writes for each file, and the extension of its output.
+enum class Stage { Tokens, AST, CFG, LLVM, Object };
+const char *const STAGES[] = {"tokens", "ast", "cfg", "llvm", "obj"};
+const char *const EXTENSIONS[] = {"tokens", "ast", "cfg", "ll", "o"};
+
+// Compiles file up to stage into out, parsing it in jobs pieces at once,
+// reporting errors to errors and recording into stats and trace, if not
+// null. A worker that compiles to object code keeps a TargetMachine in
+// machine.
+bool emit(GlobalContext &global, const std::string &file, Stage stage,
+          codegen::OptLevel level, size_t jobs,
+          std::unique_ptr<llvm::TargetMachine> &machine, std::ostream &out,
+          std::ostream &errors, Stats *stats, Trace *trace) {
+  Trace::Span span(trace, "driver", file);
+  auto source = Source::load(file, errors);
+  if (!source) {
+    return false;
+  }
+  Context ctx(global, file, std::move(source));
+  ctx.set_stats(stats);
+  ctx.set_trace(trace);
+  auto failed = [&ctx, &file, &errors]() {
+    size_t count = 0;
+    ctx.each_error([&](const err::Error &error) {
+      errors << file << ": " << error << "\n";
+      ++count;
+    });
+    return count > 0;
+  };
+
+  if (stage == Stage::Tokens) {
+    lex::Lexer lexer(ctx);
+    Stats::Timer timer(stats, Stats::LEX);
+    Trace::Span lexing(trace, "frontend", "lex");
+    auto &tokens = lexer.reset();
+    lexing.end();
+    timer.stop();
+    if (stats != nullptr) {
+      stats->add_tokens(tokens.size());
+    }
+    for (auto &token : tokens) {
+      out << token.string(ctx.source()) << "\n";
+    }
+    return !failed();
+  }
+  // trees are written as far as they parsed.
+  Parser::parse(ctx, jobs);
+  if (stage == Stage::AST) {
+    ctx.each_expr([&out, &ctx](const ast::Expression &node) {
+      node.print(out, ctx.interner());
+      out << "\n";
+    });
+    return !failed();
+  } else if (stage == Stage::CFG) {
+    ctx.each_block([&out, &ctx](const cfg::BasicBlock &block) {
+      block.print(out, ctx.interner());
+      out << "\n";
+    });
+    return !failed();
+  } else if (failed()) {
+    return false;
+  }
+
+  llvm::LLVMContext llvm;
+  codegen::Codegen codegen(ctx, llvm, level);
+  codegen.generate();
+  if (failed()) {
+    return false;
+  }
+  auto module = codegen.release();
+  if (stage == Stage::LLVM) {
+    llvm::raw_os_ostream stream(out);
+    module->print(stream, nullptr);
+    return true;
+  }
+
+  std::unique_ptr<const err::Error> error;
+  if (machine == nullptr) {
+    machine = object::host(error, level);
+  }
+  llvm::SmallVector<char, 0> code;
+  if (machine != nullptr) {
+    Trace::Span compiling(trace, "codegen", "object");
+    error = object::compile(*module, *machine, code);
+  }
+  if (error != nullptr) {
+    errors << file << ": " << *error << "\n";
+    return false;
+  }
+  out.write(code.data(), code.size());
+  return true;
+}
+
+// Compiles every file up to stage on jobs threads, each with a
+// GlobalContext of its own; a single file is parsed in jobs pieces instead.
+// What a file compiles to goes to its base name with the extension of
+// stage, in the working directory, or to output if there is a single file,
+// where "-" is standard output; files whose outputs would have the same
+// name are turned away before any is compiled. Errors are printed in the
+// order of files. All files record into stats and trace, if not null.
+int emit(const std::vector<std::string> &files, Stage stage,
+         codegen::OptLevel level, size_t jobs, const std::string &output,
+         Stats *stats, Trace *trace) {
+  if (!output.empty() && files.size() > 1) {
+    std::cerr << "cannot write " << files.size() << " files to " << output
+              << "\n";
+    return 1;
+  }
+  std::vector<std::string> paths(files.size(), output);
+  std::unordered_map<std::string, size_t> written;
+  for (size_t i = 0; i < files.size() && output.empty(); ++i) {
+    llvm::SmallString<128> name(llvm::sys::path::filename(files[i]));
+    llvm::sys::path::replace_extension(name,
+                                       EXTENSIONS[static_cast<int>(stage)]);
+    paths[i] = name.str().str();
+    auto first = written.emplace(paths[i], i);
+    if (!first.second) {
+      std::cerr << files[first.first->second] << " and " << files[i]
+                << " would both be written to " << paths[i] << "\n";
+      return 1;
+    }
+  }
+
+  struct Worker {
+    GlobalContext global;
+    std::unique_ptr<llvm::TargetMachine> machine;
+  };
+  std::vector<std::unique_ptr<Worker>> workers;
+  for (size_t j = 0; j < std::max<size_t>(std::min(jobs, files.size()), 1);
+       ++j) {
+    workers.push_back(std::make_unique<Worker>());
+  }
+  std::vector<std::string> errors(files.size());
+  std::atomic<size_t> failures(0);
+  // a single file is parsed in pieces instead.
+  size_t pieces = files.size() == 1 ? jobs : 1;
+
+  parallel_for_workers(jobs, files.size(), [&](size_t j, size_t i) {
+    auto &worker = *workers[j];
+    std::ostringstream diagnostics;
+    bool ok;
+    if (output == "-") {
+      std::ostringstream out;
+      ok = emit(worker.global, files[i], stage, level, pieces, worker.machine,
+                out, diagnostics, stats, trace);
+      std::cout << out.str();
+    } else {
+      auto &path = paths[i];
+      std::ofstream out(path, std::ios::binary);
+      ok = emit(worker.global, files[i], stage, level, pieces, worker.machine,
+                out, diagnostics, stats, trace);
+      if (ok && !out.flush()) {
+        diagnostics << path << ": cannot write file\n";
+        ok = false;
+      }
+      if (!ok && stage >= Stage::LLVM) {
+        out.close();
+        llvm::sys::fs::remove(path);
+      }
+    }
+    errors[i] = diagnostics.str();
+    failures += !ok;
+  });
+
+  for (auto &error : errors) {
+    std::cerr << error;
+  }
+  return failures > 0 ? 1 : 0;
+}
+
+} // namespace compiler
+} // namespace lang
+
+int main(int argc, char *argv[]) {
+  using namespace lang::compiler;
+
+  try {
+    cxxopts::Options options(argv[0]);
+    options.positional_help("FILE [ARG...]");
+
+    // clang-format off
+    options.add_options()
+      ("h,help", "Show this message")
+      ("O,opt", "Optimization level (0-3)",
+       cxxopts::value<int>()->default_value("0"))
+      ("r,run", "Run a fn (main by default) in-process with the integer "
+       "ARGs and print its result",
+       cxxopts::value<std::string>()->implicit_value("main"))
+      ("lazy", "With --run, generate each fn on its first call")
+      ("interpret", "With --run, interpret bytecode instead of using LLVM")
+      ("tiered", "With --run, interpret bytecode and compile hot fns in the "
+       "background, at -O2 unless told otherwise")
+      ("hot", "With --tiered, calls and loop iterations that make a fn hot",
+       cxxopts::value<uint64_t>()->default_value(
+           std::to_string(jit::Tiered::HOT)))
+      ("c,compile", "Write an object file (FILE.o unless -o is given)")
+      ("e,executable", "Link an executable (a.out unless -o is given) that "
+       "runs a fn (main by default) with its integer arguments and prints "
+       "its result",
+       cxxopts::value<std::string>()->implicit_value("main"))
+      ("o,output", "Output file", cxxopts::value<std::string>())
+      ("j,jobs", "Compile N files, or with a single file N pieces of its "
+       "module, at once", cxxopts::value<size_t>()->default_value("1"))
+      ("emit", "Compile every FILE and ARG to tokens, ast, cfg, llvm or obj, "
+       "written to the file's name with the matching extension "
+       "(or -o, - for standard output)", cxxopts::value<std::string>())
+      ("cache", "With -c, --executable, --lazy or --tiered, reuse the code "
+       "of unchanged fns from a directory (the user cache by default)",
+       cxxopts::value<std::string>()->implicit_value(
+           cache::Cache::default_dir()))
+      ("cache-size", "Megabytes the cache may take",
+       cxxopts::value<uint64_t>()->default_value(
+           std::to_string(cache::Cache::CAPACITY >> 20)))
+      ("watch", "Compile again whenever FILE changes, reusing the work "
+       "done for unchanged fns, and report how long it took")
+      ("server", "Serve compile requests on a Unix socket (in the user "
+       "runtime directory by default) with N (-j, all cores by default) "
+       "threads",
+       cxxopts::value<std::string>()->implicit_value(
+           server::default_path()))
+      ("connect", "Have the server on a socket compile FILE, printing its "
+       "IR or, with -c, writing its object file",
+       cxxopts::value<std::string>()->implicit_value(
+           server::default_path()))
+      ("time-phases", "Print the time spent in each phase of the compile "
+       "to standard error")
+      ("stats", "Print phase times, counts of what each phase produced and "
+       "the slowest fns to standard error, as a table or as json",
+       cxxopts::value<std::string>()->implicit_value("table"))
+      ("memory", "With --stats or --time-phases, also count heap allocations "
+       "and bytes per phase, and the peak bytes live in the whole process "
+       "while each phase ran")
+      ("trace", "Write when each phase, fn and LLVM pass ran on each thread "
+       "to a Chrome trace file (trace.json by default)",
+       cxxopts::value<std::string>()->implicit_value("trace.json"))
+      ("file", "Source file", cxxopts::value<std::string>())
+      ("args", "Arguments", cxxopts::value<std::vector<std::string>>());
+    // clang-format on
+
+    options.parse_positional({"file", "args"});
+
+    auto result = options.parse(argc, argv);
+
+    if (result.count("help") ||
+        (!result.count("file") && !result.count("server"))) {
+      std::cout << options.help() << std::endl;
+      exit(result.count("help") ? 0 : 1);
+    }
+    if (result.count("server")) {
+      auto jobs = result.count("jobs") ? result["jobs"].as<size_t>()
+                                       : std::thread::hardware_concurrency();
+      return serve(result["server"].as<std::string>(), jobs);
+    }
+
+    auto opt = result["opt"].as<int>();
+    if (opt < 0 || opt > 3) {
+      std::cerr << "invalid optimization level " << opt << "\n";
+      exit(1);
+    }
+
+    std::unique_ptr<Stats> stats;
+    std::string format = "phases";
+    if (result.count("stats")) {
+      format = result["stats"].as<std::string>();
+      if (format != "table" && format != "json") {
+        std::cerr << "invalid --stats " << format << "\n";
+        exit(1);
+      }
+    }
+    if (result.count("stats") || result.count("time-phases")) {
+      stats = std::make_unique<Stats>();
+      if (result.count("memory")) {
+        Stats::count_allocations();
+      }
+    }
+    std::unique_ptr<Trace> trace;
+    if (result.count("trace")) {
+      trace = std::make_unique<Trace>();
+    }
+    // prints stats and writes the trace once the compile returns code.
+    auto report = [&](int code) {
+      if (stats != nullptr && format == "json") {
+        stats->print_json(std::cerr);
+      } else if (stats != nullptr) {
+        stats->print(std::cerr, format == "phases");
+      }
+      if (trace != nullptr) {
+        auto path = result["trace"].as<std::string>();
+        std::ofstream out(path);
+        trace->write(out);
+        if (!out.flush()) {
+          std::cerr << path << ": cannot write file\n";
+          return 1;
+        }
+      }
+      return code;
+    };
+
+    std::vector<std::string> inputs{result["file"].as<std::string>()};
+    if (result.count("args")) {
+      auto args = result["args"].as<std::vector<std::string>>();
+      inputs.insert(inputs.end(), args.begin(), args.end());
+    }
+    if (result.count("emit")) {
+      auto name = result["emit"].as<std::string>();
+      size_t stage = 0;
+      while (stage < std::size(STAGES) && name != STAGES[stage]) {
+        ++stage;
+      }
+      if (stage == std::size(STAGES)) {
+        std::cerr << "invalid --emit " << name << "\n";
+        exit(1);
+      }
+      return report(emit(
+          inputs, static_cast<Stage>(stage),
+          static_cast<codegen::OptLevel>(opt), result["jobs"].as<size_t>(),
+          result.count("output") ? result["output"].as<std::string>() : "",
+          stats.get(), trace.get()));
+    }
+
+    std::vector<int64_t> args;
+    for (size_t i = 1; i < inputs.size(); ++i) {
+      char *end = nullptr;
+      errno = 0;
+      args.push_back(std::strtoll(inputs[i].c_str(), &end, 10));
+      if (errno != 0 || end == inputs[i].c_str() || *end != '\0') {
+        std::cerr << "invalid argument " << inputs[i] << "\n";
+        exit(1);
+      }
+    }
+    std::string run;
+    if (result.count("run")) {
+      run = result["run"].as<std::string>();
+    }
+
+    auto mode = Mode::JIT;
+    if (result.count("tiered")) {
+      mode = Mode::Tiered;
+      // only hot fns get compiled, so they are worth optimizing.
+      opt = result.count("opt") ? opt : 2;
+    } else if (result.count("interpret")) {
+      mode = Mode::Interpret;
+    } else if (result.count("lazy")) {
+      mode = Mode::Lazy;
+    }
+
+    auto &file = inputs[0];
+    std::string entry;
+    Output output{"", nullptr, result["jobs"].as<size_t>()};
+    if (result.count("executable")) {
+      entry = result["executable"].as<std::string>();
+      output.path = "a.out";
+      output.entry = &entry;
+    } else if (result.count("compile")) {
+      llvm::SmallString<128> path(llvm::sys::path::filename(file));
+      llvm::sys::path::replace_extension(path, "o");
+      output.path = path.str().str();
+    }
+    if (result.count("output")) {
+      output.path = result["output"].as<std::string>();
+    }
+
+    std::unique_ptr<cache::Cache> cache;
+    if (result.count("cache")) {
+      std::unique_ptr<const err::Error> error;
+      cache = cache::Cache::open(error, result["cache"].as<std::string>(),
+                                 result["cache-size"].as<uint64_t>() << 20);
+      if (cache == nullptr) {
+        std::cerr << *error << "\n";
+        exit(1);
+      }
+    }
+
+    if (result.count("connect")) {
+      return remote(result["connect"].as<std::string>(), file,
+                    static_cast<codegen::OptLevel>(opt), output);
+    }
+    if (result.count("watch")) {
+      return watch(file, static_cast<codegen::OptLevel>(opt),
+                   result.count("run") ? &run : nullptr, args, output);
+    }
+    return report(compile(file, static_cast<codegen::OptLevel>(opt), mode,
+                          result["hot"].as<uint64_t>(),
+                          result.count("run") ? &run : nullptr, args, output,
+                          cache.get(), stats.get(), trace.get()));
+  } catch (const cxxopts::OptionException &e) {
+    std::cerr << "error parsing options: " << e.what() << std::endl;
+    exit(1);
+  }
 }
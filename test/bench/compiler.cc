@@ -0,0 +1,223 @@
+#include "compiler/codegen.h"
+#include "compiler/generator.h"
+#include "compiler/parser.h"
+#include "compiler/stats.h"
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+namespace lang {
+namespace compiler {
+
+// Each input is compiled again until this much time has passed.
+const uint64_t MIN_TIME = 1000000000;
+
+struct Input {
+  std::string name;
+  std::string text;
+  size_t lines;
+};
+
+// A generated program of about lines lines, of the default shape.
+std::string synthesize(size_t lines) {
+  gen::Shape shape;
+  shape.lines = lines;
+  std::ostringstream out;
+  gen::generate(shape, out);
+  return out.str();
+}
+
+Input input(const std::string &name, std::string text) {
+  size_t lines = 0;
+  for (auto c : text) {
+    lines += c == '\n';
+  }
+  return Input{name, std::move(text), std::max<size_t>(lines, 1)};
+}
+
+// What compiling an input iterations times recorded, and the time it took
+// in all, and in parsing.
+struct Result {
+  size_t iterations = 0;
+  Stats stats;
+  uint64_t wall = 0;
+  // lexing, parsing and building the cfg of each unit as a whole.
+  uint64_t frontend = 0;
+};
+
+// Compiles input to a module at level, parsing it in jobs pieces, until
+// MIN_TIME has passed, and returns false if it does not compile.
+bool run(const Input &input, codegen::OptLevel level, size_t jobs,
+         Result &result) {
+  while (result.wall < MIN_TIME) {
+    auto start = Stats::now().wall;
+    GlobalContext global;
+    Context ctx(global, input.name,
+                Source::borrow(input.text.data(), input.text.size()));
+    ctx.set_stats(&result.stats);
+    auto parse = Stats::now().wall;
+    Parser::parse(ctx, jobs);
+    result.frontend += Stats::now().wall - parse;
+    llvm::LLVMContext llvm;
+    codegen::Codegen codegen(ctx, llvm, level);
+    codegen.generate();
+    result.wall += Stats::now().wall - start;
+    ++result.iterations;
+
+    size_t errors = 0;
+    ctx.each_error([&errors, &input](const err::Error &error) {
+      std::cerr << input.name << ": " << error << "\n";
+      ++errors;
+    });
+    if (errors > 0) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// One row of the report: a phase, or the whole pipeline.
+struct Row {
+  std::string name;
+  uint64_t wall;
+  uint64_t allocations;
+};
+
+// Every row is elapsed time. With more than one job, pieces are lexed,
+// parsed and turned into a cfg at once, so those phases overlap; they are
+// reported together as the frontend instead, as timed for whole units.
+std::vector<Row> rows(const Result &result, codegen::OptLevel level,
+                      size_t jobs) {
+  std::vector<Row> rows;
+  uint64_t allocations = 0;
+  for (int i = 0; i < Stats::PHASES; ++i) {
+    auto phase = static_cast<Stats::Phase>(i);
+    allocations += result.stats.allocations(phase);
+    if (jobs > 1 && phase <= Stats::CFG) {
+      if (phase == Stats::CFG) {
+        rows.push_back(Row{"frontend", result.frontend, allocations});
+      }
+    } else if (phase != Stats::OPTIMIZE || level != codegen::OptLevel::O0) {
+      rows.push_back(Row{Stats::name(phase), result.stats.time(phase).wall,
+                         result.stats.allocations(phase)});
+    }
+  }
+  rows.push_back(Row{"pipeline", result.wall, allocations});
+  return rows;
+}
+
+void report(std::ostream &out, bool json, codegen::OptLevel level,
+            size_t jobs, const std::vector<Input> &inputs,
+            const std::vector<Result> &results) {
+  if (!json) {
+    out << std::left << std::setw(10) << "input" << std::setw(10) << "phase"
+        << std::right << std::setw(12) << "ms" << std::setw(14) << "lines/s"
+        << std::setw(14) << "tokens/s" << std::setw(10) << "ns/node"
+        << std::setw(12) << "allocs/line"
+        << "\n";
+  } else {
+    out << "{\"opt\":" << static_cast<int>(level) << ",\"jobs\":" << jobs
+        << ",\"inputs\":[";
+  }
+  out << std::fixed << std::setprecision(1);
+  for (size_t i = 0; i < inputs.size(); ++i) {
+    auto &input = inputs[i];
+    auto &result = results[i];
+    double n = result.iterations;
+    if (json) {
+      out << (i > 0 ? "," : "") << "\n{\"name\":\"" << input.name
+          << "\",\"lines\":" << input.lines
+          << ",\"bytes\":" << input.text.size()
+          << ",\"iterations\":" << result.iterations << ",\"phases\":{";
+    }
+    const char *separator = "";
+    for (auto &row : rows(result, level, jobs)) {
+      double seconds = row.wall / 1e9;
+      double ms = row.wall / 1e6 / n;
+      double lines = input.lines * n / seconds;
+      double tokens = result.stats.tokens() / seconds;
+      double per_node = row.wall / double(result.stats.nodes());
+      double allocations = row.allocations / (input.lines * n);
+      if (json) {
+        out << separator << "\"" << row.name << "\":{\"ms\":" << ms
+            << ",\"lines_per_s\":" << lines << ",\"tokens_per_s\":" << tokens
+            << ",\"ns_per_node\":" << per_node << std::setprecision(3)
+            << ",\"allocs_per_line\":" << allocations << "}"
+            << std::setprecision(1);
+        separator = ",";
+      } else {
+        out << std::left << std::setw(10) << input.name << std::setw(10)
+            << row.name << std::right << std::setw(12) << ms << std::setw(14)
+            << lines << std::setw(14) << tokens << std::setw(10) << per_node
+            << std::setw(12) << std::setprecision(3) << allocations
+            << std::setprecision(1) << "\n";
+      }
+    }
+    if (json) {
+      out << "}}";
+    }
+  }
+  if (json) {
+    out << "\n]}\n";
+  }
+}
+
+} // namespace compiler
+} // namespace lang
+
+// Usage: bench-compiler [--json] [-O0|-O1|-O2|-O3] [-jN] [FILE...]
+//
+// Compiles each FILE, or synthesized small, medium and huge programs,
+// through every phase and reports the throughput of each. -jN parses in N
+// pieces at once, and reports lexing, parsing and the cfg as one frontend
+// phase.
+int main(int argc, char *argv[]) {
+  using namespace lang::compiler;
+
+  bool json = false;
+  auto level = codegen::OptLevel::O0;
+  size_t jobs = 1;
+  std::vector<Input> inputs;
+  for (int i = 1; i < argc; ++i) {
+    if (std::strcmp(argv[i], "--json") == 0) {
+      json = true;
+    } else if (std::strlen(argv[i]) == 3 && argv[i][0] == '-' &&
+               argv[i][1] == 'O' && argv[i][2] >= '0' && argv[i][2] <= '3') {
+      level = static_cast<codegen::OptLevel>(argv[i][2] - '0');
+    } else if (std::strncmp(argv[i], "-j", 2) == 0) {
+      char *end = nullptr;
+      jobs = std::strtoul(argv[i] + 2, &end, 10);
+      if (jobs == 0 || *end != '\0') {
+        std::cerr << "invalid " << argv[i] << "\n";
+        return 1;
+      }
+    } else {
+      std::ifstream in(argv[i]);
+      if (!in) {
+        std::cerr << argv[i] << ": cannot read file\n";
+        return 1;
+      }
+      std::stringstream buf;
+      buf << in.rdbuf();
+      inputs.push_back(input(argv[i], buf.str()));
+    }
+  }
+  if (inputs.empty()) {
+    inputs.push_back(input("small", synthesize(1000)));
+    inputs.push_back(input("medium", synthesize(20000)));
+    inputs.push_back(input("huge", synthesize(200000)));
+  }
+
+  Stats::count_allocations();
+  std::vector<Result> results(inputs.size());
+  for (size_t i = 0; i < inputs.size(); ++i) {
+    if (!run(inputs[i], level, jobs, results[i])) {
+      return 1;
+    }
+  }
+  report(std::cout, json, level, jobs, inputs, results);
+  return 0;
+}
@@ -0,0 +1,116 @@
+#include "compiler/lexer.h"
+#include "compiler/scan.h"
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+namespace lang {
+namespace compiler {
+
+// Repeats a small program with unique function names until the buffer holds
+// at least `size` bytes.
+std::string synthesize(size_t size) {
+  std::stringstream buf;
+  for (size_t i = 0; static_cast<size_t>(buf.tellp()) < size; ++i) {
+    buf << "fn compute_" << i << "(alpha, beta, gamma) = {\n"
+        << "  val delta = 1024 * gamma + beta\n"
+        << "  if delta {\n"
+        << "    (alpha + 65536)\n"
+        << "  } elif alpha {\n"
+        << "    (alpha - 10 * beta)\n"
+        << "  } else {\n"
+        << "    (alpha * 10)\n"
+        << "  }\n"
+        << "}\n\n";
+  }
+  return buf.str();
+}
+
+typedef const char *(*Skip)(const char *, const char *);
+
+// Walks the buffer the way Lexer::lex does, but only classifies runs.
+size_t walk(const std::string &text, Skip whitespace, Skip identifier,
+            Skip digits) {
+  size_t runs = 0;
+  const char *p = text.data(), *end = p + text.size();
+  while (p != end) {
+    unsigned char cc = *p;
+    if (cc == ' ' || cc == '\t' || cc == '\r') {
+      p = whitespace(p, end);
+    } else if ((cc >= 'A' && cc <= 'Z') || (cc >= 'a' && cc <= 'z') ||
+               cc == '_') {
+      p = identifier(p, end);
+    } else if (cc >= '0' && cc <= '9') {
+      p = digits(p, end);
+    } else {
+      ++p;
+    }
+    ++runs;
+  }
+  return runs;
+}
+
+size_t lex_all(const std::string &text) {
+  GlobalContext gctx;
+  Context ctx(gctx, "bench", Source::borrow(text.data(), text.size()));
+  lex::Lexer lexer(ctx);
+
+  return lexer.reset().size();
+}
+
+template <typename Fn>
+void measure(const std::string &label, const std::string &text, int iterations,
+             Fn fn) {
+  size_t count = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < iterations; ++i) {
+    count += fn(text);
+  }
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+
+  double mb = static_cast<double>(text.size()) * iterations / (1 << 20);
+  std::cout << std::left << std::setw(16) << label << std::right
+            << std::setw(10) << std::fixed << std::setprecision(1)
+            << mb / elapsed.count() << " MB/s  (" << count / iterations
+            << ")\n";
+}
+
+} // namespace compiler
+} // namespace lang
+
+int main(int argc, char *argv[]) {
+  using namespace lang::compiler;
+
+  std::string text;
+  if (argc > 1) {
+    for (int i = 1; i < argc; ++i) {
+      std::ifstream in(argv[i]);
+      std::stringstream buf;
+      buf << in.rdbuf();
+      text += buf.str();
+    }
+  } else {
+    text = synthesize(16 << 20);
+  }
+
+  const int iterations = 5;
+  std::cout << "input: " << text.size() / (1 << 20) << " MB, "
+            << iterations << " iterations\n";
+
+  measure("scan scalar", text, iterations, [](const std::string &text) {
+    return walk(text, lex::scan::scalar::skip_whitespace,
+                lex::scan::scalar::skip_identifier,
+                lex::scan::scalar::skip_digits);
+  });
+  measure(std::string("scan ") + lex::scan::isa(), text, iterations,
+          [](const std::string &text) {
+            return walk(text, lex::scan::skip_whitespace,
+                        lex::scan::skip_identifier, lex::scan::skip_digits);
+          });
+  measure("lexer", text, iterations, lex_all);
+
+  return 0;
+}
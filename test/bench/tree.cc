@@ -0,0 +1,205 @@
+#include "compiler/generator.h"
+#include "compiler/parser.h"
+#include "compiler/tree.h"
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+namespace lang {
+namespace compiler {
+
+// What a pass over every node of a unit finds: the nodes of each kind and
+// the sum of the integer literals, so neither walk can be optimized away.
+struct Census {
+  static const size_t KINDS = static_cast<size_t>(ast::Kind::Value) + 1;
+  size_t kinds[KINDS] = {};
+  int64_t integers = 0;
+
+  bool operator==(const Census &other) const {
+    return std::equal(kinds, kinds + KINDS, other.kinds) &&
+           integers == other.integers;
+  }
+};
+
+// Census of the arena AST, by visiting each node from its parent.
+class Walker : public ast::Visitor<Walker> {
+  void list(const ast::Expressions &nodes) {
+    for (auto node : nodes) {
+      dispatch(*node);
+    }
+  }
+
+public:
+  Census census;
+
+  void count(const ast::Expression &node) {
+    ++census.kinds[static_cast<int>(node.kind())];
+  }
+
+  void visit(const ast::Assignment &node) {
+    count(node);
+    dispatch(node.left());
+    dispatch(node.right());
+  }
+  void visit(const ast::BinaryExpression &node) {
+    count(node);
+    dispatch(node.left());
+    dispatch(node.right());
+  }
+  void visit(const ast::Call &node) {
+    count(node);
+    list(node.args());
+  }
+  void visit(const ast::Function &node) {
+    count(node);
+    dispatch(node.proto());
+    list(node.body());
+  }
+  void visit(const ast::If &node) {
+    count(node);
+    dispatch(node.cond());
+    list(node.thn());
+    list(node.els());
+  }
+  void visit(const ast::Identifier &node) { count(node); }
+  void visit(const ast::Integer &node) {
+    count(node);
+    census.integers += node.value();
+  }
+  void visit(const ast::Parameter &node) { count(node); }
+  void visit(const ast::Prototype &node) {
+    count(node);
+    for (auto param : node.params()) {
+      dispatch(*param);
+    }
+  }
+  void visit(const ast::TupleAssignment &node) {
+    count(node);
+    list(node.left());
+    list(node.right());
+  }
+  void visit(const ast::Value &node) {
+    count(node);
+    if (node.has_value()) {
+      dispatch(node.value());
+    }
+  }
+};
+
+Census walk(Context &ctx) {
+  Walker walker;
+  ctx.each_expr([&walker](const ast::Expression &node) {
+    walker.dispatch(node);
+  });
+  return walker.census;
+}
+
+// Census of the Tree, as one scan of its arrays.
+Census scan(const ast::Tree &tree) {
+  Census census;
+  for (uint32_t i = 0; i < tree.size(); ++i) {
+    ast::Node node(i);
+    auto kind = tree.kind(node);
+    ++census.kinds[static_cast<int>(kind)];
+    if (kind == ast::Kind::Integer) {
+      census.integers += tree.integer(node);
+    }
+  }
+  return census;
+}
+
+// Runs fn until a second has passed and returns the ms of each run.
+template <typename Fn> double measure(Fn fn) {
+  size_t runs = 0;
+  std::chrono::duration<double, std::milli> elapsed(0);
+  while (elapsed.count() < 1000) {
+    auto start = std::chrono::steady_clock::now();
+    fn();
+    elapsed += std::chrono::steady_clock::now() - start;
+    ++runs;
+  }
+  return elapsed.count() / runs;
+}
+
+bool run(std::ostream &out, const std::string &name, const std::string &text) {
+  GlobalContext global;
+  Context ctx(global, name, Source::borrow(text.data(), text.size()));
+  Parser::parse(ctx, 1);
+  size_t errors = 0;
+  ctx.each_error([&errors, &name](const err::Error &error) {
+    std::cerr << name << ": " << error << "\n";
+    ++errors;
+  });
+  if (errors > 0) {
+    return false;
+  }
+
+  auto tree = ast::lower(ctx);
+  tree.shrink_to_fit();
+  Census walked, scanned;
+  auto pointers = measure([&]() { walked = walk(ctx); });
+  auto arrays = measure([&]() { scanned = scan(tree); });
+  if (!(walked == scanned)) {
+    std::cerr << name << ": walk and scan disagree\n";
+    return false;
+  }
+
+  out << std::left << std::setw(10) << name << std::right << std::setw(10)
+      << tree.size() << std::setw(10) << ctx.arena().bytes() / 1e6
+      << std::setw(10) << tree.bytes() / 1e6 << std::setw(10) << pointers
+      << std::setw(10) << arrays << std::setw(10)
+      << pointers * 1e6 / tree.size() << std::setw(10)
+      << arrays * 1e6 / tree.size() << "\n";
+  return true;
+}
+
+} // namespace compiler
+} // namespace lang
+
+// Usage: bench-tree [FILE...]
+//
+// Parses each FILE, or synthesized small, medium and huge programs, and
+// reports the memory of the arena AST and of its ast::Tree, and how long a
+// pass over every node takes on each.
+int main(int argc, char *argv[]) {
+  using namespace lang::compiler;
+
+  std::vector<std::pair<std::string, std::string>> inputs;
+  for (int i = 1; i < argc; ++i) {
+    std::ifstream in(argv[i]);
+    if (!in) {
+      std::cerr << argv[i] << ": cannot read file\n";
+      return 1;
+    }
+    std::stringstream buf;
+    buf << in.rdbuf();
+    inputs.emplace_back(argv[i], buf.str());
+  }
+  if (inputs.empty()) {
+    for (auto lines : {1000, 20000, 200000}) {
+      gen::Shape shape;
+      shape.lines = lines;
+      std::ostringstream out;
+      gen::generate(shape, out);
+      auto name = lines == 1000 ? "small" : lines == 20000 ? "medium" : "huge";
+      inputs.emplace_back(name, out.str());
+    }
+  }
+
+  std::cout << std::left << std::setw(10) << "input" << std::right
+            << std::setw(10) << "nodes" << std::setw(10) << "ast MB"
+            << std::setw(10) << "tree MB" << std::setw(10) << "walk ms"
+            << std::setw(10) << "scan ms" << std::setw(10) << "walk ns"
+            << std::setw(10) << "scan ns"
+            << "\n"
+            << std::fixed << std::setprecision(2);
+  for (auto &input : inputs) {
+    if (!run(std::cout, input.first, input.second)) {
+      return 1;
+    }
+  }
+  return 0;
+}
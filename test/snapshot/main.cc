@@ -21,24 +21,31 @@ public:
   LoggingLexer(Context &ctx) : lexer_{lex::Lexer(ctx)}, eof_(false) {}
   ~LoggingLexer() { finish(); }
 
-  std::unique_ptr<lex::Token> lex() override {
-    auto token = lexer_.lex();
-    print(*token);
-    return token;
+  size_t lex() override {
+    auto index = lexer_.lex();
+    print(lexer_.tokens()[index]);
+    return index;
   }
 
-  std::vector<std::unique_ptr<lex::Token>> reset() override {
-    auto tokens = lexer_.reset();
-    for (auto it = tokens.begin(); it != tokens.end(); ++it) {
-      print(**it);
+  const std::vector<lex::Token> &reset() override {
+    auto first = lexer_.tokens().size();
+    auto &tokens = lexer_.reset();
+    for (auto it = tokens.begin() + first; it != tokens.end(); ++it) {
+      print(*it);
     }
     return tokens;
   }
 
+  const std::vector<lex::Token> &tokens() const override {
+    return lexer_.tokens();
+  }
+
+  const Source &source() const override { return lexer_.source(); }
+
   const std::stringstream &finish() {
-    auto token = this->lex();
-    while (!token->invalid() && !token->eof()) {
-      token = this->lex();
+    auto token = tokens()[this->lex()];
+    while (!token.invalid() && !token.eof()) {
+      token = tokens()[this->lex()];
     }
     return outbuf_;
   }
@@ -49,7 +56,7 @@ public:
     if (token.eof())
       eof_ = true;
 
-    outbuf_ << token.string() << "\n";
+    outbuf_ << token.string(source()) << "\n";
   }
 };
 
@@ -91,10 +98,13 @@ void run_snapshots(const std::string &dir, const bool write_output = false) {
     }
 
     auto testname = fs::relative(entry.path(), fs::path(dir));
-    std::fstream in(entry.path().string(), std::ios::in);
+    auto source = Source::load(entry.path().string(), std::cerr);
+    if (!source) {
+      continue;
+    }
 
     GlobalContext gctx;
-    Context ctx(gctx, entry.path().string(), in);
+    Context ctx(gctx, entry.path().string(), std::move(source));
 
     {
       LoggingLexer lexer(ctx);
@@ -109,8 +119,9 @@ void run_snapshots(const std::string &dir, const bool write_output = false) {
 
     {
       std::stringstream parsebuf;
-      ctx.each_expr([&parsebuf](const ast::Expression &node) -> void {
-        parsebuf << node << "\n";
+      ctx.each_expr([&parsebuf, &ctx](const ast::Expression &node) -> void {
+        node.print(parsebuf, ctx.interner());
+        parsebuf << "\n";
       });
       parsebuf.flush();
 
@@ -121,8 +132,9 @@ void run_snapshots(const std::string &dir, const bool write_output = false) {
 
     {
       std::stringstream cfgbuf;
-      ctx.each_block([&cfgbuf](const cfg::BasicBlock &block) -> void {
-        cfgbuf << block << "\n";
+      ctx.each_block([&cfgbuf, &ctx](const cfg::BasicBlock &block) -> void {
+        block.print(cfgbuf, ctx.interner());
+        cfgbuf << "\n";
       });
       cfgbuf.flush();
 
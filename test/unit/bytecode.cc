@@ -0,0 +1,183 @@
+#include "compiler/bytecode.h"
+#include "compiler/interpreter.h"
+#include "compiler/jit.h"
+#include "compiler/parser.h"
+#include "doctest.h"
+#include "test/unit/helpers.h"
+#include <limits>
+#include <string>
+#include <vector>
+
+namespace lang {
+namespace compiler {
+namespace bytecode {
+
+TEST_CASE("interpreter agrees with the jit") {
+  std::string text = "fn fact(n) = {\n"
+                     "  if n {\n"
+                     "    1\n"
+                     "  } else {\n"
+                     "    n * fact(n - 1)\n"
+                     "  }\n"
+                     "}\n"
+                     "fn pick(a, b, c) = {\n"
+                     "  val d = 10 * c + b\n"
+                     "  if d {\n"
+                     "    (a + d)\n"
+                     "  } elif a {\n"
+                     "    val e = a - 10\n"
+                     "    e * (b + c) * 4 / 2\n"
+                     "  } else {\n"
+                     "    fact(b) - pick(1, a, c)\n"
+                     "  }\n"
+                     "}\n"
+                     "fn main(x, y) = pick(x, y, fact(3)) + x * (y - 7)\n";
+  GlobalContext gctx;
+  Context ctx(gctx, "agree", Source::borrow(text.data(), text.size()));
+  Parser::parse(ctx, 1);
+
+  Program program(ctx);
+  REQUIRE(count_errors(ctx) == 0);
+  Interpreter interpreter(program, ctx.interner());
+
+  std::unique_ptr<const err::Error> error;
+  auto jit = jit::JIT::create(error, codegen::OptLevel::O0);
+  REQUIRE(jit != nullptr);
+  REQUIRE(jit->add(codegen::generate_shard(ctx)) == nullptr);
+
+  auto main = ctx.interner().intern("main");
+  for (int64_t x = -3; x <= 12; ++x) {
+    for (int64_t y = 1; y <= 6; ++y) {
+      int64_t interpreted = 0, compiled = 0;
+      REQUIRE(interpreter.run(main, {x, y}, interpreted) == nullptr);
+      REQUIRE(jit->run("main", {x, y}, compiled) == nullptr);
+      CHECK(interpreted == compiled);
+    }
+  }
+}
+
+TEST_CASE("interpreter divides like the jit") {
+  std::string text = "fn div(a, b) = a / b\n"
+                     "fn mix(a, b) = (a - 7) / b + a / (b - 3) * 2\n";
+  GlobalContext gctx;
+  Context ctx(gctx, "divide", Source::borrow(text.data(), text.size()));
+  Parser::parse(ctx, 1);
+
+  Program program(ctx);
+  REQUIRE(count_errors(ctx) == 0);
+  Interpreter interpreter(program, ctx.interner());
+
+  const int64_t min = std::numeric_limits<int64_t>::min();
+  const int64_t max = std::numeric_limits<int64_t>::max();
+  const std::vector<int64_t> values = {min, min + 1, -9, -3, -2, -1, 0,
+                                       1,   2,       3,  7,  9,  max};
+  for (auto level : {codegen::OptLevel::O0, codegen::OptLevel::O2}) {
+    std::unique_ptr<const err::Error> error;
+    auto jit = jit::JIT::create(error, level);
+    REQUIRE(jit != nullptr);
+    REQUIRE(jit->add(codegen::generate_shard(ctx, level)) == nullptr);
+
+    for (auto fn : {"div", "mix"}) {
+      auto name = ctx.interner().intern(fn);
+      for (auto a : values) {
+        for (auto b : values) {
+          int64_t interpreted = 0, compiled = 0;
+          REQUIRE(interpreter.run(name, {a, b}, interpreted) == nullptr);
+          REQUIRE(jit->run(fn, {a, b}, compiled) == nullptr);
+          CHECK(interpreted == compiled);
+        }
+      }
+    }
+  }
+
+  auto div = ctx.interner().intern("div");
+  int64_t result = 0;
+  REQUIRE(interpreter.run(div, {-3, 2}, result) == nullptr);
+  CHECK(result == -1);
+  REQUIRE(interpreter.run(div, {7, -2}, result) == nullptr);
+  CHECK(result == -3);
+  REQUIRE(interpreter.run(div, {5, 0}, result) == nullptr);
+  CHECK(result == 0);
+  REQUIRE(interpreter.run(div, {min, -1}, result) == nullptr);
+  CHECK(result == min);
+}
+
+TEST_CASE("interpreter reports errors instead of crashing") {
+  std::string text = "fn forever(n) = forever(n + 1) * 2\n"
+                     "fn half(n, d) = n / d\n"
+                     "fn broken(x) = nope(x) + 1\n"
+                     "fn calls(x) = broken(x) + 1\n";
+  GlobalContext gctx;
+  Context ctx(gctx, "errors", Source::borrow(text.data(), text.size()));
+  Parser::parse(ctx, 1);
+
+  Program program(ctx);
+  CHECK(count_errors(ctx) == 1); // nope is undefined
+  Interpreter interpreter(program, ctx.interner(), 1024);
+
+  auto &names = ctx.interner();
+  int64_t result = 0;
+  CHECK(interpreter.run(names.intern("half"), {-9, 2}, result) == nullptr);
+  CHECK(result == -4);
+  CHECK(interpreter.run(names.intern("half"), {1, 0}, result) == nullptr);
+  CHECK(result == 0);
+  CHECK(interpreter.run(names.intern("forever"), {1}, result) != nullptr);
+  CHECK(interpreter.run(names.intern("calls"), {1}, result) != nullptr);
+  CHECK(interpreter.run(names.intern("half"), {1}, result) != nullptr);
+  CHECK(interpreter.run(names.intern("missing"), {}, result) != nullptr);
+}
+
+TEST_CASE("names bound in a branch end with it") {
+  std::string text = "fn f(x) = {\n"
+                     "  if x {\n"
+                     "    val y = 2 * 1\n"
+                     "    y * 1\n"
+                     "  } else {\n"
+                     "    3 * 1\n"
+                     "  }\n"
+                     "  y * 1\n"
+                     "}\n";
+  GlobalContext gctx;
+  Context ctx(gctx, "leak", Source::borrow(text.data(), text.size()));
+  Parser::parse(ctx, 1);
+
+  Program program(ctx);
+  CHECK(count_errors(ctx) == 1);
+  Interpreter interpreter(program, ctx.interner());
+  int64_t result = 0;
+  CHECK(interpreter.run(ctx.interner().intern("f"), {1}, result) != nullptr);
+
+  Context generated(gctx, "leak", Source::borrow(text.data(), text.size()));
+  Parser::parse(generated, 1);
+  codegen::Codegen codegen(generated);
+  codegen.generate();
+  CHECK(count_errors(generated) == 1);
+  CHECK(codegen.module().getFunction("f") == nullptr);
+
+  std::unique_ptr<const err::Error> error;
+  auto jit = jit::JIT::create(error, codegen::OptLevel::O0);
+  REQUIRE(jit != nullptr);
+  CHECK(jit->add_lazy(ctx) == nullptr);
+  CHECK(jit->run("f", {1}, result) != nullptr);
+}
+
+TEST_CASE("bytecode computes arguments in place") {
+  std::string text = "fn add(a, b) = a + b\n"
+                     "fn f(x) = add(x * 2, x + 1)\n";
+  GlobalContext gctx;
+  Context ctx(gctx, "regs", Source::borrow(text.data(), text.size()));
+  Parser::parse(ctx, 1);
+
+  Program program(ctx);
+  auto f = program.lookup(ctx.interner().intern("f"));
+  REQUIRE(f != nullptr);
+  // x, then both arguments and the result reusing the first of them.
+  CHECK(f->registers == 3);
+  for (auto &ins : f->code) {
+    CHECK(ins.op != Op::Move);
+  }
+}
+
+} // namespace bytecode
+} // namespace compiler
+} // namespace lang
@@ -0,0 +1,142 @@
+#include "compiler/cache.h"
+#include "compiler/jit.h"
+#include "compiler/parser.h"
+#include "doctest.h"
+#include <string>
+#include <thread>
+
+#include <llvm/ADT/SmallString.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/Path.h>
+
+namespace lang {
+namespace compiler {
+namespace cache {
+
+// The keys of the fns of text, by name.
+static std::unordered_map<std::string, std::string>
+keys(const std::string &text, const std::string &flags = "") {
+  GlobalContext gctx;
+  Context ctx(gctx, "keys", Source::borrow(text.data(), text.size()));
+  Parser::parse(ctx, 1);
+  Definitions defs(ctx);
+
+  std::unordered_map<std::string, std::string> keys;
+  size_t position = 0;
+  ctx.each_expr([&](const ast::Expression &expr) {
+    if (expr.kind() == ast::Kind::Function) {
+      auto &fn = static_cast<const ast::Function &>(expr);
+      auto &name = ctx.interner().name(fn.proto().name());
+      keys[name] = key(ctx.interner(), defs, fn, position, flags);
+    }
+    ++position;
+  });
+  return keys;
+}
+
+static size_t count_files(const std::string &dir) {
+  size_t count = 0;
+  std::error_code ec;
+  for (llvm::sys::fs::directory_iterator it(dir, ec), end; it != end && !ec;
+       it.increment(ec)) {
+    ++count;
+  }
+  return count;
+}
+
+static std::string directory() {
+  llvm::SmallString<128> dir;
+  REQUIRE(!llvm::sys::fs::createUniqueDirectory("lang-cache", dir));
+  return dir.str().str();
+}
+
+TEST_CASE("keys change with what a fn's code depends on") {
+  auto base = keys("fn f(a) = a * 2\n"
+                   "fn g(x, y) = f(x) + y\n");
+  CHECK(base["f"].size() == 40);
+  CHECK(base["f"] != base["g"]);
+
+  // same trees, spelled differently.
+  CHECK(keys("fn f(a) =   a*2\n"
+             "fn g(x, y) = f(x)   + y\n") == base);
+
+  auto body = keys("fn f(a) = a * 3\n"
+                   "fn g(x, y) = f(x) + y\n");
+  CHECK(body["f"] != base["f"]);
+  // g calls f, but only depends on its prototype.
+  CHECK(body["g"] == base["g"]);
+
+  auto proto = keys("fn f(a, b) = a * 2\n"
+                    "fn g(x, y) = f(x) + y\n");
+  CHECK(proto["g"] != base["g"]);
+
+  auto renamed = keys("fn f(b) = b * 2\n"
+                      "fn g(x, y) = f(x) + y\n");
+  CHECK(renamed["f"] != base["f"]);
+
+  CHECK(keys("fn f(a) = a * 2\n"
+             "fn g(x, y) = f(x) + y\n",
+             "O2")["f"] != base["f"]);
+}
+
+TEST_CASE("cache evicts the least recently used entries") {
+  auto dir = directory();
+  std::unique_ptr<const err::Error> error;
+  auto cache = Cache::open(error, dir, 250);
+  REQUIRE(cache != nullptr);
+
+  std::string data(100, 'x');
+  CHECK(cache->get("a") == nullptr);
+  cache->put("a", data);
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  cache->put("b", data);
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  auto a = cache->get("a");
+  REQUIRE(a != nullptr);
+  CHECK(a->getBuffer() == data);
+
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  cache->put("c", data);
+  CHECK(cache->get("a") != nullptr);
+  CHECK(cache->get("b") == nullptr);
+  CHECK(cache->get("c") != nullptr);
+
+  // a new process sees what is there.
+  auto again = Cache::open(error, dir, 250);
+  REQUIRE(again != nullptr);
+  CHECK(again->get("c") != nullptr);
+
+  llvm::sys::fs::remove_directories(dir);
+}
+
+TEST_CASE("lazy jit reuses cached fns") {
+  std::string text = "fn twice(n) = n * 2\n"
+                     "fn unused(n) = n - 1\n"
+                     "fn main(x) = twice(x) + twice(x + 1)\n";
+  auto dir = directory();
+
+  for (int run = 0; run < 2; ++run) {
+    GlobalContext gctx;
+    Context ctx(gctx, "cache", Source::borrow(text.data(), text.size()));
+    Parser::parse(ctx, 1);
+
+    std::unique_ptr<const err::Error> error;
+    auto cache = Cache::open(error, dir);
+    REQUIRE(cache != nullptr);
+    auto jit = jit::JIT::create(error, codegen::OptLevel::O2);
+    REQUIRE(jit != nullptr);
+    REQUIRE(jit->add_lazy(ctx, cache.get()) == nullptr);
+
+    int64_t result = 0;
+    REQUIRE(jit->run("main", {5}, result) == nullptr);
+    CHECK(result == 22);
+    // main and twice, compiled by the first run only.
+    CHECK(count_files(dir) == 2);
+  }
+
+  llvm::sys::fs::remove_directories(dir);
+}
+
+} // namespace cache
+} // namespace compiler
+} // namespace lang
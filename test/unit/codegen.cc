@@ -0,0 +1,77 @@
+#include "compiler/codegen.h"
+#include "compiler/parser.h"
+#include "doctest.h"
+#include <string>
+
+#include <llvm/Support/raw_ostream.h>
+
+namespace lang {
+namespace compiler {
+namespace codegen {
+
+static std::string print(const llvm::Module &module) {
+  std::string text;
+  llvm::raw_string_ostream out(text);
+  module.print(out, nullptr);
+  return out.str();
+}
+
+TEST_CASE("parallel codegen links to the sequential module") {
+  // f0..f9 call `later` before it is defined and fail to generate; the
+  // rest succeed, calling fns from all over the file.
+  std::string text;
+  for (int i = 0; i < 40; ++i) {
+    auto n = std::to_string(i);
+    auto prev = std::to_string(i == 0 ? 0 : i - 1);
+    text += "fn f" + n + "(a, b) = {\n"
+            "  val c = f" + prev + "(a, b) * " + n + "\n"
+            "  if c {\n"
+            "    (a + c)\n"
+            "  } else {\n"
+            "    later(b)\n"
+            "  }\n"
+            "}\n";
+    if (i == 9) {
+      text += "fn later(x) = f9(x, x) + f0(x, 1)\n";
+    }
+  }
+  text += "fn f3(x) = x + 1\n"; // redefinition, rejected by both
+
+  GlobalContext gctx;
+  Context ctx(gctx, "shards", Source::borrow(text.data(), text.size()));
+  Parser::parse(ctx, 1);
+
+  Codegen sequential(ctx);
+  sequential.generate();
+
+  llvm::LLVMContext llvm;
+  auto linked = link(ctx, generate_parallel(ctx, 4), llvm);
+
+  REQUIRE(linked != nullptr);
+  CHECK(print(*linked) == print(sequential.module()));
+}
+
+TEST_CASE("optimization levels fold constant expressions") {
+  std::string text = "fn test2(x) = (1+2+x)*(x+(1+2))\n"
+                     "fn twice(y) = test2(y) + test2(y)\n";
+  GlobalContext gctx;
+  Context ctx(gctx, "opt", Source::borrow(text.data(), text.size()));
+  Parser::parse(ctx, 1);
+
+  Codegen unoptimized(ctx, OptLevel::O0);
+  unoptimized.generate();
+  Codegen optimized(ctx, OptLevel::O2);
+  optimized.generate();
+
+  auto count = [](const Codegen &codegen) {
+    return codegen.module().getFunction("test2")->getInstructionCount();
+  };
+  CHECK(count(optimized) < count(unoptimized));
+  // test2 is inlined into twice.
+  CHECK(print(unoptimized.module()).find("call") != std::string::npos);
+  CHECK(print(optimized.module()).find("call") == std::string::npos);
+}
+
+} // namespace codegen
+} // namespace compiler
+} // namespace lang
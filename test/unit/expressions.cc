@@ -0,0 +1,61 @@
+#include "compiler/expressions.h"
+#include "doctest.h"
+#include <algorithm>
+
+namespace lang {
+namespace compiler {
+namespace ast {
+
+namespace {
+
+class CountCalls : public NoopVisitor<CountCalls> {
+public:
+  using NoopVisitor<CountCalls>::visit;
+
+  int calls = 0;
+
+  void visit(const Call &call) {
+    ++calls;
+    for (auto arg : call.args()) {
+      dispatch(*arg);
+    }
+  }
+};
+
+class Depth : public Visitor<Depth, int> {
+public:
+  int visit(const BinaryExpression &expr) {
+    return 1 + std::max(dispatch(expr.left()), dispatch(expr.right()));
+  }
+  template <typename T> int visit(const T &) { return 0; }
+};
+
+} // namespace
+
+TEST_CASE("visitor dispatches on the node kind") {
+  Interner names;
+  Arena arena;
+  auto one = arena.make<Integer>(1);
+  auto x = arena.make<Identifier>(names.intern("x"));
+  auto sum = arena.make<BinaryExpression>('+', one, x);
+  auto product = arena.make<BinaryExpression>('*', sum, one);
+  std::vector<const Expression *> args = {product, x};
+  auto inner = arena.make<Call>(names.intern("f"), arena.copy(args));
+  args = {inner};
+  auto outer = arena.make<Call>(names.intern("g"), arena.copy(args));
+
+  CHECK(outer->kind() == Kind::Call);
+  CHECK(product->kind() == Kind::BinaryExpression);
+
+  CountCalls counter;
+  counter.dispatch(*outer);
+  CHECK(counter.calls == 2);
+
+  Depth depth;
+  CHECK(depth.dispatch(*product) == 2);
+  CHECK(depth.dispatch(*x) == 0);
+}
+
+} // namespace ast
+} // namespace compiler
+} // namespace lang
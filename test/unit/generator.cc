@@ -0,0 +1,77 @@
+#include "compiler/codegen.h"
+#include "compiler/generator.h"
+#include "compiler/parser.h"
+#include "compiler/stats.h"
+#include "doctest.h"
+#include "test/unit/helpers.h"
+#include <sstream>
+#include <string>
+
+namespace lang {
+namespace compiler {
+namespace gen {
+
+static std::string text(const Shape &shape) {
+  std::ostringstream out;
+  generate(shape, out);
+  return out.str();
+}
+
+TEST_CASE("generator is deterministic") {
+  Shape shape;
+  CHECK(text(shape) == text(shape));
+  auto other = shape;
+  other.seed = 2;
+  CHECK(text(shape) != text(other));
+}
+
+TEST_CASE("generated programs compile in their shape") {
+  Shape shapes[4];
+  shapes[1].depth = 0;
+  shapes[1].body = 0;
+  shapes[1].nesting = 0;
+  shapes[2].fanout = 7;
+  shapes[2].vocabulary = 3;
+  shapes[2].params = 9;
+  shapes[3].nesting = 5;
+  shapes[3].body = 9;
+  shapes[3].depth = 8;
+  for (auto &shape : shapes) {
+    auto program = text(shape);
+    GlobalContext global;
+    Context ctx(global, "generated",
+                Source::borrow(program.data(), program.size()));
+    Stats stats;
+    ctx.set_stats(&stats);
+    Parser::parse(ctx, 1);
+    llvm::LLVMContext llvm;
+    codegen::Codegen codegen(ctx, llvm);
+    codegen.generate();
+    REQUIRE(count_errors(ctx) == 0);
+
+    auto module = codegen.release();
+    size_t defined = 0;
+    for (auto &fn : *module) {
+      defined += !fn.isDeclaration();
+    }
+    CHECK(defined == shape.fns);
+    std::ostringstream json;
+    stats.print_json(json);
+    auto calls = "\"Call\":" + std::to_string(shape.fanout * (shape.fns - 1));
+    CHECK(count(json.str(), calls + ",") == 1);
+    // every fn ends in an if chain, when there can be one.
+    CHECK(count(program, "\n  if ") == (shape.nesting > 0 ? shape.fns : 0));
+  }
+}
+
+TEST_CASE("generator writes lines enough") {
+  Shape shape;
+  shape.lines = 5000;
+  auto program = text(shape);
+  CHECK(count(program, "\n") >= 5000);
+  CHECK(count(program, "\n") < 5100);
+}
+
+} // namespace gen
+} // namespace compiler
+} // namespace lang
@@ -0,0 +1,31 @@
+#ifndef LANG_TEST_UNIT_HELPERS_H
+#define LANG_TEST_UNIT_HELPERS_H
+
+#include "compiler/context.h"
+#include <cstddef>
+#include <string>
+
+namespace lang {
+namespace compiler {
+
+// How many errors ctx holds.
+inline size_t count_errors(Context &ctx) {
+  size_t count = 0;
+  ctx.each_error([&count](const err::Error &) { ++count; });
+  return count;
+}
+
+// How many times part occurs in text, overlaps included.
+inline size_t count(const std::string &text, const std::string &part) {
+  size_t count = 0;
+  for (auto i = text.find(part); i != std::string::npos;
+       i = text.find(part, i + 1)) {
+    ++count;
+  }
+  return count;
+}
+
+} // namespace compiler
+} // namespace lang
+
+#endif // LANG_TEST_UNIT_HELPERS_H
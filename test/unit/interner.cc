@@ -0,0 +1,43 @@
+#include "compiler/interner.h"
+#include "doctest.h"
+#include <thread>
+#include <vector>
+
+namespace lang {
+namespace compiler {
+
+TEST_CASE("interner hands out dense ids by name") {
+  Interner interner;
+  auto foo = interner.intern("foo");
+  auto bar = interner.intern("bar");
+
+  CHECK(foo.id() == 0);
+  CHECK(bar.id() == 1);
+  CHECK(interner.intern(std::string("foo")) == foo);
+  CHECK(interner.name(bar) == "bar");
+  CHECK(interner.size() == 2);
+}
+
+TEST_CASE("interner agrees across threads") {
+  Interner interner;
+  std::vector<std::vector<Symbol>> seen(4);
+  std::vector<std::thread> threads;
+  for (auto &symbols : seen) {
+    threads.emplace_back([&interner, &symbols]() {
+      for (int i = 0; i < 1000; ++i) {
+        symbols.push_back(interner.intern("id" + std::to_string(i)));
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+
+  CHECK(interner.size() == 1000);
+  for (auto &symbols : seen) {
+    CHECK(symbols == seen[0]);
+  }
+}
+
+} // namespace compiler
+} // namespace lang
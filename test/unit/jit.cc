@@ -0,0 +1,126 @@
+#include "compiler/jit.h"
+#include "compiler/parser.h"
+#include "doctest.h"
+#include "test/unit/helpers.h"
+#include <sstream>
+#include <string>
+
+namespace lang {
+namespace compiler {
+namespace jit {
+
+TEST_CASE("jit runs fns with integer arguments") {
+  // `if` takes its then branch when the condition is 1.
+  std::string text = "fn fact(n) = {\n"
+                     "  if n {\n"
+                     "    1\n"
+                     "  } else {\n"
+                     "    n * fact(n - 1)\n"
+                     "  }\n"
+                     "}\n"
+                     "fn mix(a, b, c) = (a - b) * c\n"
+                     "fn main(x) = fact(x) + mix(1, 3, 10)\n";
+
+  for (auto level : {codegen::OptLevel::O0, codegen::OptLevel::O2}) {
+    GlobalContext gctx;
+    Context ctx(gctx, "jit", Source::borrow(text.data(), text.size()));
+    Parser::parse(ctx, 1);
+
+    std::unique_ptr<const err::Error> error;
+    auto jit = JIT::create(error, level);
+    REQUIRE(jit != nullptr);
+    REQUIRE(jit->add(codegen::generate_shard(ctx, level)) == nullptr);
+
+    int64_t result = 0;
+    CHECK(jit->run("main", {5}, result) == nullptr);
+    CHECK(result == 100);
+    CHECK(jit->run("fact", {10}, result) == nullptr);
+    CHECK(result == 3628800);
+    CHECK(jit->run("mix", {-4, 2, 7}, result) == nullptr);
+    CHECK(result == -42);
+
+    // arity and missing fns are reported rather than called.
+    CHECK(jit->run("mix", {1}, result) != nullptr);
+    CHECK(jit->run("nope", {1}, result) != nullptr);
+  }
+}
+
+TEST_CASE("jit resolves calls across shards") {
+  std::string text = "fn one(x) = x * 1\n"
+                     "fn two(x) = one(x) + one(x)\n"
+                     "fn three(x) = two(x) + one(x)\n"
+                     "fn main(x) = three(x) * two(x)\n";
+  GlobalContext gctx;
+  Context ctx(gctx, "shards", Source::borrow(text.data(), text.size()));
+  Parser::parse(ctx, 1);
+
+  std::unique_ptr<const err::Error> error;
+  auto jit = JIT::create(error, codegen::OptLevel::O0);
+  REQUIRE(jit != nullptr);
+  for (auto &shard : codegen::generate_parallel(ctx, 4)) {
+    REQUIRE(jit->add(std::move(shard)) == nullptr);
+  }
+
+  int64_t result = 0;
+  CHECK(jit->run("main", {1}, result) == nullptr);
+  CHECK(result == 6);
+}
+
+TEST_CASE("lazy jit generates only the fns that are called") {
+  // `broken` cannot be generated, but nothing calls it.
+  std::string text = "fn broken(x) = nope(x) + 1\n"
+                     "fn twice(x) = x * 2\n"
+                     "fn main(x) = twice(x) + 1\n";
+  GlobalContext gctx;
+  Context ctx(gctx, "lazy", Source::borrow(text.data(), text.size()));
+  Parser::parse(ctx, 1);
+
+  std::unique_ptr<const err::Error> error;
+  auto jit = JIT::create(error, codegen::OptLevel::O2);
+  REQUIRE(jit != nullptr);
+  REQUIRE(jit->add_lazy(ctx) == nullptr);
+
+  int64_t result = 0;
+  CHECK(jit->run("main", {20}, result) == nullptr);
+  CHECK(result == 41);
+  CHECK(jit->run("twice", {4}, result) == nullptr);
+  CHECK(result == 8);
+
+  CHECK(count_errors(ctx) == 0);
+}
+
+TEST_CASE("lazy jit does not run fns that may call a broken fn") {
+  // main only calls f when x is 1, which is enough to turn it away.
+  std::string text = "fn f(a) = b + a\n"
+                     "fn g(a) = a + 1\n"
+                     "fn main(x) = {\n"
+                     "  if x {\n"
+                     "    f(x)\n"
+                     "  } else {\n"
+                     "    g(x)\n"
+                     "  }\n"
+                     "}\n";
+  GlobalContext gctx;
+  Context ctx(gctx, "broken", Source::borrow(text.data(), text.size()));
+  Parser::parse(ctx, 1);
+
+  std::unique_ptr<const err::Error> error;
+  auto jit = JIT::create(error, codegen::OptLevel::O0);
+  REQUIRE(jit != nullptr);
+  REQUIRE(jit->add_lazy(ctx) == nullptr);
+
+  int64_t result = 0;
+  for (auto &name : {"main", "f"}) {
+    std::ostringstream out;
+    error = jit->run(name, {1}, result);
+    REQUIRE(error != nullptr);
+    out << *error;
+    CHECK(out.str() == "JIT: cannot generate f\nundefined name b");
+  }
+  CHECK(jit->run("g", {1}, result) == nullptr);
+  CHECK(result == 2);
+}
+
+} // namespace jit
+} // namespace compiler
+} // namespace lang
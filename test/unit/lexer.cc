@@ -0,0 +1,99 @@
+#include "compiler/lexer.h"
+#include "compiler/lexer_tables.h"
+#include "compiler/scan.h"
+#include "doctest.h"
+#include "test/unit/helpers.h"
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace lang {
+namespace compiler {
+namespace lex {
+
+TEST_CASE("keyword perfect hash recognizes exactly the keywords") {
+  CHECK(tables::keyword("fn") == Keyword::kwFN);
+  CHECK(tables::keyword("elif") == Keyword::kwELIF);
+  CHECK(tables::keyword("else") == Keyword::kwELSE);
+  CHECK(tables::keyword("val") == Keyword::kwVAL);
+  CHECK(tables::keyword("fnord") == Keyword::kwINVALID);
+  CHECK(tables::keyword("e") == Keyword::kwINVALID);
+  CHECK(tables::keyword("vax") == Keyword::kwINVALID);
+}
+
+TEST_CASE("lexer matches the longest operator") {
+  std::string text = "a == b = (c)";
+  GlobalContext gctx;
+  Context ctx(gctx, "ops", Source::borrow(text.data(), text.size()));
+  Lexer lexer(ctx);
+
+  auto &tokens = lexer.reset();
+  REQUIRE(tokens.size() == 8);
+  CHECK(tokens[1].is_operator(Operator::opCOMPARE));
+  CHECK(tokens[3].is_operator(Operator::opEQUAL));
+  CHECK(tokens[4].is_operator(Operator::opLPAREN));
+  CHECK(tokens[6].is_operator(Operator::opRPAREN));
+  CHECK(tokens[7].eof());
+}
+
+TEST_CASE("lexer steps over invalid bytes") {
+  std::string text = "fn main() = a(1) @ 2  \n\x01";
+  GlobalContext gctx;
+  Context ctx(gctx, "invalid", Source::borrow(text.data(), text.size()));
+  Lexer lexer(ctx);
+
+  auto &tokens = lexer.reset();
+  REQUIRE(tokens.size() == 13);
+  CHECK(tokens[9].invalid());
+  CHECK(tokens[9].loc().col == 17);
+  CHECK(tokens[9].text(ctx.source()) == "@");
+  CHECK(tokens[10].is_integer());
+  CHECK(tokens[11].invalid());
+  CHECK(tokens[11].loc().line == 2);
+  CHECK(tokens[12].eof());
+
+  CHECK(count_errors(ctx) == 2);
+}
+
+TEST_CASE("lexer turns away integer literals that do not fit") {
+  std::string text = "9223372036854775807 9223372036854775808 "
+                     "99999999999999999999 7";
+  GlobalContext gctx;
+  Context ctx(gctx, "integers", Source::borrow(text.data(), text.size()));
+  Lexer lexer(ctx);
+
+  auto &tokens = lexer.reset();
+  REQUIRE(tokens.size() == 5);
+  CHECK(tokens[0].integer() == INT64_MAX);
+  CHECK(tokens[1].invalid());
+  CHECK(tokens[1].text(ctx.source()) == "9223372036854775808");
+  CHECK(tokens[2].invalid());
+  CHECK(tokens[3].integer() == 7);
+
+  std::vector<std::string> errors;
+  ctx.each_error([&errors](const err::Error &error) {
+    std::ostringstream out;
+    out << error;
+    errors.push_back(out.str());
+  });
+  REQUIRE(errors.size() == 2);
+  CHECK(errors[0] == "SYN: Unexpected (invalid 1:20)\n"
+                     "Integer literal too large");
+}
+
+TEST_CASE("vector scanners agree with the scalar scanners") {
+  std::string text = "    \t  abcdefghijklmnopqrstuvwxyz_ABCDEFGHIJKLMNOPQRSTUV"
+                     "WXYZ0123456789 0123456789012345678901234567890123456789+";
+  const char *end = text.data() + text.size();
+  for (const char *p = text.data(); p != end; ++p) {
+    CHECK(scan::skip_whitespace(p, end) ==
+          scan::scalar::skip_whitespace(p, end));
+    CHECK(scan::skip_identifier(p, end) ==
+          scan::scalar::skip_identifier(p, end));
+    CHECK(scan::skip_digits(p, end) == scan::scalar::skip_digits(p, end));
+  }
+}
+
+} // namespace lex
+} // namespace compiler
+} // namespace lang
@@ -0,0 +1,132 @@
+#include "compiler/object.h"
+#include "compiler/parser.h"
+#include "doctest.h"
+#include <cstdio>
+#include <string>
+
+#include <llvm/ADT/SmallString.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/Program.h>
+
+namespace lang {
+namespace compiler {
+namespace object {
+
+// Runs command and returns what it prints.
+static std::string output(const std::string &command) {
+  std::string out;
+  auto pipe = popen(command.c_str(), "r");
+  char buffer[256];
+  while (pipe != nullptr && fgets(buffer, sizeof(buffer), pipe) != nullptr) {
+    out += buffer;
+  }
+  if (pipe != nullptr) {
+    pclose(pipe);
+  }
+  return out;
+}
+
+TEST_CASE("object code runs as an executable") {
+  std::string text = "fn fact(n) = {\n"
+                     "  if n {\n"
+                     "    1\n"
+                     "  } else {\n"
+                     "    n * fact(n - 1)\n"
+                     "  }\n"
+                     "}\n"
+                     "fn exit(a, b) = (a - b) * 10\n"
+                     "fn main(x, y) = fact(x) + exit(y, 3)\n";
+
+  // the system compiler links the pieces.
+  if (!llvm::sys::findProgramByName("cc")) {
+    return;
+  }
+
+  for (size_t jobs : {1, 3}) {
+    GlobalContext gctx;
+    Context ctx(gctx, "object", Source::borrow(text.data(), text.size()));
+    Parser::parse(ctx, 1);
+
+    llvm::SmallString<128> path;
+    REQUIRE(!llvm::sys::fs::createTemporaryFile("object", "o", path));
+    auto file = path.str().str();
+    auto shard = codegen::generate_shard(ctx, codegen::OptLevel::O2);
+    CHECK(write(*shard.module, codegen::OptLevel::O2, jobs, file, nullptr) ==
+          nullptr);
+    uint64_t size = 0;
+    CHECK(!llvm::sys::fs::file_size(file, size));
+    CHECK(size > 0);
+    llvm::sys::fs::remove(file);
+
+    // `exit` would clash with the C library without the prefix.
+    REQUIRE(!llvm::sys::fs::createTemporaryFile("object", "", path));
+    auto exe = path.str().str();
+    auto program = codegen::generate_shard(ctx, codegen::OptLevel::O2);
+    std::string entry = "main";
+    CHECK(write(*program.module, codegen::OptLevel::O2, jobs, exe, &entry) ==
+          nullptr);
+    CHECK(output(exe + " 5 7") == "160\n");
+    CHECK(output(exe + " 5 2>&1") == "usage: " + exe + " ARG ARG\n");
+    llvm::sys::fs::remove(exe);
+  }
+}
+
+TEST_CASE("cached object code only compiles changed fns") {
+  if (!llvm::sys::findProgramByName("cc")) {
+    return;
+  }
+
+  llvm::SmallString<128> dir, path;
+  REQUIRE(!llvm::sys::fs::createUniqueDirectory("lang-cache", dir));
+  REQUIRE(!llvm::sys::fs::createTemporaryFile("object", "", path));
+  auto exe = path.str().str();
+  std::unique_ptr<const err::Error> error;
+  auto cache = cache::Cache::open(error, dir.str().str());
+  REQUIRE(cache != nullptr);
+
+  auto entries = [&dir]() {
+    size_t count = 0;
+    std::error_code ec;
+    for (llvm::sys::fs::directory_iterator it(dir, ec), end;
+         it != end && !ec; it.increment(ec)) {
+      ++count;
+    }
+    return count;
+  };
+
+  std::string entry = "main";
+  for (auto scale : {"10", "10", "100"}) {
+    std::string text = "fn scale(n) = n * " + std::string(scale) + "\n"
+                       "fn add(a, b) = a + b\n"
+                       "fn main(x, y) = add(scale(x), y)\n";
+    GlobalContext gctx;
+    Context ctx(gctx, "cached", Source::borrow(text.data(), text.size()));
+    Parser::parse(ctx, 1);
+    CHECK(write(ctx, *cache, codegen::OptLevel::O2, 2, exe, &entry) ==
+          nullptr);
+    CHECK(output(exe + " 4 2") == std::to_string(4 * std::stoi(scale) + 2) +
+                                      "\n");
+  }
+  // the second write hits every fn; the third compiles scale again.
+  CHECK(entries() == 4);
+
+  llvm::sys::fs::remove(exe);
+  llvm::sys::fs::remove_directories(dir);
+}
+
+TEST_CASE("entry must be a defined fn") {
+  std::string text = "fn f(x) = x * 2\n";
+  GlobalContext gctx;
+  Context ctx(gctx, "entry", Source::borrow(text.data(), text.size()));
+  Parser::parse(ctx, 1);
+
+  auto shard = codegen::generate_shard(ctx, codegen::OptLevel::O2);
+  CHECK(add_entry(*shard.module, "main") != nullptr);
+  CHECK(add_entry(*shard.module, "f") == nullptr);
+  CHECK(shard.module->getFunction("lang.f") != nullptr);
+  CHECK(shard.module->getFunction("main") != nullptr);
+}
+
+} // namespace object
+} // namespace compiler
+} // namespace lang
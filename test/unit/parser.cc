@@ -0,0 +1,90 @@
+#include "compiler/lexer.h"
+#include "compiler/parser.h"
+#include "doctest.h"
+#include <algorithm>
+#include <sstream>
+#include <string>
+
+namespace lang {
+namespace compiler {
+
+static std::string functions(int count) {
+  std::string text;
+  for (int i = 0; i < count; ++i) {
+    auto n = std::to_string(i);
+    text += "fn f" + n + "(a, b) = {\n"
+            "  val fn_" + n + " = a * " + n + "\n"
+            "  if fn_" + n + " {\n"
+            "    (a + b)\n"
+            "  } else {\n"
+            "    f" + n + "(b, a)\n"
+            "  }\n"
+            "}\n"
+            "fn g" + n + "(x) = x + " + n + "\n";
+  }
+  return text;
+}
+
+static std::string dump(Context &ctx) {
+  std::stringstream out;
+  ctx.each_expr([&out, &ctx](const ast::Expression &node) {
+    node.print(out, ctx.interner());
+    out << "\n";
+  });
+  ctx.each_block([&out, &ctx](const cfg::BasicBlock &block) {
+    block.print(out, ctx.interner());
+    out << "\n";
+  });
+  ctx.each_error([&out](const err::Error &error) { out << error << "\n"; });
+  return out.str();
+}
+
+TEST_CASE("split cuts only before top-level fn definitions") {
+  std::string text = functions(10);
+  auto source = Source::borrow(text.data(), text.size());
+  auto chunks = lex::split(*source, 4);
+
+  REQUIRE(chunks.size() > 1);
+  CHECK(chunks.size() <= 4);
+  CHECK(chunks.front().begin == 0);
+  CHECK(chunks.front().line == 1);
+  CHECK(chunks.back().end == text.size());
+  for (size_t i = 1; i < chunks.size(); ++i) {
+    CHECK(chunks[i].begin == chunks[i - 1].end);
+    CHECK(text.compare(chunks[i].begin, 3, "fn ") == 0);
+    auto lines = std::count(text.begin(), text.begin() + chunks[i].begin, '\n');
+    CHECK(chunks[i].line == lines + 1);
+  }
+}
+
+TEST_CASE("parallel parse matches sequential parse") {
+  std::string text = functions(50) + "fn broken(a = a\n" + functions(3);
+  GlobalContext gctx;
+
+  Context sequential(gctx, "seq", Source::borrow(text.data(), text.size()));
+  Parser::parse(sequential, 1);
+  Context parallel(gctx, "par", Source::borrow(text.data(), text.size()));
+  Parser::parse(parallel, 4);
+
+  CHECK(dump(parallel) == dump(sequential));
+}
+
+TEST_CASE("parallel parse stops at a stray top-level token") {
+  for (auto stray : {")\n", "val x = 1\n"}) {
+    std::string text = functions(20) + stray + functions(20);
+    GlobalContext gctx;
+
+    Context sequential(gctx, "seq", Source::borrow(text.data(), text.size()));
+    Parser::parse(sequential, 1);
+    Context parallel(gctx, "par", Source::borrow(text.data(), text.size()));
+    Parser::parse(parallel, 4);
+
+    size_t fns = 0;
+    sequential.each_expr([&fns](const ast::Expression &) { ++fns; });
+    CHECK(fns == 40);
+    CHECK(dump(parallel) == dump(sequential));
+  }
+}
+
+} // namespace compiler
+} // namespace lang
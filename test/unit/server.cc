@@ -0,0 +1,126 @@
+#include "compiler/server.h"
+#include "doctest.h"
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <llvm/ADT/SmallString.h>
+#include <llvm/Support/FileSystem.h>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace lang {
+namespace compiler {
+namespace server {
+
+static std::string socket_path() {
+  llvm::SmallString<128> path;
+  llvm::sys::fs::createUniquePath("lang-%%%%%%.sock", path, true);
+  return path.str().str();
+}
+
+static Reply compile(const std::string &path, Emit emit,
+                     const std::string &text) {
+  Request request{emit, codegen::OptLevel::O0, false, "server", text};
+  Reply reply{false, ""};
+  auto error = send(path, request, reply);
+  CHECK(error == nullptr);
+  return reply;
+}
+
+TEST_CASE("server compiles requests from many clients") {
+  auto path = socket_path();
+  std::unique_ptr<const err::Error> error;
+  auto server = Server::listen(error, path, 2);
+  REQUIRE(server != nullptr);
+  std::thread thread(&Server::serve, server.get());
+
+  auto ir = compile(path, Emit::IR, "fn f(a) = a * 2\n");
+  CHECK(ir.ok);
+  CHECK(ir.data.find("define i64 @f(i64 %a)") != std::string::npos);
+
+  auto object = compile(path, Emit::Object, "fn f(a) = a * 2\n");
+  CHECK(object.ok);
+  CHECK(object.data.substr(1, 3) == "ELF");
+
+  auto broken = compile(path, Emit::Check, "fn f(a) = )\n");
+  CHECK(!broken.ok);
+  CHECK(broken.data.find("SYN: Unexpected") != std::string::npos);
+
+  Reply missing{true, ""};
+  CHECK(send(path,
+             Request{Emit::IR, codegen::OptLevel::O0, true, "/nonexistent",
+                     ""},
+             missing) == nullptr);
+  CHECK(!missing.ok);
+
+  // more clients than workers.
+  std::vector<std::thread> clients;
+  std::vector<Reply> replies(8);
+  for (size_t i = 0; i < replies.size(); ++i) {
+    clients.emplace_back([&path, &replies, i]() {
+      auto text = "fn f" + std::to_string(i) + "(a) = a + " +
+                  std::to_string(i) + "\n";
+      Request request{Emit::IR, codegen::OptLevel::O2, false, "server", text};
+      send(path, request, replies[i]);
+    });
+  }
+  for (auto &client : clients) {
+    client.join();
+  }
+  for (size_t i = 0; i < replies.size(); ++i) {
+    CHECK(replies[i].ok);
+    CHECK(replies[i].data.find("@f" + std::to_string(i) + "(") !=
+          std::string::npos);
+  }
+
+  server->stop();
+  thread.join();
+  server.reset();
+  CHECK(!llvm::sys::fs::exists(path));
+  Reply reply{false, ""};
+  CHECK(send(path, Request{Emit::IR, codegen::OptLevel::O0, false, "", ""},
+             reply) != nullptr);
+}
+
+TEST_CASE("server turns away clients that stop sending") {
+  auto path = socket_path();
+  std::unique_ptr<const err::Error> error;
+  auto server = Server::listen(error, path, 1, std::chrono::milliseconds(50));
+  REQUIRE(server != nullptr);
+  std::thread thread(&Server::serve, server.get());
+
+  sockaddr_un address{};
+  address.sun_family = AF_UNIX;
+  std::strcpy(address.sun_path, path.c_str());
+  int fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  REQUIRE(fd >= 0);
+  REQUIRE(::connect(fd, reinterpret_cast<sockaddr *>(&address),
+                    sizeof(address)) == 0);
+  // half a header, and then nothing.
+  std::string header = "ir 0 text";
+  REQUIRE(::write(fd, header.data(), header.size()) ==
+          ssize_t(header.size()));
+  std::string received;
+  char buf[256];
+  for (ssize_t n; (n = ::read(fd, buf, sizeof(buf))) > 0;) {
+    received.append(buf, n);
+  }
+  ::close(fd);
+  CHECK(received.rfind("error ", 0) == 0);
+  CHECK(received.find("timed out") != std::string::npos);
+
+  // the worker is free for the next client.
+  auto ir = compile(path, Emit::IR, "fn f(a) = a * 2\n");
+  CHECK(ir.ok);
+
+  server->stop();
+  thread.join();
+}
+
+} // namespace server
+} // namespace compiler
+} // namespace lang
@@ -0,0 +1,159 @@
+#include "compiler/jit.h"
+#include "compiler/session.h"
+#include "doctest.h"
+#include "test/unit/helpers.h"
+#include <sstream>
+#include <string>
+
+namespace lang {
+namespace compiler {
+
+// Updates session to text and checks what had to be done again.
+static void update(Session &session, const std::string &text, size_t parsed,
+                   size_t generated) {
+  std::istringstream in(text);
+  auto stats = session.update(Source::read(in));
+  CHECK(stats.parsed == parsed);
+  CHECK(stats.generated == generated);
+}
+
+// Whether the latest version of session generates fn name.
+static bool defines(Session &session, const std::string &name) {
+  auto fn = session.module().getFunction(name);
+  return fn != nullptr && !fn->isDeclaration();
+}
+
+// Runs fn name of the latest version of session with args.
+static int64_t run(Session &session, const std::string &name,
+                   const std::vector<int64_t> &args) {
+  std::unique_ptr<const err::Error> error;
+  auto jit = jit::JIT::create(error, codegen::OptLevel::O0);
+  REQUIRE(jit != nullptr);
+  REQUIRE(jit->add(session.shard()) == nullptr);
+  int64_t result = 0;
+  REQUIRE(jit->run(name, args, result) == nullptr);
+  return result;
+}
+
+TEST_CASE("session redoes only the fns an edit touches") {
+  Session session("session", codegen::OptLevel::O2);
+  update(session,
+         "fn f(a) = a * 2\n"
+         "fn g(x, y) = f(x) + y\n"
+         "fn h(x) = g(x, 1) * 1\n",
+         3, 3);
+  REQUIRE(count_errors(session.context()) == 0);
+  CHECK(run(session, "h", {5}) == 11);
+
+  // g only depends on the prototype of f.
+  update(session,
+         "fn f(a) = a * 3\n"
+         "fn g(x, y) = f(x) + y\n"
+         "fn h(x) = g(x, 1) * 1\n",
+         1, 1);
+  CHECK(run(session, "h", {5}) == 16);
+
+  // a fn added on top moves the others, which stay as they are.
+  update(session,
+         "fn k(a) = a - 1\n"
+         "fn f(a) = a * 3\n"
+         "fn g(x, y) = f(x) + y\n"
+         "fn h(x) = g(x, 1) * 1\n",
+         1, 1);
+  CHECK(run(session, "h", {5}) == 16);
+  CHECK(run(session, "k", {5}) == 4);
+
+  update(session,
+         "fn k(a) = a - 1\n"
+         "fn f(a) = a * 3\n"
+         "fn g(x, y) = f(x) + y\n"
+         "fn h(x) = g(x, 1) * 1\n",
+         0, 0);
+  CHECK(count_errors(session.context()) == 0);
+}
+
+TEST_CASE("session regenerates callers of a changed prototype") {
+  Session session("session", codegen::OptLevel::O0);
+  update(session,
+         "fn f(a) = a * 2\n"
+         "fn g(x) = f(x) + 1\n"
+         "fn h(x) = x * 1\n",
+         3, 3);
+
+  // g is unchanged, but now calls f with the wrong number of arguments.
+  update(session,
+         "fn f(a, b) = a * b\n"
+         "fn g(x) = f(x) + 1\n"
+         "fn h(x) = x * 1\n",
+         1, 2);
+  CHECK(!defines(session, "g"));
+  CHECK(defines(session, "h"));
+
+  // g failed, so it is generated again until fixed.
+  update(session,
+         "fn f(a, b) = a * b\n"
+         "fn g(x) = f(x) + 1\n"
+         "fn h(x) = x * 2\n",
+         1, 2);
+  CHECK(!defines(session, "g"));
+
+  update(session,
+         "fn f(a) = a * 2\n"
+         "fn g(x) = f(x) + 1\n"
+         "fn h(x) = x * 2\n",
+         1, 2);
+  CHECK(run(session, "g", {5}) == 11);
+}
+
+TEST_CASE("session keeps syntax errors until fixed") {
+  Session session("session", codegen::OptLevel::O0);
+  update(session,
+         "fn f(a) = a * 2\n"
+         "fn g(x) = )\n",
+         2, 2);
+  CHECK(count_errors(session.context()) == 1);
+
+  // the broken fn is parsed again once it moves, for its errors to point
+  // to where it is now.
+  update(session,
+         "fn e(a) = a * 1\n"
+         "fn f(a) = a * 2\n"
+         "fn g(x) = )\n",
+         2, 2);
+  CHECK(count_errors(session.context()) == 1);
+
+  update(session,
+         "fn e(a) = a * 1\n"
+         "fn f(a) = a * 2\n"
+         "fn g(x) = f(x) + 1\n",
+         1, 1);
+  REQUIRE(count_errors(session.context()) == 0);
+  CHECK(run(session, "g", {5}) == 11);
+}
+
+TEST_CASE("session parses fns that failed to generate again once they move") {
+  Session session("session", codegen::OptLevel::O0);
+  update(session,
+         "fn f(a) = a * 2\n"
+         "fn g(x) = nope(x) + 1\n",
+         2, 2);
+  CHECK(!defines(session, "g"));
+
+  // g parses, but its errors come from generating it at its new line.
+  update(session,
+         "fn e(a) = a * 1\n"
+         "fn f(a) = a * 2\n"
+         "fn g(x) = nope(x) + 1\n",
+         2, 2);
+  CHECK(!defines(session, "g"));
+
+  // at the same line, it is only generated again.
+  update(session,
+         "fn e(a) = a * 1\n"
+         "fn f(a) = a * 2\n"
+         "fn g(x) = nope(x) + 1\n",
+         0, 1);
+}
+
+} // namespace compiler
+} // namespace lang
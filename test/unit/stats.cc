@@ -0,0 +1,149 @@
+#include "compiler/codegen.h"
+#include "compiler/parser.h"
+#include "compiler/stats.h"
+#include "doctest.h"
+#include <chrono>
+#include <sstream>
+#include <string>
+#include <thread>
+
+namespace lang {
+namespace compiler {
+
+// Parses and generates text, recording into stats with jobs pieces.
+static void compile(Stats &stats, const std::string &text, size_t jobs) {
+  GlobalContext global;
+  std::istringstream in(text);
+  Context ctx(global, "stats", in);
+  ctx.set_stats(&stats);
+  Parser::parse(ctx, jobs);
+  llvm::LLVMContext llvm;
+  codegen::Codegen codegen(ctx, llvm, codegen::OptLevel::O1);
+  codegen.generate();
+}
+
+static bool contains(const std::string &text, const std::string &part) {
+  return text.find(part) != std::string::npos;
+}
+
+const char *const SOURCE = "fn f(a) = a * 2\n"
+                           "fn g(a, b) = {\n"
+                           "  if a {\n"
+                           "    f(b)\n"
+                           "  } else {\n"
+                           "    b\n"
+                           "  }\n"
+                           "}\n";
+
+TEST_CASE("stats record phases, counts and fns") {
+  Stats stats;
+  compile(stats, SOURCE, 1);
+
+  std::ostringstream json;
+  stats.print_json(json);
+  CHECK(contains(json.str(), "\"Function\":2,"));
+  CHECK(contains(json.str(), "\"Call\":1,"));
+  CHECK(contains(json.str(), "\"If\":1,"));
+  CHECK(contains(json.str(), "{\"name\":\"f\","));
+  CHECK(contains(json.str(), "{\"name\":\"g\","));
+  CHECK(contains(json.str(), "\"lex\":{"));
+  CHECK(!contains(json.str(), "\"instructions\":0,"));
+  CHECK(!contains(json.str(), "\"basic_blocks\":0,"));
+
+  std::ostringstream table;
+  stats.print(table);
+  CHECK(contains(table.str(), "optimize"));
+  CHECK(contains(table.str(), "Function"));
+  std::ostringstream phases;
+  stats.print(phases, true);
+  CHECK(contains(phases.str(), "codegen"));
+  CHECK(!contains(phases.str(), "Function"));
+}
+
+TEST_CASE("stats of pieces parsed at once add up") {
+  Stats one, many;
+  compile(one, SOURCE, 1);
+  compile(many, SOURCE, 4);
+
+  // the counts after tokens, as each piece lexes an eof token of its own.
+  auto counts = [](const Stats &stats) {
+    std::ostringstream out;
+    stats.print_json(out);
+    auto json = out.str();
+    auto begin = json.find(",\"basic_blocks\"");
+    return json.substr(begin, json.find("\"functions\"") - begin);
+  };
+  CHECK(counts(one) == counts(many));
+}
+
+TEST_CASE("stats count a phase's wall time once across threads") {
+  Stats stats;
+  auto start = Stats::now().wall;
+  uint64_t inner = 0;
+  {
+    Stats::Timer timer(&stats, Stats::CODEGEN);
+    std::thread([&stats, &inner]() {
+      Stats::Timer timer(&stats, Stats::CODEGEN);
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+      inner = timer.stop().wall;
+    }).join();
+  }
+  auto elapsed = Stats::now().wall - start;
+
+  // summed, the two timers would take longer than both did.
+  CHECK(inner > 0);
+  CHECK(stats.time(Stats::CODEGEN).wall >= inner);
+  CHECK(stats.time(Stats::CODEGEN).wall <= elapsed);
+  std::ostringstream json;
+  stats.print_json(json);
+  CHECK(contains(json.str(), "\"count\":2"));
+}
+
+TEST_CASE("stats count allocations toward the running phase") {
+  Stats::count_allocations();
+  Stats stats;
+  Stats::allocated(10);
+  {
+    Stats::Timer timer(&stats, Stats::PARSE);
+    Stats::allocated(100);
+    Stats::Timer inner(&stats, Stats::CFG);
+    Stats::allocated(30);
+    inner.stop();
+    Stats::allocated(50);
+    Stats::freed(150);
+  }
+  Stats::allocated(10);
+  Stats::freed(20);
+
+  std::ostringstream json;
+  stats.print_json(json);
+  CHECK(contains(json.str(), "\"allocations\":2,\"allocated_bytes\":150,"));
+  CHECK(contains(json.str(), "\"allocations\":1,\"allocated_bytes\":30,"));
+  CHECK(contains(json.str(), "\"allocations\":0,\"allocated_bytes\":0,"));
+
+  // peaks are of the whole process: parse saw what cfg left live.
+  CHECK(stats.peak(Stats::PARSE) == stats.peak(Stats::CFG) + 50);
+  CHECK(stats.peak(Stats::LEX) == 0);
+  CHECK(contains(json.str(), "\"peak_bytes\":" +
+                                 std::to_string(stats.peak(Stats::PARSE))));
+}
+
+TEST_CASE("node bytes include the child lists of each node") {
+  Stats stats;
+  compile(stats, "fn f(a, b) = a\n", 1);
+  std::ostringstream json;
+  stats.print_json(json);
+  auto bytes = sizeof(ast::Prototype) + 2 * sizeof(ast::Parameter *);
+  CHECK(contains(json.str(),
+                 "\"Prototype\":" + std::to_string(bytes) + ","));
+}
+
+TEST_CASE("a timer without stats records nothing") {
+  Stats::Timer timer(nullptr, Stats::LEX);
+  auto time = timer.stop();
+  CHECK(time.wall == 0);
+  CHECK(time.cpu == 0);
+}
+
+} // namespace compiler
+} // namespace lang
@@ -0,0 +1,146 @@
+#include "compiler/parser.h"
+#include "compiler/tiered.h"
+#include "doctest.h"
+#include "test/unit/helpers.h"
+#include <string>
+
+namespace lang {
+namespace compiler {
+namespace jit {
+
+TEST_CASE("tiered engine promotes hot fns to native code") {
+  // fib(1) and fib(2) are 1; `if` takes its then branch when the condition
+  // is 1.
+  std::string text = "fn fib(n) = {\n"
+                     "  if n {\n"
+                     "    1\n"
+                     "  } elif n - 1 {\n"
+                     "    1\n"
+                     "  } else {\n"
+                     "    fib(n - 1) + fib(n - 2)\n"
+                     "  }\n"
+                     "}\n"
+                     "fn twice(n) = fib(n) * 2\n"
+                     "fn cold(n) = n + 1\n";
+  GlobalContext gctx;
+  Context ctx(gctx, "tiered", Source::borrow(text.data(), text.size()));
+  Parser::parse(ctx, 1);
+
+  std::unique_ptr<const err::Error> error;
+  auto engine = Tiered::create(error, ctx, 100);
+  REQUIRE(engine != nullptr);
+
+  auto &names = ctx.interner();
+  auto twice = names.intern("twice"), cold = names.intern("cold");
+  auto fib = engine->program().lookup(names.intern("fib"));
+  auto index = uint32_t(fib - engine->program().functions().data());
+
+  int64_t result = 0;
+  REQUIRE(engine->run(twice, {10}, result) == nullptr);
+  CHECK(result == 110);
+  engine->drain();
+  CHECK(engine->promoted() == 1);
+  auto &profile = engine->interpreter().profile(index);
+  CHECK(profile.native != 0);
+
+  // every call from here on runs native code.
+  auto calls = profile.calls;
+  int64_t a = 0, b = 1;
+  for (int64_t n = 1; n <= 20; ++n) {
+    REQUIRE(engine->run(twice, {n}, result) == nullptr);
+    CHECK(result == 2 * b);
+    b = a + b;
+    a = b - a;
+  }
+  CHECK(profile.calls == calls);
+
+  REQUIRE(engine->run(cold, {1}, result) == nullptr);
+  CHECK(result == 2);
+  engine->drain();
+  CHECK(engine->promoted() == 1);
+}
+
+TEST_CASE("tiered engine compiles lazy fns while promoting others") {
+  // a(n) calls itself until n is 1, so it gets hot while each b is called
+  // once and stays behind its stub.
+  std::string text;
+  std::string calls;
+  for (int i = 0; i < 8; ++i) {
+    auto k = std::to_string(i);
+    text += "fn b" + k + "(n) = n + " + k + "\n";
+    text += "fn c" + k + "(n) = n * " + k + "\n";
+    calls += (i > 0 ? " + b" : "b") + k + "(n)";
+  }
+  text += "fn a(n) = {\n"
+          "  if n {\n"
+          "    " + calls + "\n"
+          "  } else {\n"
+          "    a(n - 1)\n"
+          "  }\n"
+          "}\n";
+  GlobalContext gctx;
+  Context ctx(gctx, "tiered", Source::borrow(text.data(), text.size()));
+  Parser::parse(ctx, 1);
+
+  std::unique_ptr<const err::Error> error;
+  auto engine = Tiered::create(error, ctx, 100);
+  REQUIRE(engine != nullptr);
+  auto &names = ctx.interner();
+  auto a = names.intern("a");
+
+  int64_t result = 0;
+  REQUIRE(engine->run(a, {200}, result) == nullptr);
+  CHECK(result == 36);
+  engine->drain();
+  CHECK(engine->promoted() == 1);
+
+  // the cs get hot and are compiled on the worker, while the native code of
+  // a compiles the bs on this thread.
+  for (int i = 0; i < 8; ++i) {
+    auto c = names.intern("c" + std::to_string(i));
+    for (int n = 0; n <= 100; ++n) {
+      REQUIRE(engine->run(c, {n}, result) == nullptr);
+    }
+  }
+  REQUIRE(engine->run(a, {1}, result) == nullptr);
+  CHECK(result == 36);
+  engine->drain();
+  CHECK(engine->promoted() == 9);
+  REQUIRE(engine->run(names.intern("c7"), {3}, result) == nullptr);
+  CHECK(result == 21);
+}
+
+TEST_CASE("tiered engine reports fns it cannot promote") {
+  // loop never calls broken, so it runs interpreted until it gets hot, but
+  // native code for it cannot be generated.
+  std::string text = "fn broken(x) = nope(x) + 1\n"
+                     "fn loop(n) = {\n"
+                     "  if n {\n"
+                     "    1\n"
+                     "  } elif n + 1000 {\n"
+                     "    broken(n)\n"
+                     "  } else {\n"
+                     "    loop(n - 1)\n"
+                     "  }\n"
+                     "}\n";
+  GlobalContext gctx;
+  Context ctx(gctx, "tiered", Source::borrow(text.data(), text.size()));
+  Parser::parse(ctx, 1);
+
+  std::unique_ptr<const err::Error> error;
+  auto engine = Tiered::create(error, ctx, 100);
+  REQUIRE(engine != nullptr);
+  auto errors = count_errors(ctx);
+
+  int64_t result = 0;
+  REQUIRE(engine->run(ctx.interner().intern("loop"), {200}, result) ==
+          nullptr);
+  CHECK(result == 1);
+  engine->drain();
+  CHECK(engine->promoted() == 0);
+  CHECK(count_errors(ctx) == errors + 1);
+}
+
+} // namespace jit
+} // namespace compiler
+} // namespace lang
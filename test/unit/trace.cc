@@ -0,0 +1,61 @@
+#include "compiler/codegen.h"
+#include "compiler/parser.h"
+#include "compiler/trace.h"
+#include "doctest.h"
+#include "test/unit/helpers.h"
+#include <sstream>
+#include <string>
+#include <thread>
+
+namespace lang {
+namespace compiler {
+
+TEST_CASE("trace keeps the spans of each thread apart") {
+  Trace trace;
+  {
+    Trace::Span outer(&trace, "test", "outer");
+    Trace::Span inner(&trace, "test", "in\"ner");
+  }
+  std::thread thread([&trace]() { Trace::Span span(&trace, "test", "other"); });
+  thread.join();
+  Trace::Span none(nullptr, "test", "none");
+  none.end();
+
+  std::ostringstream out;
+  trace.write(out);
+  auto json = out.str();
+  CHECK(json.find("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[") == 0);
+  CHECK(count(json, "\"ph\":\"X\"") == 3);
+  CHECK(count(json, "\"tid\":1,") == 2);
+  CHECK(count(json, "\"tid\":2,\"cat\":\"test\",\"name\":\"other\"") == 1);
+  CHECK(count(json, "\"name\":\"in\\\"ner\"") == 1);
+  CHECK(count(json, "none") == 0);
+}
+
+TEST_CASE("trace spans the phases, fns and passes of a compile") {
+  Trace trace;
+  GlobalContext global;
+  std::istringstream in("fn f(a) = a * 2\n"
+                        "fn g(a) = f(a) + 1\n");
+  Context ctx(global, "trace", in);
+  ctx.set_trace(&trace);
+  Parser::parse(ctx, 2);
+  llvm::LLVMContext llvm;
+  codegen::Codegen codegen(ctx, llvm, codegen::OptLevel::O2);
+  codegen.generate();
+
+  std::ostringstream out;
+  trace.write(out);
+  auto json = out.str();
+  // each piece is lexed and parsed on its own.
+  CHECK(count(json, "\"name\":\"lex\"") == 2);
+  CHECK(count(json, "\"name\":\"parse\"") == 2);
+  CHECK(count(json, "\"cat\":\"codegen\",\"name\":\"f\"") == 1);
+  CHECK(count(json, "\"cat\":\"codegen\",\"name\":\"g\"") == 1);
+  CHECK(count(json, "\"name\":\"optimize\"") == 1);
+  // run both as each fn is generated and in the module pipeline.
+  CHECK(count(json, "\"cat\":\"llvm\",\"name\":\"InstCombinePass\"") > 2);
+}
+
+} // namespace compiler
+} // namespace lang
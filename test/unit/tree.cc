@@ -0,0 +1,78 @@
+#include "compiler/lexer.h"
+#include "compiler/parser.h"
+#include "compiler/tree.h"
+#include "doctest.h"
+#include <sstream>
+#include <string>
+
+namespace lang {
+namespace compiler {
+namespace ast {
+
+static const std::string SOURCE = R"(fn foo1(a, b, c) = {
+  val d = 10 * c
+  if d {
+    (a + 10)
+  } elif a {
+    (a - 10)
+  } else {
+    (a * 10)
+  }
+}
+
+fn main() = {
+  foo1(1, 2, 3)
+}
+
+fn test2(x) = (1+2+x)*(x+(1+2))
+)";
+
+TEST_CASE("tree prints the same as the pointer ast") {
+  GlobalContext gctx;
+  Context ctx(gctx, "tree", Source::borrow(SOURCE.data(), SOURCE.size()));
+  lex::Lexer lexer(ctx);
+  Parser parser(lexer, ctx);
+  parser.parse();
+
+  std::stringstream expected;
+  ctx.each_expr([&expected, &ctx](const Expression &node) {
+    node.print(expected, ctx.interner());
+    expected << "\n";
+  });
+
+  auto tree = lower(ctx);
+  std::stringstream actual;
+  for (auto root : tree.roots()) {
+    tree.print(actual, ctx.interner(), root);
+    actual << "\n";
+  }
+
+  REQUIRE(tree.roots().size() == 3);
+  CHECK(actual.str() == expected.str());
+}
+
+TEST_CASE("tree children precede their parents") {
+  Interner names;
+  Tree tree;
+  auto a = tree.add_identifier(names.intern("a"));
+  auto one = tree.add_integer(1);
+  auto sum = tree.add_binary('+', a, one);
+  auto param = tree.add_parameter(false, names.intern("a"));
+  auto proto = tree.add_prototype(names.intern("inc"), {param});
+  auto fn = tree.add_function(proto, {sum});
+
+  CHECK(tree.size() == 6);
+  CHECK(tree.kind(fn) == Kind::Function);
+  CHECK(tree.proto(fn) == proto);
+  REQUIRE(tree.body(fn).size() == 1);
+  CHECK(tree.body(fn)[0] == sum);
+  CHECK(tree.left(sum) == a);
+  CHECK(tree.right(sum) == one);
+  CHECK(tree.integer(one) == 1);
+  CHECK(tree.params(proto)[0] == param);
+  CHECK(tree.params(tree.add_prototype(names.intern("nop"), {})).empty());
+}
+
+} // namespace ast
+} // namespace compiler
+} // namespace lang
@@ -0,0 +1,76 @@
+#include "compiler/generator.h"
+#include "cxxopts.hpp"
+#include <fstream>
+#include <iostream>
+
+// Writes a synthetic program, the same for the same options, for
+// benchmarks and stress tests.
+int main(int argc, char *argv[]) {
+  using namespace lang::compiler;
+
+  try {
+    cxxopts::Options options(argv[0]);
+    gen::Shape shape;
+
+    // clang-format off
+    options.add_options()
+      ("h,help", "Show this message")
+      ("seed", "Seed of the program",
+       cxxopts::value<uint64_t>()->default_value(std::to_string(shape.seed)))
+      ("fns", "Top-level fns",
+       cxxopts::value<size_t>()->default_value(std::to_string(shape.fns)))
+      ("lines", "Write fns until there are at least N lines, instead of "
+       "--fns", cxxopts::value<size_t>())
+      ("body", "Vals at the start of each fn; branches get half as many",
+       cxxopts::value<size_t>()->default_value(std::to_string(shape.body)))
+      ("depth", "Most levels of operators in an expression",
+       cxxopts::value<size_t>()->default_value(std::to_string(shape.depth)))
+      ("nesting", "Most levels of if/elif/else chains in a fn",
+       cxxopts::value<size_t>()->default_value(
+           std::to_string(shape.nesting)))
+      ("fanout", "Calls in each fn to fns before it",
+       cxxopts::value<size_t>()->default_value(std::to_string(shape.fanout)))
+      ("vocabulary", "Distinct words parameters and vals are named with",
+       cxxopts::value<size_t>()->default_value(
+           std::to_string(shape.vocabulary)))
+      ("params", "Most parameters of a fn",
+       cxxopts::value<size_t>()->default_value(std::to_string(shape.params)))
+      ("o,output", "Output file (standard output by default)",
+       cxxopts::value<std::string>());
+    // clang-format on
+
+    auto result = options.parse(argc, argv);
+    if (result.count("help")) {
+      std::cout << options.help() << std::endl;
+      return 0;
+    }
+
+    shape.seed = result["seed"].as<uint64_t>();
+    shape.fns = result["fns"].as<size_t>();
+    if (result.count("lines")) {
+      shape.lines = result["lines"].as<size_t>();
+    }
+    shape.body = result["body"].as<size_t>();
+    shape.depth = result["depth"].as<size_t>();
+    shape.nesting = result["nesting"].as<size_t>();
+    shape.fanout = result["fanout"].as<size_t>();
+    shape.vocabulary = result["vocabulary"].as<size_t>();
+    shape.params = result["params"].as<size_t>();
+
+    if (!result.count("output")) {
+      gen::generate(shape, std::cout);
+      return std::cout.flush() ? 0 : 1;
+    }
+    auto path = result["output"].as<std::string>();
+    std::ofstream out(path, std::ios::binary);
+    gen::generate(shape, out);
+    if (!out.flush()) {
+      std::cerr << path << ": cannot write file\n";
+      return 1;
+    }
+    return 0;
+  } catch (const cxxopts::OptionException &e) {
+    std::cerr << "error parsing options: " << e.what() << std::endl;
+    return 1;
+  }
+}